@@ -0,0 +1,569 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Microbenchmarks for the response parsers, run by 'make bench' */
+
+#include "arena.h"
+#include "yahooutil.h"
+#include "yqljson.h"
+#include "location.h"
+#include "forecast.h"
+#include "fleet.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+/* Each benchmark runs for at least this long, in milliseconds */
+#define BENCH_DEFAULT_TIME 500
+
+/* Locations in the table the fleet benchmarks scan */
+#define BENCH_FLEET_ROWS   4096
+
+typedef void (*BenchFunc)(gpointer data);
+
+typedef struct
+{
+  gchar     * name_;
+  BenchFunc   func_;
+  gpointer    data_;
+} Benchmark;
+
+/* Allocations made while counting is on */
+static gboolean g_counting = FALSE;
+static guint64  g_allocs   = 0;
+static guint64  g_bytes    = 0;
+
+#ifdef __GLIBC__
+/* Every allocation, including the ones made inside glib and libxml2, goes
+ * through these. The benchmark is single-threaded, so plain counters do. */
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t nmemb, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+extern void * __libc_memalign(size_t alignment, size_t size);
+
+#define ALLOCATION_COUNT(size) \
+  if (g_counting) {            \
+    ++g_allocs;                \
+    g_bytes += (size);         \
+  }
+
+void *
+malloc(size_t size)
+{
+  ALLOCATION_COUNT(size);
+
+  return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+  ALLOCATION_COUNT(nmemb * size);
+
+  return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void * ptr, size_t size)
+{
+  ALLOCATION_COUNT(size);
+
+  return __libc_realloc(ptr, size);
+}
+
+int
+posix_memalign(void ** ptr, size_t alignment, size_t size)
+{
+  ALLOCATION_COUNT(size);
+
+  *ptr = __libc_memalign(alignment, size);
+
+  return (*ptr) ? 0 : ENOMEM;
+}
+#endif
+
+/**
+ * Parses a forecast response into a new forecast, and frees it.
+ *
+ * @param data Pointer to the response.
+ */
+static void
+forecast_parse_bench(gpointer data)
+{
+  gpointer forecast = NULL;
+
+  forecast_response_parse(data, &forecast);
+
+  forecast_unref(forecast);
+}
+
+/**
+ * Parses a forecast response into a new forecast with the temporaries in an
+ * arena, the way the refresh pipeline does, and frees it.
+ *
+ * @param data Pointer to the response.
+ */
+static void
+forecast_arena_bench(gpointer data)
+{
+  static Arena arena = ARENA_INIT;
+
+  gpointer forecast = NULL;
+
+  Arena * previous = arena_enter(&arena);
+
+  forecast_response_parse(data, &forecast);
+
+  arena_leave(previous);
+
+  arena_reset(&arena);
+
+  forecast_unref(forecast);
+}
+
+/**
+ * Parses a placefinder response into a new list, and frees it.
+ *
+ * @param data Pointer to the response.
+ */
+static void
+location_parse_bench(gpointer data)
+{
+  GList * list = NULL;
+
+  location_response_parse(data, &list);
+
+  g_list_free_full(list, location_unref);
+}
+
+/**
+ * Parses a JSON forecast response into a new forecast, and frees it.
+ *
+ * @param data Pointer to the response.
+ */
+static void
+yqljson_forecast_bench(gpointer data)
+{
+  gpointer forecast = NULL;
+
+  yqljson_forecast_parse(data, strlen(data), &forecast);
+
+  forecast_unref(forecast);
+}
+
+/**
+ * Parses a JSON placefinder response into a new list, and frees it.
+ *
+ * @param data Pointer to the response.
+ */
+static void
+yqljson_location_bench(gpointer data)
+{
+  GList * list = NULL;
+
+  yqljson_location_parse(data, strlen(data), &list);
+
+  g_list_free_full(list, location_unref);
+}
+
+/**
+ * Turns an already parsed Result node into a location, and frees it.
+ *
+ * @param data Pointer to the node.
+ */
+static void
+result_node_bench(gpointer data)
+{
+  location_unref(result_node_process((xmlNodePtr)data));
+}
+
+/* Source and published slot of the forecast_publish benchmark */
+typedef struct
+{
+  gpointer src_;
+  gpointer dst_;
+} PublishBench;
+
+/**
+ * Publishes a forecast over the previous one, the way the widget does.
+ *
+ * @param data Pointer to the PublishBench.
+ */
+static void
+forecast_publish_bench(gpointer data)
+{
+  PublishBench * bench = (PublishBench *)data;
+
+  gpointer previous = bench->dst_;
+
+  bench->dst_ = forecast_ref(bench->src_);
+
+  forecast_unref(previous);
+}
+
+/* Response and previous forecast of the forecast_reparse benchmark */
+typedef struct
+{
+  gchar    * response_;
+  gpointer   forecast_;
+} ReparseBench;
+
+/**
+ * Parses a forecast response over the previous forecast, the way each
+ * refresh of a location does, and keeps the result for the next run.
+ *
+ * @param data Pointer to the ReparseBench.
+ */
+static void
+forecast_reparse_bench(gpointer data)
+{
+  ReparseBench * bench = (ReparseBench *)data;
+
+  forecast_response_parse(bench->response_, &bench->forecast_);
+}
+
+/**
+ * Summarizes the whole fleet table, the way the stats log does.
+ *
+ * @param data Unused.
+ */
+static void
+fleet_summary_bench(gpointer data G_GNUC_UNUSED)
+{
+  FleetSummary summary;
+
+  fleet_summary(g_get_monotonic_time(), &summary);
+}
+
+/**
+ * Finds the first element with the given name, depth first.
+ *
+ * @param node Pointer to the node to start from.
+ * @param name Name of the element.
+ *
+ * @return The element, or NULL if there is none.
+ */
+static xmlNodePtr
+element_find(xmlNodePtr node, const gchar * name)
+{
+  for (; node; node = node->next) {
+    if (node->type == XML_ELEMENT_NODE && xmlStrEqual(node->name, (const xmlChar *)name)) {
+      return node;
+    }
+
+    xmlNodePtr found = element_find(node->children, name);
+
+    if (found) {
+      return found;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Runs a benchmark for at least the given time and prints its figures.
+ *
+ * @param bench   Pointer to the benchmark.
+ * @param mintime Minimum running time, in microseconds.
+ */
+static void
+benchmark_run(Benchmark * bench, gint64 mintime)
+{
+  guint64 iterations = 1;
+  gint64  elapsed    = 0;
+
+  /* warm up, then double the iterations until the run is long enough */
+  bench->func_(bench->data_);
+
+  while (TRUE) {
+    g_allocs = 0;
+    g_bytes  = 0;
+
+    g_counting = TRUE;
+
+    gint64 started = g_get_monotonic_time();
+
+    guint64 index = 0;
+
+    for (; index < iterations; ++index) {
+      bench->func_(bench->data_);
+    }
+
+    elapsed = g_get_monotonic_time() - started;
+
+    g_counting = FALSE;
+
+    if (elapsed >= mintime) {
+      break;
+    }
+
+    iterations *= 2;
+  }
+
+  printf("%-44s %10" G_GUINT64_FORMAT " %12.1f ns/op %8.1f allocs/op %10.1f B/op\n",
+         bench->name_,
+         iterations,
+         (gdouble)elapsed * 1000.0 / iterations,
+         (gdouble)g_allocs / iterations,
+         (gdouble)g_bytes / iterations);
+}
+
+/**
+ * Adds a benchmark to the list, unless it is filtered out.
+ *
+ * @param list   Pointer to the list of benchmarks.
+ * @param filter Substring the name must contain, may be NULL.
+ * @param name   Name of the benchmark, freed if the benchmark is filtered out.
+ * @param func   Function running one iteration.
+ * @param data   Pointer to the data passed to the function.
+ */
+static void
+benchmark_add(GList ** list, const gchar * filter, gchar * name, BenchFunc func, gpointer data)
+{
+  if (filter && !strstr(name, filter)) {
+    g_free(name);
+
+    return;
+  }
+
+  Benchmark * bench = g_new0(Benchmark, 1);
+
+  bench->name_ = name;
+  bench->func_ = func;
+  bench->data_ = data;
+
+  *list = g_list_append(*list, bench);
+}
+
+/**
+ * Reads a corpus file.
+ *
+ * @param dir  The corpus directory.
+ * @param name The name of the file.
+ *
+ * @return The contents, which must be freed by the caller, or NULL on error.
+ */
+static gchar *
+corpus_load(const gchar * dir, const gchar * name)
+{
+  gchar  * path     = g_build_filename(dir, name, NULL);
+  gchar  * contents = NULL;
+  GError * error    = NULL;
+
+  if (!g_file_get_contents(path, &contents, NULL, &error)) {
+    fprintf(stderr, "parserbench: %s\n", error->message);
+
+    g_error_free(error);
+  }
+
+  g_free(path);
+
+  return contents;
+}
+
+/**
+ * Prints the command line syntax.
+ *
+ * @param name The name the program was invoked with.
+ */
+static void
+usage(const gchar * name)
+{
+  fprintf(stderr, "Usage: %s [-t milliseconds] CORPUS_DIR [FILTER]\n", name);
+}
+
+int
+main(int argc, char ** argv)
+{
+  gint64 mintime = BENCH_DEFAULT_TIME;
+
+  int arg = 1;
+
+  if (arg + 1 < argc && !strcmp(argv[arg], "-t")) {
+    mintime = g_ascii_strtoll(argv[arg + 1], NULL, 10);
+
+    arg += 2;
+  }
+
+  if (arg >= argc || mintime <= 0) {
+    usage(argv[0]);
+
+    return EXIT_FAILURE;
+  }
+
+  const gchar * dir    = argv[arg];
+  const gchar * filter = (arg + 1 < argc) ? argv[arg + 1] : NULL;
+
+  static const gchar * forecasts[] = {
+    "forecast-small.xml",
+    "forecast-large.xml",
+    "forecast-multi.xml",
+    "forecast-error.xml"
+  };
+
+  static const gchar * places[] = {
+    "placefinder-one.xml",
+    "placefinder-many.xml",
+    "placefinder-none.xml"
+  };
+
+  /* the same responses in the JSON form, see yqljson.c */
+  static const struct
+  {
+    const gchar * name;
+    BenchFunc     func;
+  } jsons[] = {
+    { "forecast-small.json",   yqljson_forecast_bench },
+    { "placefinder-one.json",  yqljson_location_bench },
+    { "placefinder-many.json", yqljson_location_bench }
+  };
+
+  arena_xml_setup();
+
+  xmlInitParser();
+
+  GList * benchmarks = NULL;
+  GList * buffers    = NULL;
+
+  gsize index = 0;
+
+  for (index = 0; index < G_N_ELEMENTS(forecasts); ++index) {
+    gchar * response = corpus_load(dir, forecasts[index]);
+
+    if (!response) {
+      return EXIT_FAILURE;
+    }
+
+    buffers = g_list_prepend(buffers, response);
+
+    benchmark_add(&benchmarks, filter,
+                  g_strdup_printf("forecast_response_parse/%s", forecasts[index]),
+                  forecast_parse_bench, response);
+
+    benchmark_add(&benchmarks, filter,
+                  g_strdup_printf("forecast_arena_parse/%s", forecasts[index]),
+                  forecast_arena_bench, response);
+
+    /* error responses have nothing to publish */
+    if (index < 2) {
+      PublishBench * publish = g_new0(PublishBench, 1);
+
+      forecast_response_parse(response, &publish->src_);
+
+      /* every location of the fleet reports the small forecast */
+      if (index == 0) {
+        guint row = 0;
+
+        for (; row < BENCH_FLEET_ROWS; ++row) {
+          gchar * woeid = g_strdup_printf("%u", row);
+
+          fleet_attach(woeid);
+          fleet_schedule(woeid, 30);
+          fleet_update(woeid, publish->src_, FALSE);
+
+          g_free(woeid);
+        }
+
+        benchmark_add(&benchmarks, filter,
+                      g_strdup_printf("fleet_summary/%u", BENCH_FLEET_ROWS),
+                      fleet_summary_bench, NULL);
+      }
+
+      benchmark_add(&benchmarks, filter,
+                    g_strdup_printf("forecast_publish/%s", forecasts[index]),
+                    forecast_publish_bench, publish);
+
+      ReparseBench * reparse = g_new0(ReparseBench, 1);
+
+      reparse->response_ = response;
+
+      benchmark_add(&benchmarks, filter,
+                    g_strdup_printf("forecast_reparse/%s", forecasts[index]),
+                    forecast_reparse_bench, reparse);
+    }
+  }
+
+  xmlDocPtr doc = NULL;
+
+  for (index = 0; index < G_N_ELEMENTS(places); ++index) {
+    gchar * response = corpus_load(dir, places[index]);
+
+    if (!response) {
+      return EXIT_FAILURE;
+    }
+
+    buffers = g_list_prepend(buffers, response);
+
+    benchmark_add(&benchmarks, filter,
+                  g_strdup_printf("location_response_parse/%s", places[index]),
+                  location_parse_bench, response);
+
+    if (index == 0) {
+      doc = xmlReadMemory(response, strlen(response), "", NULL, 0);
+
+      benchmark_add(&benchmarks, filter,
+                    g_strdup_printf("result_node_process/%s", places[index]),
+                    result_node_bench, element_find(xmlDocGetRootElement(doc), "Result"));
+    }
+  }
+
+  for (index = 0; index < G_N_ELEMENTS(jsons); ++index) {
+    gchar * response = corpus_load(dir, jsons[index].name);
+
+    if (!response) {
+      return EXIT_FAILURE;
+    }
+
+    buffers = g_list_prepend(buffers, response);
+
+    benchmark_add(&benchmarks, filter,
+                  g_strdup_printf("yqljson/%s", jsons[index].name),
+                  jsons[index].func, response);
+  }
+
+#ifndef __GLIBC__
+  fprintf(stderr, "parserbench: allocations are only counted with glibc\n");
+#endif
+
+  GList * iter = benchmarks;
+
+  for (; iter; iter = iter->next) {
+    benchmark_run((Benchmark *)iter->data, mintime * 1000);
+  }
+
+  /* the benchmarks themselves live until the process exits */
+  xmlFreeDoc(doc);
+
+  g_list_free_full(buffers, g_free);
+
+  fleet_cleanup();
+
+  xmlCleanupParser();
+
+  return EXIT_SUCCESS;
+}
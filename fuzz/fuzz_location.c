@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Fuzzing entry point for the placefinder response parser */
+
+#include "yahooutil.h"
+#include "location.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+
+int
+LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  /* the parser expects a NUL-terminated response */
+  gchar * response = g_strndup((const gchar *)data, size);
+
+  GList * list = NULL;
+
+  location_response_parse(response, &list);
+
+  g_list_free_full(list, location_unref);
+
+  g_free(response);
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Fuzzing entry point for the wind direction decoding */
+
+#include "yahooutil.h"
+#include "forecast.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+/* The input becomes the direction attribute of this channel */
+#define WIND_RESPONSE_HEAD \
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" \
+  "<query xmlns:yahoo=\"http://www.yahooapis.com/v1/base.rng\" yahoo:count=\"1\">" \
+  "<results><channel><title>Yahoo! Weather - Fuzz</title>" \
+  "<yweather:wind xmlns:yweather=\"http://xml.weather.yahoo.com/ns/rss/1.0\" " \
+  "chill=\"60\" direction=\""
+
+#define WIND_RESPONSE_TAIL \
+  "\" speed=\"7\"/></channel></results></query>"
+
+/* Every value WIND_DIRECTION may produce */
+static const gchar * const VALID_DIRECTIONS[] =
+{
+  "N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE",
+  "S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW",
+  ""
+};
+
+/**
+ * Checks whether the decoded direction is one of the compass points.
+ *
+ * @param direction The decoded direction.
+ *
+ * @return TRUE if valid, FALSE otherwise.
+ */
+static gboolean
+direction_valid(const gchar * direction)
+{
+  gsize index = 0;
+
+  for (; index < G_N_ELEMENTS(VALID_DIRECTIONS); ++index) {
+    if (!g_strcmp0(direction, VALID_DIRECTIONS[index])) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  GString * response = g_string_sized_new(sizeof(WIND_RESPONSE_HEAD) +
+                                          sizeof(WIND_RESPONSE_TAIL) + size);
+
+  g_string_append(response, WIND_RESPONSE_HEAD);
+
+  /* keep the attribute well-formed, the XML parser is not under test here */
+  size_t index = 0;
+
+  for (; index < size; ++index) {
+    gchar c = (gchar)data[index];
+
+    if (c >= ' ' && c <= '~' && c != '<' && c != '&' && c != '"') {
+      g_string_append_c(response, c);
+    }
+  }
+
+  g_string_append(response, WIND_RESPONSE_TAIL);
+
+  gpointer forecast = NULL;
+
+  if (!forecast_response_parse(response->str, &forecast)) {
+    ForecastInfo * info = (ForecastInfo *)forecast;
+
+    if (!direction_valid(info->windDirection_)) {
+      abort();
+    }
+  }
+
+  forecast_unref(forecast);
+
+  g_string_free(response, TRUE);
+
+  return 0;
+}
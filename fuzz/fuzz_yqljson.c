@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Fuzzing entry point for the JSON reader and the YQL JSON parsers */
+
+#include "yqljson.h"
+#include "location.h"
+#include "forecast.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <glib.h>
+
+int
+LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+  /* the reader works on lengths, the copy catches reads past the end */
+  gchar * response = g_malloc(size);
+
+  memcpy(response, data, size);
+
+  gpointer forecast = NULL;
+
+  if (!yqljson_forecast_parse(response, (gint)size, &forecast)) {
+    gint day = FORECAST_DAY_1;
+
+    for (; day < FORECAST_MAX_DAYS; ++day) {
+      forecast_day_get(forecast, day);
+    }
+  }
+
+  forecast_unref(forecast);
+
+  GList * list = NULL;
+
+  yqljson_location_parse(response, (gint)size, &list);
+
+  g_list_free_full(list, location_unref);
+
+  g_free(response);
+
+  return 0;
+}
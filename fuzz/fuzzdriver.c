@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Stand-alone and AFL driver for the fuzzing entry points */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+/* Iterations per process in AFL persistent mode */
+#define FUZZ_PERSISTENT_RUNS 1000
+
+int
+LLVMFuzzerTestOneInput(const uint8_t * data, size_t size);
+
+/* Optional, as with libFuzzer */
+int
+LLVMFuzzerInitialize(int * argc, char *** argv) __attribute__((weak));
+
+/**
+ * Reads all of standard input.
+ *
+ * @param buffer Pointer to the buffer to allocate.
+ *
+ * @return The number of bytes read.
+ */
+static gsize
+stdin_read(gchar ** buffer)
+{
+  GByteArray * array = g_byte_array_new();
+
+  guint8 chunk[4096];
+
+  ssize_t count;
+
+  while ((count = read(STDIN_FILENO, chunk, sizeof(chunk))) > 0) {
+    g_byte_array_append(array, chunk, (guint)count);
+  }
+
+  gsize length = array->len;
+
+  *buffer = (gchar *)g_byte_array_free(array, FALSE);
+
+  return length;
+}
+
+/**
+ * Adds the file, or the files in the directory, to the inputs.
+ *
+ * @param path   The file or directory to add.
+ * @param inputs The array of loaded inputs.
+ */
+static void
+inputs_add(const gchar * path, GPtrArray * inputs)
+{
+  if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+    GDir * dir = g_dir_open(path, 0, NULL);
+
+    const gchar * name = NULL;
+
+    while (dir && (name = g_dir_read_name(dir))) {
+      gchar * child = g_build_filename(path, name, NULL);
+
+      inputs_add(child, inputs);
+
+      g_free(child);
+    }
+
+    if (dir) {
+      g_dir_close(dir);
+    }
+  } else {
+    gchar * contents = NULL;
+
+    gsize length = 0;
+
+    if (g_file_get_contents(path, &contents, &length, NULL)) {
+      g_ptr_array_add(inputs, g_bytes_new_take(contents, length));
+    } else {
+      fprintf(stderr, "fuzzdriver: cannot read %s\n", path);
+    }
+  }
+}
+
+/**
+ * Replays stdin, or the files and directories given, through the entry point.
+ *
+ * Usage: harness [-runs=N] [FILE|DIR]...
+ *
+ * Without files the input comes from stdin, which is what AFL feeds; built
+ * with afl-clang-fast the process stays alive for several inputs. With files
+ * every input is replayed until N runs have been made, and the exec/s is
+ * reported the way libFuzzer does.
+ */
+int
+main(int argc, char ** argv)
+{
+  if (LLVMFuzzerInitialize) {
+    LLVMFuzzerInitialize(&argc, &argv);
+  }
+
+  glong runs = 0;
+
+  GPtrArray * inputs = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+
+  int index = 1;
+
+  for (; index < argc; ++index) {
+    if (g_str_has_prefix(argv[index], "-runs=")) {
+      runs = strtol(argv[index] + strlen("-runs="), NULL, 10);
+    } else if (argv[index][0] == '-') {
+      /* tolerate the engine flags libFuzzer harnesses get invoked with */
+      continue;
+    } else {
+      inputs_add(argv[index], inputs);
+    }
+  }
+
+  if (!inputs->len) {
+#ifdef __AFL_LOOP
+    while (__AFL_LOOP(FUZZ_PERSISTENT_RUNS)) {
+#endif
+      gchar * buffer = NULL;
+
+      gsize length = stdin_read(&buffer);
+
+      LLVMFuzzerTestOneInput((const uint8_t *)buffer, length);
+
+      g_free(buffer);
+#ifdef __AFL_LOOP
+    }
+#endif
+
+    g_ptr_array_free(inputs, TRUE);
+
+    return 0;
+  }
+
+  if (runs < (glong)inputs->len) {
+    runs = inputs->len;
+  }
+
+  gint64 start = g_get_monotonic_time();
+
+  glong run = 0;
+
+  for (; run < runs; ++run) {
+    GBytes * input = g_ptr_array_index(inputs, run % inputs->len);
+
+    gsize length = 0;
+
+    gconstpointer data = g_bytes_get_data(input, &length);
+
+    LLVMFuzzerTestOneInput((const uint8_t *)data, length);
+  }
+
+  gint64 elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+  gchar * name = g_path_get_basename(argv[0]);
+
+  fprintf(stderr, "%s: %ld runs over %u inputs in %.3f s, exec/s: %.0f\n",
+          name,
+          runs,
+          inputs->len,
+          elapsed / 1000000.0,
+          runs * 1000000.0 / elapsed);
+
+  g_free(name);
+
+  g_ptr_array_free(inputs, TRUE);
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Set-up shared by the fuzzing entry points */
+
+#include <glib.h>
+
+#include <libxml/parser.h>
+
+/**
+ * Silences libxml2, malformed input is the norm here.
+ */
+static void
+error_discard(void * ctxt G_GNUC_UNUSED, const char * msg G_GNUC_UNUSED, ...)
+{
+}
+
+int
+LLVMFuzzerInitialize(int * argc G_GNUC_UNUSED, char *** argv G_GNUC_UNUSED)
+{
+  xmlInitParser();
+
+  xmlSetGenericErrorFunc(NULL, error_discard);
+
+  return 0;
+}
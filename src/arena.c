@@ -0,0 +1,437 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides per-request arenas for short-lived allocations */
+
+#include "arena.h"
+#include "logutil.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+#include <libxml/xmlerror.h>
+#include <libxml/xmlmemory.h>
+
+/* Blocks are aligned as malloc() aligns them */
+#define ARENA_ALIGN          (2 * sizeof(gpointer))
+
+#define ARENA_ROUND(size)    (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+/* Every block is preceded by its size, for arena_realloc() */
+#define ARENA_BLOCK_HEADER   ARENA_ROUND(sizeof(gsize))
+
+/* Under the address sanitizer every block comes from the heap so that
+ * reuse after a reset is still caught */
+#if defined(__SANITIZE_ADDRESS__)
+#define ARENA_PASSTHROUGH 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define ARENA_PASSTHROUGH 1
+#endif
+#endif
+
+/* Sits at the start of its chunk, which is aligned to its size */
+typedef struct ArenaChunk
+{
+  struct ArenaChunk * next_;
+  gsize               used_;   // offset of the first free byte
+} ArenaChunk;
+
+#define ARENA_CHUNK_HEADER   ARENA_ROUND(sizeof(ArenaChunk))
+
+/* Serializes the chunk list and registry updates */
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* The chunks are carved in order from one region, reserved with the first
+ * one, so that arena memory is told from heap memory by its address. The
+ * region is only address space until a chunk is touched. Chunks are never
+ * given back, the count only ever grows. */
+static gchar * volatile g_region = NULL;
+static volatile gint    g_count  = 0;
+
+/* Whether libxml allocates through the arenas */
+static gboolean g_xml = FALSE;
+
+/* Chunks not held by any arena */
+static ArenaChunk * g_spare = NULL;
+
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t  g_key;
+
+/**
+ * Creates the key of the calling threads' arenas.
+ *
+ */
+static void
+arena_once(void)
+{
+  pthread_key_create(&g_key, NULL);
+}
+
+/**
+ * Returns the arena the calling thread allocates from.
+ *
+ * @return Pointer to the arena, or NULL if there is none.
+ */
+static Arena *
+arena_current(void)
+{
+  pthread_once(&g_once, arena_once);
+
+  return (Arena *)pthread_getspecific(g_key);
+}
+
+/**
+ * Returns the chunk holding some memory.
+ *
+ * @param memory Pointer to the memory.
+ *
+ * @return Pointer to the chunk, or NULL if the memory is not in any.
+ */
+static ArenaChunk *
+arena_chunk_find(gconstpointer memory)
+{
+  gchar * region = g_atomic_pointer_get(&g_region);
+
+  /* wraps around for memory below the region */
+  guintptr offset = (guintptr)memory - (guintptr)region;
+
+  if (!region || offset >= (guintptr)g_atomic_int_get(&g_count) * ARENA_CHUNK_SIZE) {
+    return NULL;
+  }
+
+  return (ArenaChunk *)(region + (offset & ~(guintptr)(ARENA_CHUNK_SIZE - 1)));
+}
+
+/**
+ * Takes a chunk for an arena, reusing a released one if possible.
+ *
+ * @return Pointer to the chunk, or NULL if the process has all the chunks
+ *         it may have, or there was no memory for one.
+ */
+static ArenaChunk *
+arena_chunk_get(void)
+{
+  ArenaChunk * chunk = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_spare) {
+    chunk = g_spare;
+
+    g_spare = chunk->next_;
+  } else {
+    gint count = g_atomic_int_get(&g_count);
+
+    gchar * region = g_region;
+
+    gpointer memory = NULL;
+
+    if (!region &&
+        !posix_memalign(&memory, ARENA_CHUNK_SIZE, ARENA_CHUNK_SIZE * ARENA_CHUNKS_MAX)) {
+      region = (gchar *)memory;
+
+      g_atomic_pointer_set(&g_region, region);
+    }
+
+    if (region && count < ARENA_CHUNKS_MAX) {
+      chunk = (ArenaChunk *)(region + count * ARENA_CHUNK_SIZE);
+
+      /* the chunk counts as arena memory once it is handed out */
+      g_atomic_int_set(&g_count, count + 1);
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (chunk) {
+    chunk->next_ = NULL;
+    chunk->used_ = ARENA_CHUNK_HEADER;
+  }
+
+  return chunk;
+}
+
+/**
+ * Carves a block out of an arena.
+ *
+ * @param arena Pointer to the arena.
+ * @param size  Number of bytes.
+ *
+ * @return Pointer to the block, or NULL if no chunk was available.
+ */
+static gpointer
+arena_carve(Arena * arena, gsize size)
+{
+  gsize needed = ARENA_BLOCK_HEADER + ARENA_ROUND(size);
+
+  ArenaChunk * chunk = (ArenaChunk *)arena->chunks_;
+
+  if (!chunk || chunk->used_ + needed > ARENA_CHUNK_SIZE) {
+    chunk = arena_chunk_get();
+
+    if (!chunk) {
+      return NULL;
+    }
+
+    chunk->next_ = (ArenaChunk *)arena->chunks_;
+
+    arena->chunks_ = chunk;
+  }
+
+  gchar * block = (gchar *)chunk + chunk->used_;
+
+  *(gsize *)block = size;
+
+  chunk->used_ += needed;
+
+  return block + ARENA_BLOCK_HEADER;
+}
+
+/**
+ * Makes an arena the one the calling thread allocates from.
+ *
+ * @param arena Pointer to the arena, NULL to allocate from the heap.
+ *
+ * @return The arena entered before, to be passed to arena_leave().
+ */
+Arena *
+arena_enter(Arena * arena)
+{
+  Arena * previous = arena_current();
+
+  pthread_setspecific(g_key, arena);
+
+  return previous;
+}
+
+/**
+ * Goes back to the arena the calling thread allocated from before
+ * arena_enter(). Once libxml allocates through the arenas, it also clears
+ * the thread's last libxml error, which may be in the arena left.
+ *
+ * @param previous The arena returned by arena_enter().
+ */
+void
+arena_leave(Arena * previous)
+{
+  pthread_once(&g_once, arena_once);
+
+  /* the last error is the one thing libxml keeps per thread that it
+   * allocates, it must not point into the arena once it is reset */
+  if (g_xml && arena_current()) {
+    xmlResetLastError();
+  }
+
+  pthread_setspecific(g_key, previous);
+}
+
+/**
+ * Allocates from the calling thread's arena, or from the heap if it has
+ * none or the size is over ARENA_LARGE.
+ *
+ * @param size Number of bytes.
+ *
+ * @return Pointer to the memory, to be released with arena_free(), or NULL
+ *         if the allocation failed.
+ */
+gpointer
+arena_alloc(gsize size)
+{
+  gpointer memory = NULL;
+
+#ifndef ARENA_PASSTHROUGH
+  Arena * arena = arena_current();
+
+  if (arena && size <= ARENA_LARGE) {
+    memory = arena_carve(arena, size);
+  }
+#endif
+
+  if (!memory) {
+    /* malloc(0) may not return NULL, libxml relies on it */
+    memory = g_try_malloc(MAX(size, 1));
+  }
+
+  return memory;
+}
+
+/**
+ * Allocates zeroed memory as arena_alloc() does.
+ *
+ * @param size Number of bytes.
+ *
+ * @return Pointer to the memory, to be released with arena_free(), or NULL
+ *         if the allocation failed.
+ */
+gpointer
+arena_alloc0(gsize size)
+{
+  gpointer memory = arena_alloc(size);
+
+  if (memory) {
+    memset(memory, 0, size);
+  }
+
+  return memory;
+}
+
+/**
+ * Resizes memory from arena_alloc() or the heap. The last allocation of
+ * the calling thread's arena grows in place while its chunk has room.
+ *
+ * @param memory Pointer to the memory, may be NULL.
+ * @param size   New number of bytes.
+ *
+ * @return Pointer to the resized memory, or NULL if the allocation failed,
+ *         in which case the memory passed in is left unchanged.
+ */
+gpointer
+arena_realloc(gpointer memory, gsize size)
+{
+  if (!memory) {
+    return arena_alloc(size);
+  }
+
+  ArenaChunk * chunk = arena_chunk_find(memory);
+
+  if (!chunk) {
+    return g_try_realloc(memory, MAX(size, 1));
+  }
+
+  gsize * header = (gsize *)((gchar *)memory - ARENA_BLOCK_HEADER);
+
+  gsize offset = (gchar *)memory - (gchar *)chunk;
+
+  if (size <= *header) {
+    return memory;
+  }
+
+  Arena * arena = arena_current();
+
+  /* the newest block of the arena's newest chunk can simply grow */
+  if (arena && arena->chunks_ == chunk &&
+      offset + ARENA_ROUND(*header) == chunk->used_ &&
+      offset + ARENA_ROUND(size) <= ARENA_CHUNK_SIZE) {
+    chunk->used_ = offset + ARENA_ROUND(size);
+
+    *header = size;
+
+    return memory;
+  }
+
+  gpointer resized = arena_alloc(size);
+
+  if (resized) {
+    memcpy(resized, memory, *header);
+  }
+
+  return resized;
+}
+
+/**
+ * Copies a string as arena_alloc() allocates.
+ *
+ * @param str The string.
+ *
+ * @return The copy, to be released with arena_free(), or NULL if str is
+ *         NULL or the allocation failed.
+ */
+gchar *
+arena_strdup(const gchar * str)
+{
+  if (!str) {
+    return NULL;
+  }
+
+  gsize size = strlen(str) + 1;
+
+  gchar * copy = arena_alloc(size);
+
+  if (copy) {
+    memcpy(copy, str, size);
+  }
+
+  return copy;
+}
+
+/**
+ * Releases memory from the heap. Arena memory is left for arena_reset().
+ *
+ * @param memory Pointer to the memory, may be NULL.
+ */
+void
+arena_free(gpointer memory)
+{
+  if (memory && !arena_chunk_find(memory)) {
+    g_free(memory);
+  }
+}
+
+/**
+ * Releases everything allocated from the arena at once, keeping its chunks
+ * for the next arenas.
+ *
+ * @param arena Pointer to the arena, which is left empty.
+ */
+void
+arena_reset(Arena * arena)
+{
+  ArenaChunk * chunks = (ArenaChunk *)arena->chunks_;
+
+  if (!chunks) {
+    return;
+  }
+
+  ArenaChunk * last = chunks;
+
+  while (last->next_) {
+    last = last->next_;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+
+  last->next_ = g_spare;
+
+  g_spare = chunks;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  arena->chunks_ = NULL;
+}
+
+/**
+ * Routes the allocations of libxml through the arenas. Must be called
+ * before xmlInitParser() and before any thread uses libxml.
+ *
+ */
+void
+arena_xml_setup(void)
+{
+  if (xmlMemSetup(arena_free, arena_alloc, arena_realloc, arena_strdup)) {
+    LXW_LOG(LXW_ERROR, "arena::xml_setup(): libxml refused the allocator");
+  } else {
+    g_xml = TRUE;
+  }
+}
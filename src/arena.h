@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides per-request arenas for short-lived allocations */
+
+#ifndef LXWEATHER_ARENA_HEADER
+#define LXWEATHER_ARENA_HEADER
+
+#include <glib.h>
+
+/* Size of the chunks arenas carve from, a power of two */
+#define ARENA_CHUNK_SIZE  (64 * 1024)
+
+/* Chunks in the whole process, beyond which allocations go to the heap.
+ * Their address space is reserved at once, with the first chunk. */
+#define ARENA_CHUNKS_MAX  256
+
+/* Largest allocation carved from a chunk, larger ones go to the heap */
+#define ARENA_LARGE       (ARENA_CHUNK_SIZE / 8)
+
+/*
+ * A region that the temporaries of one request are carved from, released
+ * all at once by arena_reset(). An arena is entered by the thread working
+ * on the request; arena_alloc() and friends, and libxml once
+ * arena_xml_setup() has been called, then allocate from it.
+ *
+ * arena_free() does nothing for arena memory and frees anything else, so
+ * code that frees what it allocates is correct with or without an arena.
+ * Nothing allocated in an arena may outlive its reset.
+ *
+ * A zeroed Arena is empty and ready to use.
+ */
+typedef struct
+{
+  gpointer chunks_;   // chunks in use, newest first
+} Arena;
+
+#define ARENA_INIT { NULL }
+
+/**
+ * Makes an arena the one the calling thread allocates from.
+ *
+ * @param arena Pointer to the arena, NULL to allocate from the heap.
+ *
+ * @return The arena entered before, to be passed to arena_leave().
+ */
+Arena *
+arena_enter(Arena * arena);
+
+/**
+ * Goes back to the arena the calling thread allocated from before
+ * arena_enter(). Once libxml allocates through the arenas, it also clears
+ * the thread's last libxml error, which may be in the arena left.
+ *
+ * @param previous The arena returned by arena_enter().
+ */
+void
+arena_leave(Arena * previous);
+
+/**
+ * Allocates from the calling thread's arena, or from the heap if it has
+ * none or the size is over ARENA_LARGE.
+ *
+ * @param size Number of bytes.
+ *
+ * @return Pointer to the memory, to be released with arena_free(), or NULL
+ *         if the allocation failed.
+ */
+gpointer
+arena_alloc(gsize size);
+
+/**
+ * Allocates zeroed memory as arena_alloc() does.
+ *
+ * @param size Number of bytes.
+ *
+ * @return Pointer to the memory, to be released with arena_free(), or NULL
+ *         if the allocation failed.
+ */
+gpointer
+arena_alloc0(gsize size);
+
+/**
+ * Resizes memory from arena_alloc() or the heap. The last allocation of
+ * the calling thread's arena grows in place while its chunk has room.
+ *
+ * @param memory Pointer to the memory, may be NULL.
+ * @param size   New number of bytes.
+ *
+ * @return Pointer to the resized memory, or NULL if the allocation failed,
+ *         in which case the memory passed in is left unchanged.
+ */
+gpointer
+arena_realloc(gpointer memory, gsize size);
+
+/**
+ * Copies a string as arena_alloc() allocates.
+ *
+ * @param str The string.
+ *
+ * @return The copy, to be released with arena_free(), or NULL if str is
+ *         NULL or the allocation failed.
+ */
+gchar *
+arena_strdup(const gchar * str);
+
+/**
+ * Releases memory from the heap. Arena memory is left for arena_reset().
+ *
+ * @param memory Pointer to the memory, may be NULL.
+ */
+void
+arena_free(gpointer memory);
+
+/**
+ * Releases everything allocated from the arena at once, keeping its chunks
+ * for the next arenas.
+ *
+ * @param arena Pointer to the arena, which is left empty.
+ */
+void
+arena_reset(Arena * arena);
+
+/**
+ * Routes the allocations of libxml through the arenas. Must be called
+ * before xmlInitParser() and before any thread uses libxml.
+ *
+ */
+void
+arena_xml_setup(void);
+
+#endif
@@ -0,0 +1,298 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the operations on described struct fields */
+
+#include "field.h" // includes glib.h
+
+#include <string.h>
+
+/**
+ * Tells whether a field holds the same value in two structs. Strings are
+ * compared by contents.
+ *
+ * @param field Pointer to the descriptor of the field.
+ * @param a     Pointer to the first struct.
+ * @param b     Pointer to the second struct.
+ *
+ * @return TRUE if the values are equal, FALSE otherwise.
+ */
+gboolean
+field_equal(const FieldDescriptor * field, gconstpointer a, gconstpointer b)
+{
+  switch (field->type_) {
+  case FIELD_STRING:
+  case FIELD_CONST_STRING:
+    {
+      const gchar * x = G_STRUCT_MEMBER(const gchar *, a, field->offset_);
+      const gchar * y = G_STRUCT_MEMBER(const gchar *, b, field->offset_);
+
+      /* interned strings usually match by address */
+      return (x == y) || (x && y && !strcmp(x, y));
+    }
+  case FIELD_RECORDS:
+    {
+      const gchar * x = G_STRUCT_MEMBER(const gchar *, a, field->offset_);
+      const gchar * y = G_STRUCT_MEMBER(const gchar *, b, field->offset_);
+
+      glong lengthoffset = field->offset_ + sizeof(const gchar *);
+
+      gsize len = G_STRUCT_MEMBER(gsize, a, lengthoffset);
+
+      return (len == G_STRUCT_MEMBER(gsize, b, lengthoffset)) &&
+             (x == y || !len || !memcmp(x, y, len));
+    }
+  case FIELD_CHAR:
+    return G_STRUCT_MEMBER(gchar, a, field->offset_) ==
+           G_STRUCT_MEMBER(gchar, b, field->offset_);
+  case FIELD_INT:
+    return G_STRUCT_MEMBER(gint, a, field->offset_) ==
+           G_STRUCT_MEMBER(gint, b, field->offset_);
+  case FIELD_UINT:
+    return G_STRUCT_MEMBER(guint, a, field->offset_) ==
+           G_STRUCT_MEMBER(guint, b, field->offset_);
+  case FIELD_BOOLEAN:
+    return !G_STRUCT_MEMBER(gboolean, a, field->offset_) ==
+           !G_STRUCT_MEMBER(gboolean, b, field->offset_);
+  case FIELD_DOUBLE:
+    return G_STRUCT_MEMBER(gdouble, a, field->offset_) ==
+           G_STRUCT_MEMBER(gdouble, b, field->offset_);
+  }
+
+  return FALSE;
+}
+
+/**
+ * Copies a field from one struct into another. Owned strings are
+ * duplicated, anything else is copied as-is.
+ *
+ * @param field Pointer to the descriptor of the field.
+ * @param dst   Pointer to the struct to copy into, whose value is
+ *              overwritten without being released.
+ * @param src   Pointer to the struct to copy from.
+ */
+void
+field_copy(const FieldDescriptor * field, gpointer dst, gconstpointer src)
+{
+  switch (field->type_) {
+  case FIELD_STRING:
+    G_STRUCT_MEMBER(gchar *, dst, field->offset_) =
+      g_strdup(G_STRUCT_MEMBER(const gchar *, src, field->offset_));
+    break;
+  case FIELD_CONST_STRING:
+    G_STRUCT_MEMBER(const gchar *, dst, field->offset_) =
+      G_STRUCT_MEMBER(const gchar *, src, field->offset_);
+    break;
+  case FIELD_RECORDS:
+    G_STRUCT_MEMBER(const gchar *, dst, field->offset_) =
+      G_STRUCT_MEMBER(const gchar *, src, field->offset_);
+    G_STRUCT_MEMBER(gsize, dst, field->offset_ + sizeof(const gchar *)) =
+      G_STRUCT_MEMBER(gsize, src, field->offset_ + sizeof(const gchar *));
+    break;
+  case FIELD_CHAR:
+    G_STRUCT_MEMBER(gchar, dst, field->offset_) =
+      G_STRUCT_MEMBER(gchar, src, field->offset_);
+    break;
+  case FIELD_INT:
+    G_STRUCT_MEMBER(gint, dst, field->offset_) =
+      G_STRUCT_MEMBER(gint, src, field->offset_);
+    break;
+  case FIELD_UINT:
+    G_STRUCT_MEMBER(guint, dst, field->offset_) =
+      G_STRUCT_MEMBER(guint, src, field->offset_);
+    break;
+  case FIELD_BOOLEAN:
+    G_STRUCT_MEMBER(gboolean, dst, field->offset_) =
+      G_STRUCT_MEMBER(gboolean, src, field->offset_);
+    break;
+  case FIELD_DOUBLE:
+    G_STRUCT_MEMBER(gdouble, dst, field->offset_) =
+      G_STRUCT_MEMBER(gdouble, src, field->offset_);
+    break;
+  }
+}
+
+/**
+ * Releases what a field owns, and resets it to zero.
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ */
+void
+field_clear(const FieldDescriptor * field, gpointer object)
+{
+  switch (field->type_) {
+  case FIELD_STRING:
+    g_free(G_STRUCT_MEMBER(gchar *, object, field->offset_));
+    G_STRUCT_MEMBER(gchar *, object, field->offset_) = NULL;
+    break;
+  case FIELD_CONST_STRING:
+    G_STRUCT_MEMBER(const gchar *, object, field->offset_) = NULL;
+    break;
+  case FIELD_RECORDS:
+    G_STRUCT_MEMBER(const gchar *, object, field->offset_) = NULL;
+    G_STRUCT_MEMBER(gsize, object, field->offset_ + sizeof(const gchar *)) = 0;
+    break;
+  case FIELD_CHAR:
+    G_STRUCT_MEMBER(gchar, object, field->offset_) = '\0';
+    break;
+  case FIELD_INT:
+    G_STRUCT_MEMBER(gint, object, field->offset_) = 0;
+    break;
+  case FIELD_UINT:
+    G_STRUCT_MEMBER(guint, object, field->offset_) = 0;
+    break;
+  case FIELD_BOOLEAN:
+    G_STRUCT_MEMBER(gboolean, object, field->offset_) = FALSE;
+    break;
+  case FIELD_DOUBLE:
+    G_STRUCT_MEMBER(gdouble, object, field->offset_) = 0.0;
+    break;
+  }
+}
+
+/**
+ * Sets a field from its textual form, as produced by field_format().
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ * @param value  The text, need not be NUL-terminated, may be NULL to clear
+ *               a string.
+ * @param len    Length of the text.
+ *
+ * @return TRUE if the field was set, FALSE if it cannot be set from text.
+ */
+gboolean
+field_parse(const FieldDescriptor * field,
+            gpointer                object,
+            const gchar           * value,
+            gsize                   len)
+{
+  if (field->type_ == FIELD_STRING) {
+    g_free(G_STRUCT_MEMBER(gchar *, object, field->offset_));
+
+    G_STRUCT_MEMBER(gchar *, object, field->offset_) = g_strndup(value, len);
+
+    return TRUE;
+  }
+
+  if (!value || field->type_ == FIELD_CONST_STRING ||
+      field->type_ == FIELD_RECORDS) {
+    /* nothing here could own the text */
+    return FALSE;
+  }
+
+  if (field->type_ == FIELD_CHAR) {
+    G_STRUCT_MEMBER(gchar, object, field->offset_) = (len) ? value[0] : '\0';
+
+    return TRUE;
+  }
+
+  /* numbers are short, anything longer is not one */
+  gchar text[64];
+
+  if (len >= sizeof(text)) {
+    return FALSE;
+  }
+
+  memcpy(text, value, len);
+
+  text[len] = '\0';
+
+  switch (field->type_) {
+  case FIELD_INT:
+    G_STRUCT_MEMBER(gint, object, field->offset_) =
+      (gint)g_ascii_strtoll(text, NULL, 10);
+    break;
+  case FIELD_UINT:
+    G_STRUCT_MEMBER(guint, object, field->offset_) =
+      (guint)g_ascii_strtoull(text, NULL, 10);
+    break;
+  case FIELD_BOOLEAN:
+    /* the spellings GKeyFile accepts */
+    G_STRUCT_MEMBER(gboolean, object, field->offset_) =
+      (!strcmp(text, "true") || !strcmp(text, "1"));
+    break;
+  case FIELD_DOUBLE:
+    G_STRUCT_MEMBER(gdouble, object, field->offset_) =
+      g_ascii_strtod(text, NULL);
+    break;
+  default:
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * Returns the textual form of a field, in the format of key files.
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ *
+ * @return The text, to be freed with g_free(), or NULL for an unset string.
+ *         The records of FIELD_RECORDS are separated by commas.
+ */
+gchar *
+field_format(const FieldDescriptor * field, gconstpointer object)
+{
+  gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+  switch (field->type_) {
+  case FIELD_STRING:
+  case FIELD_CONST_STRING:
+    return g_strdup(G_STRUCT_MEMBER(const gchar *, object, field->offset_));
+  case FIELD_RECORDS:
+    {
+      const gchar * records = G_STRUCT_MEMBER(const gchar *, object, field->offset_);
+
+      gsize len = G_STRUCT_MEMBER(gsize, object, field->offset_ + sizeof(const gchar *));
+
+      if (!records) {
+        return NULL;
+      }
+
+      gchar * text = g_strndup(records, len);
+
+      gsize i = 0;
+      for (; len && i < len - 1; ++i) {
+        if (!text[i]) {
+          text[i] = ',';
+        }
+      }
+
+      return text;
+    }
+  case FIELD_CHAR:
+    return g_strndup(&G_STRUCT_MEMBER(gchar, object, field->offset_), 1);
+  case FIELD_INT:
+    return g_strdup_printf("%d", G_STRUCT_MEMBER(gint, object, field->offset_));
+  case FIELD_UINT:
+    return g_strdup_printf("%u", G_STRUCT_MEMBER(guint, object, field->offset_));
+  case FIELD_BOOLEAN:
+    return g_strdup((G_STRUCT_MEMBER(gboolean, object, field->offset_)) ? "true"
+                                                                        : "false");
+  case FIELD_DOUBLE:
+    return g_strdup(g_ascii_dtostr(buffer, sizeof(buffer),
+                                   G_STRUCT_MEMBER(gdouble, object, field->offset_)));
+  }
+
+  return NULL;
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Describes the fields of a struct, so that bulk operations can walk them */
+
+#ifndef LXWEATHER_FIELD_HEADER
+#define LXWEATHER_FIELD_HEADER
+
+#include <glib.h>
+
+/* What a field holds, and so how it is copied, compared and printed */
+typedef enum
+{
+  FIELD_STRING       = 0, // gchar *, owned by the struct
+  FIELD_CONST_STRING = 1, // const gchar *, owned by somebody else
+  FIELD_RECORDS      = 2, // const gchar * to NUL-separated records, the
+                          // gsize length of which is the next member
+  FIELD_CHAR         = 3,
+  FIELD_INT          = 4, // gint, or an enum
+  FIELD_UINT         = 5,
+  FIELD_BOOLEAN      = 6,
+  FIELD_DOUBLE       = 7
+} FieldType;
+
+typedef struct
+{
+  const gchar * name_;
+  FieldType     type_;
+  glong         offset_;
+  guint         flag_;    // up to the struct, such as the bit it changes
+} FieldDescriptor;
+
+/* Expands to the descriptor of one member of a struct */
+#define FIELD_DESCRIBE(type, name, kind, member, flag) \
+  { name, kind, G_STRUCT_OFFSET(type, member), flag }
+
+/**
+ * Tells whether a field holds the same value in two structs. Strings are
+ * compared by contents.
+ *
+ * @param field Pointer to the descriptor of the field.
+ * @param a     Pointer to the first struct.
+ * @param b     Pointer to the second struct.
+ *
+ * @return TRUE if the values are equal, FALSE otherwise.
+ */
+gboolean
+field_equal(const FieldDescriptor * field, gconstpointer a, gconstpointer b);
+
+/**
+ * Copies a field from one struct into another. Owned strings are
+ * duplicated, anything else is copied as-is.
+ *
+ * @param field Pointer to the descriptor of the field.
+ * @param dst   Pointer to the struct to copy into, whose value is
+ *              overwritten without being released.
+ * @param src   Pointer to the struct to copy from.
+ */
+void
+field_copy(const FieldDescriptor * field, gpointer dst, gconstpointer src);
+
+/**
+ * Releases what a field owns, and resets it to zero.
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ */
+void
+field_clear(const FieldDescriptor * field, gpointer object);
+
+/**
+ * Sets a field from its textual form, as produced by field_format().
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ * @param value  The text, need not be NUL-terminated, may be NULL to clear
+ *               a string.
+ * @param len    Length of the text.
+ *
+ * @return TRUE if the field was set, FALSE if it cannot be set from text.
+ */
+gboolean
+field_parse(const FieldDescriptor * field,
+            gpointer                object,
+            const gchar           * value,
+            gsize                   len);
+
+/**
+ * Returns the textual form of a field, in the format of key files.
+ *
+ * @param field  Pointer to the descriptor of the field.
+ * @param object Pointer to the struct.
+ *
+ * @return The text, to be freed with g_free(), or NULL for an unset string.
+ *         The records of FIELD_RECORDS are separated by commas.
+ */
+gchar *
+field_format(const FieldDescriptor * field, gconstpointer object);
+
+#endif
@@ -259,57 +259,42 @@ location_list_fill(GList ** list, GKeyFile * keyfile)
         continue;
       }
 
-      gchar * city = g_key_file_get_string(keyfile,
-                                           groupnames[groupidx],
-                                           LocationInfoFieldNames[CITY],
-                                           NULL);
+      LocationInfo * location = (LocationInfo *)location_new();
 
-      gchar * state = g_key_file_get_string(keyfile,
-                                            groupnames[groupidx],
-                                            LocationInfoFieldNames[STATE],
-                                            NULL);
-
-      gchar * country = g_key_file_get_string(keyfile,
-                                              groupnames[groupidx],
-                                              LocationInfoFieldNames[COUNTRY],
-                                              NULL);
-
-      gchar * units = g_key_file_get_string(keyfile,
-                                            groupnames[groupidx],
-                                            LocationInfoFieldNames[UNITS],
-                                            NULL);
-
-      gint interval = g_key_file_get_integer(keyfile,
-                                             groupnames[groupidx],
-                                             LocationInfoFieldNames[INTERVAL],
-                                             NULL);
+      if (location) {
+        gint f = 0;
+        for (; f < LOCATIONINFO_FIELD_COUNT; ++f) {
+          const FieldDescriptor * field = &LocationInfoFields[f];
 
-      gboolean enabled = g_key_file_get_boolean(keyfile,
+          gchar * value = (f == WOEID) ? woeid :
+                          (f == ALIAS) ? alias :
+                          g_key_file_get_string(keyfile,
                                                 groupnames[groupidx],
-                                                LocationInfoFieldNames[ENABLED],
+                                                field->name_,
                                                 NULL);
 
-      LocationInfo * location = g_try_new0(LocationInfo, 1);
+          if (value) {
+            field_parse(field, location, value, strlen(value));
+          }
 
-      if (location) {
-        location->alias_     = g_strndup(alias, strlen(alias));
-        location->city_      = (city)?g_strndup(city, strlen(city)):NULL;
-        location->state_     = (state)?g_strndup(state, strlen(state)):NULL;
-        location->country_   = (country)?g_strndup(country, strlen(country)):NULL;
-        location->woeid_     = g_strndup(woeid, strlen(woeid));
-        location->units_     = units ? units[0] : 'f';
-        location->interval_  = (interval > 0) ? interval : 1;
-        location->enabled_   = enabled;
+          if (value != woeid && value != alias) {
+            g_free(value);
+          }
+        }
+
+        if (!location->units_) {
+          location->units_ = 'f';
+        }
+
+        if (!location->interval_ || location->interval_ > G_MAXINT) {
+          location->interval_ = 1;
+        }
 
         *list = g_list_prepend(*list, location);
       }
 
       g_free(alias);
-      g_free(city);
-      g_free(state);
-      g_free(country);
       g_free(woeid);
-      g_free(units);
     }
 
     /* Free the token list */
@@ -343,46 +328,23 @@ key_file_fill(GKeyFile ** keyfile, GList * list)
     if (location) {
       gchar * group = g_strdup_printf("Location %d", i + 1);
 
-      g_key_file_set_string(*keyfile, group, 
-                            LocationInfoFieldNames[ALIAS],
-                            location->alias_);
-          
-      if (location->city_) {
-        g_key_file_set_string(*keyfile, group, 
-                              LocationInfoFieldNames[CITY],
-                              location->city_);
-      }
+      gint f = 0;
+      for (; f < LOCATIONINFO_FIELD_COUNT; ++f) {
+        const FieldDescriptor * field = &LocationInfoFields[f];
 
-      if (location->state_) {
-        g_key_file_set_string(*keyfile, group, 
-                              LocationInfoFieldNames[STATE],
-                              location->state_);
-      }
+        gchar * value = field_format(field, location);
 
-      if (location->country_) {
-        g_key_file_set_string(*keyfile, group, 
-                              LocationInfoFieldNames[COUNTRY],
-                              location->country_);
-      }
+        /* strings are escaped, the rest is written as formatted */
+        if (!value) {
+          /* unset strings are left out */
+        } else if (field->type_ == FIELD_STRING) {
+          g_key_file_set_string(*keyfile, group, field->name_, value);
+        } else {
+          g_key_file_set_value(*keyfile, group, field->name_, value);
+        }
 
-      g_key_file_set_string(*keyfile,
-                            group,
-                            LocationInfoFieldNames[WOEID],
-                            location->woeid_);
-          
-      g_key_file_set_string(*keyfile,
-                            group, 
-                            LocationInfoFieldNames[UNITS],
-                            &location->units_);
-          
-      g_key_file_set_integer(*keyfile,
-                             group, 
-                             LocationInfoFieldNames[INTERVAL],
-                             (gint)location->interval_);
-          
-      g_key_file_set_boolean(*keyfile, group,
-                             LocationInfoFieldNames[ENABLED],
-                             location->enabled_);
+        g_free(value);
+      }
 
       g_free(group);
 
@@ -0,0 +1,413 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the fleet table: the hot state of every location, column-wise */
+
+#include "fleet.h"
+#include "forecast.h"
+#include "logutil.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <glib.h>
+
+/* Rows the table starts out with, it doubles from there */
+#define FLEET_INITIAL_CAPACITY 16
+
+/*
+ * One array per field, indexed by row, so that a query over the whole
+ * fleet reads only the columns it needs, front to back. Rows are kept
+ * dense: removing one moves the last row into its place.
+ */
+typedef struct
+{
+  guint        count_;
+  guint        capacity_;
+  GHashTable * rows_;         // WOEID (from woeid_) to row + 1
+  gchar     ** woeid_;
+  guint      * refs_;
+  guint      * interval_;     // minutes, 0 if never stale
+  guint8     * status_;       // FleetStatus
+  gchar      * units_;        // of the temperature, c|f
+  gint64     * attached_;     // monotonic time the row was created
+  gint64     * updated_;      // monotonic time of the last forecast, 0 if none
+  gint       * temperature_;
+  gint       * code_;
+  gint       * humidity_;
+  gint       * windSpeed_;
+  gdouble    * pressure_;
+} FleetTable;
+
+static pthread_rwlock_t g_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static FleetTable g_fleet;
+
+#define FLEET_COLUMN_RESIZE(column, capacity) \
+  (g_fleet.column = g_realloc(g_fleet.column, (capacity) * sizeof(*g_fleet.column)))
+
+/**
+ * Returns the row of the specified location. Call with the lock held.
+ *
+ * @param woeid The WOEID of the location.
+ *
+ * @return The row, or -1 if the location is not in the table.
+ */
+static gint
+row_find(const gchar * woeid)
+{
+  if (!g_fleet.rows_ || !woeid) {
+    return -1;
+  }
+
+  return GPOINTER_TO_INT(g_hash_table_lookup(g_fleet.rows_, woeid)) - 1;
+}
+
+/**
+ * Makes room for one more row. Call with the write lock held.
+ *
+ */
+static void
+table_grow(void)
+{
+  if (!g_fleet.rows_) {
+    g_fleet.rows_ = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+
+  if (g_fleet.count_ < g_fleet.capacity_) {
+    return;
+  }
+
+  guint capacity = (g_fleet.capacity_) ? 2 * g_fleet.capacity_ : FLEET_INITIAL_CAPACITY;
+
+  FLEET_COLUMN_RESIZE(woeid_, capacity);
+  FLEET_COLUMN_RESIZE(refs_, capacity);
+  FLEET_COLUMN_RESIZE(interval_, capacity);
+  FLEET_COLUMN_RESIZE(status_, capacity);
+  FLEET_COLUMN_RESIZE(units_, capacity);
+  FLEET_COLUMN_RESIZE(attached_, capacity);
+  FLEET_COLUMN_RESIZE(updated_, capacity);
+  FLEET_COLUMN_RESIZE(temperature_, capacity);
+  FLEET_COLUMN_RESIZE(code_, capacity);
+  FLEET_COLUMN_RESIZE(humidity_, capacity);
+  FLEET_COLUMN_RESIZE(windSpeed_, capacity);
+  FLEET_COLUMN_RESIZE(pressure_, capacity);
+
+  g_fleet.capacity_ = capacity;
+}
+
+/**
+ * Copies one row over another. Call with the write lock held.
+ *
+ * @param dst The row to overwrite.
+ * @param src The row to copy.
+ */
+static void
+row_move(guint dst, guint src)
+{
+  g_fleet.woeid_[dst]       = g_fleet.woeid_[src];
+  g_fleet.refs_[dst]        = g_fleet.refs_[src];
+  g_fleet.interval_[dst]    = g_fleet.interval_[src];
+  g_fleet.status_[dst]      = g_fleet.status_[src];
+  g_fleet.units_[dst]       = g_fleet.units_[src];
+  g_fleet.attached_[dst]    = g_fleet.attached_[src];
+  g_fleet.updated_[dst]     = g_fleet.updated_[src];
+  g_fleet.temperature_[dst] = g_fleet.temperature_[src];
+  g_fleet.code_[dst]        = g_fleet.code_[src];
+  g_fleet.humidity_[dst]    = g_fleet.humidity_[src];
+  g_fleet.windSpeed_[dst]   = g_fleet.windSpeed_[src];
+  g_fleet.pressure_[dst]    = g_fleet.pressure_[src];
+
+  g_hash_table_insert(g_fleet.rows_, g_fleet.woeid_[dst], GUINT_TO_POINTER(dst + 1));
+}
+
+/**
+ * Returns whether a row missed two of its refresh intervals.
+ *
+ * @param row The row.
+ * @param now The monotonic time to measure against.
+ *
+ * @return TRUE if the row is stale, FALSE otherwise.
+ */
+static inline gboolean
+row_stale(guint row, gint64 now)
+{
+  /* locations without a forecast count from when they were attached */
+  gint64 since = (g_fleet.updated_[row]) ? g_fleet.updated_[row] : g_fleet.attached_[row];
+
+  return g_fleet.interval_[row] &&
+    now - since > (gint64)g_fleet.interval_[row] * 2 * 60 * G_USEC_PER_SEC;
+}
+
+/**
+ * Adds a reference to the row of the specified location, creating the row
+ * if the location is not in the table yet.
+ *
+ * @param woeid The WOEID of the location.
+ */
+void
+fleet_attach(const gchar * woeid)
+{
+  g_return_if_fail(woeid != NULL);
+
+  pthread_rwlock_wrlock(&g_lock);
+
+  gint row = row_find(woeid);
+
+  if (row < 0) {
+    table_grow();
+
+    row = g_fleet.count_++;
+
+    g_fleet.woeid_[row]       = g_strdup(woeid);
+    g_fleet.refs_[row]        = 0;
+    g_fleet.interval_[row]    = 0;
+    g_fleet.status_[row]      = FLEET_PENDING;
+    g_fleet.units_[row]       = 'f';
+    g_fleet.attached_[row]    = g_get_monotonic_time();
+    g_fleet.updated_[row]     = 0;
+    g_fleet.temperature_[row] = 0;
+    g_fleet.code_[row]        = 0;
+    g_fleet.humidity_[row]    = 0;
+    g_fleet.windSpeed_[row]   = 0;
+    g_fleet.pressure_[row]    = 0.0;
+
+    g_hash_table_insert(g_fleet.rows_, g_fleet.woeid_[row], GINT_TO_POINTER(row + 1));
+  }
+
+  ++g_fleet.refs_[row];
+
+  pthread_rwlock_unlock(&g_lock);
+}
+
+/**
+ * Drops a reference to the row of the specified location, removing the
+ * row with the last one.
+ *
+ * @param woeid The WOEID of the location, may be NULL.
+ */
+void
+fleet_detach(const gchar * woeid)
+{
+  pthread_rwlock_wrlock(&g_lock);
+
+  gint row = row_find(woeid);
+
+  if (row >= 0 && !--g_fleet.refs_[row]) {
+    g_hash_table_remove(g_fleet.rows_, g_fleet.woeid_[row]);
+
+    g_free(g_fleet.woeid_[row]);
+
+    if ((guint)row != --g_fleet.count_) {
+      row_move(row, g_fleet.count_);
+    }
+  }
+
+  pthread_rwlock_unlock(&g_lock);
+}
+
+/**
+ * Sets how often the specified location is refreshed.
+ *
+ * @param woeid    The WOEID of the location.
+ * @param interval The refresh interval in minutes, 0 if the location is not
+ *                 refreshed on its own and never goes stale.
+ */
+void
+fleet_schedule(const gchar * woeid, guint interval)
+{
+  pthread_rwlock_wrlock(&g_lock);
+
+  gint row = row_find(woeid);
+
+  if (row >= 0) {
+    g_fleet.interval_[row] = interval;
+  }
+
+  pthread_rwlock_unlock(&g_lock);
+}
+
+/**
+ * Records the outcome of a refresh of the specified location. Locations
+ * that are not in the table are ignored.
+ *
+ * @param woeid    The WOEID of the location.
+ * @param forecast Pointer to the new forecast, or NULL if the response did
+ *                 not change since the last one.
+ * @param failed   Whether the refresh failed, forecast is NULL then.
+ */
+void
+fleet_update(const gchar * woeid, gconstpointer forecast, gboolean failed)
+{
+  const ForecastInfo * info = (const ForecastInfo *)forecast;
+
+  pthread_rwlock_wrlock(&g_lock);
+
+  gint row = row_find(woeid);
+
+  if (row < 0) {
+    pthread_rwlock_unlock(&g_lock);
+
+    return;
+  }
+
+  if (failed) {
+    /* the last values stay, they are still the best known */
+    g_fleet.status_[row] = FLEET_FAILED;
+  } else if (info) {
+    const gchar * units = info->units_.temperature_;
+
+    g_fleet.status_[row]      = FLEET_CURRENT;
+    g_fleet.units_[row]       = (units && g_ascii_tolower(units[0]) == 'c') ? 'c' : 'f';
+    g_fleet.updated_[row]     = g_get_monotonic_time();
+    g_fleet.temperature_[row] = info->temperature_;
+    g_fleet.code_[row]        = info->code_;
+    g_fleet.humidity_[row]    = info->humidity_;
+    g_fleet.windSpeed_[row]   = info->windSpeed_;
+    g_fleet.pressure_[row]    = info->pressure_;
+  } else if (g_fleet.updated_[row]) {
+    /* an unchanged response confirms the values held */
+    g_fleet.status_[row]  = FLEET_CURRENT;
+    g_fleet.updated_[row] = g_get_monotonic_time();
+  }
+
+  pthread_rwlock_unlock(&g_lock);
+}
+
+/**
+ * Computes the state of the whole fleet in a single pass over the table.
+ *
+ * @param now     The monotonic time to measure staleness against.
+ * @param summary Pointer to the summary to fill in.
+ */
+void
+fleet_summary(gint64 now, FleetSummary * summary)
+{
+  g_return_if_fail(summary != NULL);
+
+  memset(summary, 0, sizeof(FleetSummary));
+
+  gdouble minimum     = G_MAXDOUBLE;
+  gdouble maximum     = -G_MAXDOUBLE;
+  gdouble temperature = 0.0;
+  gdouble humidity    = 0.0;
+
+  pthread_rwlock_rdlock(&g_lock);
+
+  guint row = 0;
+
+  for (; row < g_fleet.count_; ++row) {
+    ++summary->status_[g_fleet.status_[row]];
+
+    summary->stale_ += row_stale(row, now);
+
+    if (!g_fleet.updated_[row]) {
+      continue;
+    }
+
+    gdouble celsius = (g_fleet.units_[row] == 'c') ?
+      g_fleet.temperature_[row] : (g_fleet.temperature_[row] - 32) * 5.0 / 9.0;
+
+    minimum = MIN(minimum, celsius);
+    maximum = MAX(maximum, celsius);
+
+    temperature += celsius;
+    humidity    += g_fleet.humidity_[row];
+
+    ++summary->reporting_;
+  }
+
+  summary->rows_ = g_fleet.count_;
+
+  pthread_rwlock_unlock(&g_lock);
+
+  if (summary->reporting_) {
+    summary->temperatureMin_  = minimum;
+    summary->temperatureMax_  = maximum;
+    summary->temperatureMean_ = temperature / summary->reporting_;
+    summary->humidityMean_    = humidity / summary->reporting_;
+  }
+}
+
+/**
+ * Logs the summary of the fleet.
+ *
+ */
+void
+fleet_stats_log(void)
+{
+  FleetSummary summary;
+
+  fleet_summary(g_get_monotonic_time(), &summary);
+
+  LXW_LOG(LXW_DEBUG,
+          "fleet: %u locations, %u pending, %u current, %u failed, %u stale",
+          summary.rows_,
+          summary.status_[FLEET_PENDING],
+          summary.status_[FLEET_CURRENT],
+          summary.status_[FLEET_FAILED],
+          summary.stale_);
+
+  if (summary.reporting_) {
+    LXW_LOG(LXW_DEBUG,
+            "fleet: %.1fC to %.1fC, %.1fC and %.0f%% humidity on average",
+            summary.temperatureMin_,
+            summary.temperatureMax_,
+            summary.temperatureMean_,
+            summary.humidityMean_);
+  }
+}
+
+/**
+ * Releases the table.
+ *
+ */
+void
+fleet_cleanup(void)
+{
+  pthread_rwlock_wrlock(&g_lock);
+
+  guint row = 0;
+
+  for (; row < g_fleet.count_; ++row) {
+    g_free(g_fleet.woeid_[row]);
+  }
+
+  if (g_fleet.rows_) {
+    g_hash_table_destroy(g_fleet.rows_);
+  }
+
+  g_free(g_fleet.woeid_);
+  g_free(g_fleet.refs_);
+  g_free(g_fleet.interval_);
+  g_free(g_fleet.status_);
+  g_free(g_fleet.units_);
+  g_free(g_fleet.attached_);
+  g_free(g_fleet.updated_);
+  g_free(g_fleet.temperature_);
+  g_free(g_fleet.code_);
+  g_free(g_fleet.humidity_);
+  g_free(g_fleet.windSpeed_);
+  g_free(g_fleet.pressure_);
+
+  memset(&g_fleet, 0, sizeof(FleetTable));
+
+  pthread_rwlock_unlock(&g_lock);
+}
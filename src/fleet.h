@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the fleet table: the hot state of every location, column-wise */
+
+#ifndef LXWEATHER_FLEET_HEADER
+#define LXWEATHER_FLEET_HEADER
+
+#include <glib.h>
+
+/* Where the refreshes of a location stand */
+typedef enum
+{
+  FLEET_PENDING,   // no forecast yet
+  FLEET_CURRENT,   // the last refresh succeeded
+  FLEET_FAILED,    // the last refresh failed
+  FLEET_STATUS_COUNT
+} FleetStatus;
+
+/* The state of the whole fleet, as computed by fleet_summary() */
+typedef struct
+{
+  guint   rows_;
+  guint   status_[FLEET_STATUS_COUNT];
+  guint   stale_;           // missed two of their refresh intervals
+  guint   reporting_;       // rows with a forecast, used for the rest
+  gdouble temperatureMin_;  // in degrees Celsius
+  gdouble temperatureMax_;
+  gdouble temperatureMean_;
+  gdouble humidityMean_;
+} FleetSummary;
+
+/**
+ * Adds a reference to the row of the specified location, creating the row
+ * if the location is not in the table yet.
+ *
+ * @param woeid The WOEID of the location.
+ */
+void
+fleet_attach(const gchar * woeid);
+
+/**
+ * Drops a reference to the row of the specified location, removing the
+ * row with the last one.
+ *
+ * @param woeid The WOEID of the location, may be NULL.
+ */
+void
+fleet_detach(const gchar * woeid);
+
+/**
+ * Sets how often the specified location is refreshed.
+ *
+ * @param woeid    The WOEID of the location.
+ * @param interval The refresh interval in minutes, 0 if the location is not
+ *                 refreshed on its own and never goes stale.
+ */
+void
+fleet_schedule(const gchar * woeid, guint interval);
+
+/**
+ * Records the outcome of a refresh of the specified location. Locations
+ * that are not in the table are ignored.
+ *
+ * @param woeid    The WOEID of the location.
+ * @param forecast Pointer to the new forecast, or NULL if the response did
+ *                 not change since the last one.
+ * @param failed   Whether the refresh failed, forecast is NULL then.
+ */
+void
+fleet_update(const gchar * woeid, gconstpointer forecast, gboolean failed);
+
+/**
+ * Computes the state of the whole fleet in a single pass over the table.
+ *
+ * @param now     The monotonic time to measure staleness against.
+ * @param summary Pointer to the summary to fill in.
+ */
+void
+fleet_summary(gint64 now, FleetSummary * summary);
+
+/**
+ * Logs the summary of the fleet.
+ *
+ */
+void
+fleet_stats_log(void);
+
+/**
+ * Releases the table.
+ *
+ */
+void
+fleet_cleanup(void);
+
+#endif
@@ -21,91 +21,211 @@
 /* Provides implementation for ForecastInfo-specific functions */
 
 #include "forecast.h" // includes glib.h
+#include "intern.h"
 #include "logutil.h"
+#include "slabpool.h"
 
 #include <stdio.h>
 #include <string.h>
 
-#define SAFE_STRNDUP(p, v)                       \
-  do {                                           \
-    if (!v) break;                               \
-    p = g_strndup((v), strlen(v));               \
-  } while (0);
+#include <pthread.h>
+
+/* Last version handed out by forecast_version_stamp() */
+static volatile gint g_version = 0;
+
+/* Serializes the lazy decoding of the multi-day records */
+static pthread_mutex_t g_days_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Both the forecasts being parsed and the committed ones, which carry
+ * their strings, come in blocks of one size */
+static SlabPool g_pool = SLABPOOL_INIT("forecast", FORECAST_BLOCK_SIZE);
+
+#define FORECASTINFO_FIELD_DESCRIBE(id, name, type, member, change) \
+  FIELD_DESCRIBE(ForecastInfo, name, type, member, change),
+
+const FieldDescriptor ForecastInfoFields[] = {
+  FORECASTINFO_FIELDS(FORECASTINFO_FIELD_DESCRIBE)
+};
+
+/* The pressure state is described as a FIELD_INT */
+G_STATIC_ASSERT(sizeof(PressureState) == sizeof(gint));
+
+/* FIELD_RECORDS finds the length right after the records */
+G_STATIC_ASSERT(G_STRUCT_OFFSET(ForecastInfo, daysRawLen_) ==
+                G_STRUCT_OFFSET(ForecastInfo, daysRaw_) + sizeof(const gchar *));
 
 /**
- * Provides the mechanism to free all data associated with
- * the ForecastDay structure
- *
- * @param day Entry to free.
+ * Decodes the compact multi-day records into the days_ array. The strings
+ * are left in place, only the numeric fields are converted. Empty day
+ * names and conditions are left NULL.
  *
+ * @param info Pointer to the forecast to decode.
  */
 static void
-forecast_forecastday_free(ForecastDay * day)
+forecast_days_decode(ForecastInfo * info)
 {
-  g_free(day->day_);
-  g_free(day->conditions_);
+  memset(info->days_, 0, sizeof(info->days_));
+
+  const gchar * curr = info->daysRaw_;
+  const gchar * end  = info->daysRaw_ + info->daysRawLen_;
+
+  int i = 0;
+  for (; curr && curr < end && i < FORECAST_MAX_DAYS; i++) {
+    ForecastDay * day = &(info->days_[i]);
+
+    gsize len = strlen(curr);
+
+    day->day_ = (len) ? intern_string(curr, len) : NULL;
+
+    if (len && !day->day_) {
+      day->day_ = curr;
+    }
+
+    curr += len + 1;
+
+    day->high_ = (gint)g_ascii_strtoll(curr, NULL, 10);
+    curr += strlen(curr) + 1;
+
+    day->low_ = (gint)g_ascii_strtoll(curr, NULL, 10);
+    curr += strlen(curr) + 1;
+
+    day->code_ = (gint)g_ascii_strtoll(curr, NULL, 10);
+    curr += strlen(curr) + 1;
+
+    len = strlen(curr);
+
+    day->conditions_ = (len) ? intern_string(curr, len) : NULL;
+
+    if (len && !day->conditions_) {
+      day->conditions_ = curr;
+    }
+
+    curr += len + 1;
+  }
+
+  info->daysVersion_ = info->version_;
 }
 
 /**
- * Provides the mechanism to copy all data associated with
- * the ForecastDay structure
+ * Finds the fields of a forecast that differ from another one.
  *
- * @param dst Pointer to copy to.
- * @param src Pointer to copy from.
+ * @param info Pointer to the newly committed forecast.
+ * @param base Pointer to the forecast it was parsed over.
+ *
+ * @return Mask of ForecastChange bits.
  */
-static void
-forecast_forecastday_copy(ForecastDay * dst, ForecastDay * src)
+static guint
+forecast_diff(const ForecastInfo * info, const ForecastInfo * base)
 {
-  SAFE_STRNDUP(dst->day_,        src->day_);
-  SAFE_STRNDUP(dst->conditions_, src->conditions_);
+  guint changed = 0;
 
-  dst->high_ = src->high_;
-  dst->low_  = src->low_;
-  dst->code_ = src->code_;
+  gint f = 0;
+  for (; f < FORECASTINFO_FIELD_COUNT; ++f) {
+    const FieldDescriptor * field = &ForecastInfoFields[f];
+
+    /* fields sharing a bit need not all be compared */
+    if (!(changed & field->flag_) && !field_equal(field, info, base)) {
+      changed |= field->flag_;
+    }
+  }
+
+  return changed;
 }
 
 /**
- * Provides the mechanism to free all data associated with
- * the ForecastUnits structure
- *
- * @param units Entry to free.
+ * Allocates an empty forecast holding a single reference.
  *
+ * @return Pointer to the new forecast, or NULL if the allocation failed.
  */
-static void
-forecast_units_free(ForecastUnits * units)
+gpointer
+forecast_new(void)
 {
-  g_free(units->distance_);
-  g_free(units->pressure_);
-  g_free(units->speed_);
-  g_free(units->temperature_);
+  ForecastInfo * info = slabpool_alloc0(&g_pool);
+
+  if (info) {
+    info->pooled_   = TRUE;
+    info->refcount_ = 1;
+  }
+
+  return info;
 }
 
 /**
- * Provides the mechanism to copy all data associated with
- * the ForecastUnits structure
+ * Allocates a private copy of a forecast for the parser to update in place.
+ * The copy keeps the forecast alive until it is committed, which records
+ * the fields that differ from it. Its numbers start out cleared, as its
+ * strings end up at the commit, so that whatever the response leaves out
+ * does not carry over from the previous forecast.
  *
- * @param dst Pointer to copy to.
- * @param src Pointer to copy from.
+ * @param base Pointer to the forecast to start from, may be NULL, in which
+ *             case the copy is empty.
  *
+ * @return Pointer to the new forecast, or NULL if the allocation failed.
  */
-static void
-forecast_units_copy(ForecastUnits * dst, ForecastUnits * src )
+gpointer
+forecast_derive(gpointer base)
 {
-  SAFE_STRNDUP(dst->distance_,    src->distance_);
-  SAFE_STRNDUP(dst->pressure_,    src->pressure_);
-  SAFE_STRNDUP(dst->speed_,       src->speed_);
-  SAFE_STRNDUP(dst->temperature_, src->temperature_);
+  ForecastInfo * info = forecast_new();
+
+  if (!info || !base) {
+    return info;
+  }
+
+  /* the base is shared, so its reference count is left out of the copy */
+  pthread_mutex_lock(&g_days_mutex);
+
+  memcpy(info, base, G_STRUCT_OFFSET(ForecastInfo, refcount_));
+
+  pthread_mutex_unlock(&g_days_mutex);
+
+  /* the strings still point into the base, which the copy keeps alive */
+  info->pooled_      = TRUE;
+  info->refcount_    = 1;
+  info->baseVersion_ = 0;
+  info->changed_     = 0;
+  info->base_        = forecast_ref(base);
+
+  if (info->image_) {
+    g_object_ref(info->image_);
+  }
+
+  /* the strings are left for the parser to compare, the commit clears them */
+  gint f = 0;
+  for (; f < FORECASTINFO_FIELD_COUNT; ++f) {
+    if (ForecastInfoFields[f].type_ != FIELD_CONST_STRING &&
+        ForecastInfoFields[f].type_ != FIELD_RECORDS) {
+      field_clear(&ForecastInfoFields[f], info);
+    }
+  }
+
+  return info;
 }
 
 /**
- * Provides the mechanism to free any data associated with
- * the ForecastInfo structure
+ * Takes a reference to a forecast.
+ *
+ * @param forecast Pointer to the forecast, may be NULL.
  *
- * @param forecast Entry to free.
+ * @return The forecast passed in.
+ */
+gpointer
+forecast_ref(gpointer forecast)
+{
+  if (forecast) {
+    g_atomic_int_inc(&((ForecastInfo *)forecast)->refcount_);
+  }
+
+  return forecast;
+}
+
+/**
+ * Releases a reference to a forecast, freeing any data associated with it
+ * once the last one is gone.
  *
+ * @param forecast Pointer to the forecast, may be NULL.
  */
 void
-forecast_free(gpointer forecast)
+forecast_unref(gpointer forecast)
 {
   if (!forecast) {
     return;
@@ -113,78 +233,355 @@ forecast_free(gpointer forecast)
 
   ForecastInfo * info = (ForecastInfo *)forecast;
 
-  forecast_units_free(&info->units_);
-
-  int i = 0;
-  for (; i < FORECAST_MAX_DAYS; i++) {
-    forecast_forecastday_free(&(info->days_[i]));
+  if (!g_atomic_int_dec_and_test(&info->refcount_)) {
+    return;
   }
 
-  g_free(info->windDirection_);
-  g_free(info->sunrise_);
-  g_free(info->sunset_);
-  g_free(info->conditions_);
-  g_free(info->time_);
-  g_free(info->imageURL_);
-  
   if (info->image_) {
     g_object_unref(info->image_);
   }
 
-  g_free(forecast);
+  forecast_unref(info->base_);
+
+  if (info->pooled_) {
+    slabpool_free(&g_pool, info);
+  } else {
+    g_free(info);
+  }
+}
+
+/**
+ * Stamps the forecast with a new, process-wide unique version. Done once
+ * every time the forecast is filled in by the parser, before it is shared:
+ * the version of a shared forecast never changes, see forecast_day_get().
+ *
+ * @param forecast Pointer to the forecast to stamp.
+ */
+void
+forecast_version_stamp(gpointer forecast)
+{
+  if (!forecast) {
+    return;
+  }
+
+  g_return_if_fail(g_atomic_int_get(&((ForecastInfo *)forecast)->refcount_) == 1);
+
+  /* never hand out 0, it stands for 'not decoded' */
+  gint version = 0;
+
+  do {
+    version = g_atomic_int_add(&g_version, 1) + 1;
+  } while (!version);
+
+  ((ForecastInfo *)forecast)->version_ = (guint)version;
 }
 
 /**
- * Copies a forecast entry.
+ * Returns the fields that changed since a given version of the forecast was
+ * seen. The answer is exact when that version is the one the forecast was
+ * parsed over, and FORECAST_CHANGED_ALL when it is unknown.
+ *
+ * @param forecast Pointer to the forecast, may be NULL.
+ * @param since    Version of the forecast last seen, 0 if none.
  *
- * @param dst Address of the pointer to the forecast to set.
- * @param src Pointer to the forecast to use/copy.
+ * @return Mask of ForecastChange bits.
+ */
+guint
+forecast_changes(gconstpointer forecast, guint since)
+{
+  const ForecastInfo * info = (const ForecastInfo *)forecast;
+
+  if (!info || !since) {
+    return FORECAST_CHANGED_ALL;
+  }
+
+  if (info->version_ == since) {
+    return 0;
+  }
+
+  if (info->baseVersion_ == since) {
+    return info->changed_;
+  }
+
+  return FORECAST_CHANGED_ALL;
+}
+
+/**
+ * Starts collecting the strings of a forecast.
  *
- * @note Destination is first freed, if non-NULL, otherwise a new allocation
- *       is made. Both source and destination forecast ptrs must be released by
- *       the caller.
+ * @param strings Pointer to the builder to initialize.
  */
 void
-forecast_copy(gpointer * dst, gpointer src)
+forecast_strings_begin(ForecastStrings * strings)
 {
-  if (!src || !dst) {
+  if (!strings) {
     return;
   }
 
-  forecast_free(*dst);
+  memset(strings, 0, sizeof(ForecastStrings));
+
+  strings->block_ = g_string_sized_new(512);
+}
+
+/**
+ * Adds a string to the builder. The field is pointed at the copy once the
+ * builder is committed.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param value   The string to copy, may be NULL, may contain NUL bytes.
+ * @param len     Length of the string.
+ *
+ * @return 0 on success, -1 if the builder is full.
+ */
+gint
+forecast_strings_add(ForecastStrings * strings,
+                     const gchar    ** field,
+                     const gchar     * value,
+                     gsize             len)
+{
+  if (!strings || !strings->block_ || !field) {
+    return -1;
+  }
+
+  if (!value) {
+    /* left NULL by the commit */
+    return 0;
+  }
+
+  if (strings->count_ >= FORECAST_STRINGS_MAX) {
+    LXW_LOG(LXW_ERROR, "forecast::strings_add(): too many strings");
 
-  *dst = g_try_new0(ForecastInfo, 1);
+    return -1;
+  }
+
+  strings->fields_[strings->count_]  = field;
+  strings->offsets_[strings->count_] = strings->block_->len;
+  strings->lengths_[strings->count_] = len;
+  strings->count_++;
+
+  g_string_append_len(strings->block_, value, len);
+  g_string_append_c(strings->block_, '\0');
+
+  return 0;
+}
+
+/**
+ * Adds a string from the small vocabulary shared by all forecasts, such as
+ * units and conditions. The field is pointed at the interned copy once the
+ * builder is committed, or at a private copy if the string could not be
+ * interned.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param value   The string to intern, may be NULL.
+ * @param len     Length of the string.
+ *
+ * @return 0 on success, -1 if the builder is full.
+ */
+gint
+forecast_strings_intern(ForecastStrings * strings,
+                        const gchar    ** field,
+                        const gchar     * value,
+                        gsize             len)
+{
+  const gchar * interned = intern_string(value, len);
+
+  if (!interned) {
+    return forecast_strings_add(strings, field, value, len);
+  }
+
+  if (!strings || !strings->block_ || !field) {
+    return -1;
+  }
+
+  if (strings->count_ >= FORECAST_STRINGS_MAX) {
+    LXW_LOG(LXW_ERROR, "forecast::strings_intern(): too many strings");
+
+    return -1;
+  }
+
+  strings->fields_[strings->count_]   = field;
+  strings->lengths_[strings->count_]  = len;
+  strings->interned_[strings->count_] = interned;
+  strings->count_++;
+
+  return 0;
+}
+
+/**
+ * Moves the forecast into a single allocation that also holds the collected
+ * strings, and points the recorded fields into it. Strings that were not
+ * added are cleared, and the multi-day records are decoded anew. If the
+ * forecast was derived from another one, the fields that differ from it are
+ * recorded in changed_, and an image whose URL changed is dropped.
+ *
+ * @param strings  Pointer to the builder, which is reset.
+ * @param forecast Pointer to the forecast the fields were recorded in. Its
+ *                 reference is taken over by the returned forecast.
+ *
+ * @return Pointer to the committed forecast, or NULL if there was no memory
+ *         for it, in which case the forecast passed in is left unchanged.
+ */
+gpointer
+forecast_strings_commit(ForecastStrings * strings, gpointer forecast)
+{
+  if (!strings || !strings->block_) {
+    return NULL;
+  }
+
+  if (!forecast) {
+    forecast_strings_discard(strings);
+
+    return NULL;
+  }
+
+  ForecastInfo * previous = (ForecastInfo *)forecast;
+
+  gsize size = strings->block_->len;
+
+  gboolean pooled = (sizeof(ForecastInfo) + size <= FORECAST_BLOCK_SIZE);
+
+  ForecastInfo * info = (pooled) ? slabpool_alloc0(&g_pool)
+                                 : g_try_malloc(sizeof(ForecastInfo) + size);
+
+  if (!info) {
+    LXW_LOG(LXW_ERROR, "forecast::strings_commit(): out of memory");
+
+    forecast_strings_discard(strings);
+
+    return NULL;
+  }
+
+  pthread_mutex_lock(&g_days_mutex);
+
+  *info = *previous;
+
+  pthread_mutex_unlock(&g_days_mutex);
+
+  /* after the struct, whose tail padding may overlap the strings */
+  memcpy(info->strings_, strings->block_->str, size);
+
+  const gchar * base = info->strings_;
+
+  info->pooled_   = pooled;
+  info->refcount_ = 1;
+  info->base_     = NULL;
+
+  if (info->image_) {
+    g_object_ref(info->image_);
+  }
+
+  /* nothing may keep pointing into the previous strings */
+  gint f = 0;
+  for (; f < FORECASTINFO_FIELD_COUNT; ++f) {
+    if (ForecastInfoFields[f].type_ == FIELD_CONST_STRING ||
+        ForecastInfoFields[f].type_ == FIELD_RECORDS) {
+      field_clear(&ForecastInfoFields[f], info);
+    }
+  }
 
-  if (*dst) {
-    ForecastInfo * df = (ForecastInfo *) *dst;
-    ForecastInfo * sf = (ForecastInfo *)  src;
+  guint i = 0;
+  for (; i < strings->count_; ++i) {
+    /* the fields were recorded in the previous forecast, same offsets */
+    gsize offset = (gsize)((const gchar *)strings->fields_[i] - (const gchar *)previous);
 
-    df->units_         = sf->units_;
-    df->pressureState_ = sf->pressureState_;
+    if (offset + sizeof(const gchar *) > sizeof(ForecastInfo)) {
+      LXW_LOG(LXW_ERROR, "forecast::strings_commit(): field outside the forecast");
 
-    int i = 0;
-    for (; i < FORECAST_MAX_DAYS; i++) {
-      forecast_forecastday_copy(&(df->days_[i]), &(sf->days_[i]));
+      continue;
     }
 
-    forecast_units_copy(&(df->units_), &(sf->units_));
+    const gchar ** field = (const gchar **)((gchar *)info + offset);
 
-    df->windChill_   = sf->windChill_;
-    df->windSpeed_   = sf->windSpeed_;
-    df->humidity_    = sf->humidity_;
-    df->pressure_    = sf->pressure_;
-    df->visibility_  = sf->visibility_;
-    df->temperature_ = sf->temperature_;
-    SAFE_STRNDUP(df->windDirection_, sf->windDirection_);
-    SAFE_STRNDUP(df->sunrise_,       sf->sunrise_);
-    SAFE_STRNDUP(df->sunset_,        sf->sunset_);
-    SAFE_STRNDUP(df->time_,          sf->time_);
-    SAFE_STRNDUP(df->conditions_,    sf->conditions_);
-    SAFE_STRNDUP(df->imageURL_,      sf->imageURL_);
+    *field = (strings->interned_[i]) ? strings->interned_[i]
+                                     : base + strings->offsets_[i];
 
-    df->image_ = sf->image_;
-    g_object_ref(df->image_);
+    /* the day records carry embedded NULs, so their length is kept */
+    if (field == &(info->daysRaw_)) {
+      info->daysRawLen_ = strings->lengths_[i];
+    }
+  }
+
+  info->daysVersion_ = 0;
+
+  memset(info->days_, 0, sizeof(info->days_));
+
+  const ForecastInfo * origin = (const ForecastInfo *)previous->base_;
+
+  info->baseVersion_ = (origin) ? origin->version_ : 0;
+  info->changed_     = (origin) ? forecast_diff(info, origin)
+                                : FORECAST_CHANGED_ALL;
+
+  /* the image stage fetches the one for the new URL */
+  if ((info->changed_ & FORECAST_CHANGED_IMAGE) && info->image_) {
+    g_object_unref(info->image_);
+
+    info->image_ = NULL;
+  }
+
+  g_string_free(strings->block_, TRUE);
+
+  memset(strings, 0, sizeof(ForecastStrings));
+
+  forecast_unref(previous);
+
+  return info;
+}
+
+/**
+ * Throws away the collected strings without touching any forecast.
+ *
+ * @param strings Pointer to the builder, which is reset.
+ */
+void
+forecast_strings_discard(ForecastStrings * strings)
+{
+  if (!strings) {
+    return;
+  }
+
+  if (strings->block_) {
+    g_string_free(strings->block_, TRUE);
+  }
+
+  memset(strings, 0, sizeof(ForecastStrings));
+}
+
+/**
+ * Returns one day of the multi-day forecast. The compact records are
+ * decoded on first access. The days of a snapshot are only ever decoded
+ * once, tagged with its version, which does not change once the snapshot
+ * is shared, so the day stays as it is for as long as the forecast lives.
+ *
+ * @param forecast Pointer to the forecast, which the caller holds a
+ *                 reference to for as long as it uses the day.
+ * @param day      Index of the day, FORECAST_DAY_1 through FORECAST_DAY_5.
+ *
+ * @return Pointer to the day, owned by the forecast, or NULL if the index is
+ *         out of range or the forecast was never stamped.
+ */
+const ForecastDay *
+forecast_day_get(gpointer forecast, gint day)
+{
+  if (!forecast || day < FORECAST_DAY_1 || day >= FORECAST_MAX_DAYS) {
+    return NULL;
+  }
+
+  ForecastInfo * info = (ForecastInfo *)forecast;
+
+  /* an unstamped forecast has no version to tag the days with */
+  g_return_val_if_fail(info->version_ != 0, NULL);
+
+  pthread_mutex_lock(&g_days_mutex);
+
+  if (info->daysVersion_ != info->version_) {
+    forecast_days_decode(info);
   }
+
+  pthread_mutex_unlock(&g_days_mutex);
+
+  return &(info->days_[day]);
 }
 
 /**
@@ -205,45 +602,44 @@ forecast_print(gpointer forecast G_GNUC_UNUSED)
   
   ForecastInfo * info = (ForecastInfo *)forecast;
   
-  LXW_LOG(LXW_VERBOSE, "Forecast at %s:",     (const char *)info->time_);
-  LXW_LOG(LXW_VERBOSE, "\tTemperature: %d%s",
-          info->temperature_,
-          (const char *)info->units_.temperature_);
-
-  LXW_LOG(LXW_VERBOSE, "\tHumidity: %d%", info->humidity_);
-  LXW_LOG(LXW_VERBOSE, "\tWind chill: %d%s, speed: %d%s, direction %s", 
-          info->windChill_,
-          (const char *)info->units_.temperature_,
-          info->windSpeed_,
-          (const char *)info->units_.speed_,
-          info->windDirection_);
-  LXW_LOG(LXW_VERBOSE, "\tPressure: %2.02f%s and %s", 
-          info->pressure_,
-          (const char *)info->units_.pressure_,
-          ((info->pressureState_ == STEADY)?"steady":
-           (info->pressureState_ == RISING)?"rising":
-           (info->pressureState_ == FALLING)?"falling":"?"));
-  LXW_LOG(LXW_VERBOSE, "\tConditions: %s", (const char *)info->conditions_);
-  LXW_LOG(LXW_VERBOSE, "\tVisibility: %3.02f%s", 
-          info->visibility_,
-          (const char *)info->units_.distance_);
-  LXW_LOG(LXW_VERBOSE, "\tSunrise: %s", (const char *)info->sunrise_);
-  LXW_LOG(LXW_VERBOSE, "\tSunset: %s", (const char *)info->sunset_);
-  LXW_LOG(LXW_VERBOSE, "\tImage URL: %s", info->imageURL_);
+  LXW_LOG(LXW_VERBOSE, "Forecast, version %u:", info->version_);
+
+  gint f = 0;
+  for (; f < FORECASTINFO_FIELD_COUNT; ++f) {
+    /* the days are printed decoded below */
+    if (ForecastInfoFields[f].type_ == FIELD_RECORDS) {
+      continue;
+    }
+
+    gchar * value = field_format(&ForecastInfoFields[f], info);
+
+    LXW_LOG(LXW_VERBOSE, "\t%s: %s", ForecastInfoFields[f].name_, value);
+
+    g_free(value);
+  }
 
   LXW_LOG(LXW_VERBOSE, "\t%d-day forecast:", FORECAST_MAX_DAYS);
 
   int i = 0;
   for (; i <
          FORECAST_MAX_DAYS; i++) {
+    /* a forecast the parser has not stamped yet has no days to decode */
+    const ForecastDay * day = (info->version_) ? forecast_day_get(info, i) : NULL;
+
+    if (!day) {
+      LXW_LOG(LXW_VERBOSE, "\t\tN/A");
+
+      continue;
+    }
+
     LXW_LOG(LXW_VERBOSE, "\t\t%s: High: %d%s, Low: %d%s, Conditions[%d]: %s",
-          (const char *)info->days_[i].day_,
-                        info->days_[i].high_,
+          (day->day_) ? (const char *)day->day_ : "N/A",
+                        day->high_,
           (const char *)info->units_.temperature_,
-                        info->days_[i].low_,
+                        day->low_,
           (const char *)info->units_.temperature_,
-                        info->days_[i].code_,
-          (const char *)info->days_[i].conditions_);
+                        day->code_,
+          (day->conditions_) ? (const char *)day->conditions_ : "N/A");
   }
 
 #endif
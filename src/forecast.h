@@ -23,7 +23,8 @@
 #ifndef LXWEATHER_FORECAST_HEADER
 #define LXWEATHER_FORECAST_HEADER
 
-#include <glib.h>
+#include "field.h" // includes glib.h
+
 #include <gtk/gtk.h>
 
 #define WIND_DIRECTION(x) ( \
@@ -61,65 +62,316 @@ typedef enum
   FALLING   = 2
 } PressureState;
 
+/* Fields of a forecast, as bits of the mask of changed fields */
+typedef enum
+{
+  FORECAST_CHANGED_UNITS          = 1 << 0,
+  FORECAST_CHANGED_PRESSURE_STATE = 1 << 1,
+  FORECAST_CHANGED_DAYS           = 1 << 2,
+  FORECAST_CHANGED_WIND_CHILL     = 1 << 3,
+  FORECAST_CHANGED_WIND_DIRECTION = 1 << 4,
+  FORECAST_CHANGED_WIND_SPEED     = 1 << 5,
+  FORECAST_CHANGED_HUMIDITY       = 1 << 6,
+  FORECAST_CHANGED_PRESSURE       = 1 << 7,
+  FORECAST_CHANGED_VISIBILITY     = 1 << 8,
+  FORECAST_CHANGED_SUNRISE        = 1 << 9,
+  FORECAST_CHANGED_SUNSET         = 1 << 10,
+  FORECAST_CHANGED_TIME           = 1 << 11,
+  FORECAST_CHANGED_TEMPERATURE    = 1 << 12,
+  FORECAST_CHANGED_CONDITIONS     = 1 << 13,
+  FORECAST_CHANGED_IMAGE          = 1 << 14, // imageURL_ or image_
+  FORECAST_CHANGED_ALL            = (1 << 15) - 1
+} ForecastChange;
+
+/* The strings point into the forecast's compact day records */
 typedef struct
 {
-  gchar * day_;
-  gint    high_;
-  gint    low_;
-  gint    code_;
-  gchar * conditions_;
+  const gchar * day_;
+  gint          high_;
+  gint          low_;
+  gint          code_;
+  const gchar * conditions_;
 } ForecastDay;
 
+/* All strings below point into the forecast's trailing strings_ */
 typedef struct
 {
-  gchar * distance_;
-  gchar * pressure_;
-  gchar * speed_;
-  gchar * temperature_;
+  const gchar * distance_;
+  const gchar * pressure_;
+  const gchar * speed_;
+  const gchar * temperature_;
 } ForecastUnits;
 
+/*
+ * A forecast is filled in by a single parser and is never modified once it
+ * has been handed to anybody else: holders share it through forecast_ref()
+ * and forecast_unref(). Only the lazily decoded days_ change afterwards.
+ *
+ * The struct and all of its strings are one allocation, the strings being
+ * stored back to back in strings_ once the parser commits them. Forecasts
+ * up to FORECAST_BLOCK_SIZE bytes in all come from a slab pool.
+ *
+ * A parser updates a private copy of the previous forecast, taken with
+ * forecast_derive(), and the commit records in changed_ which fields differ
+ * from that forecast, whose version is kept in baseVersion_.
+ */
 typedef struct 
 {
   ForecastUnits units_;
   PressureState pressureState_;
   ForecastDay   days_[FORECAST_MAX_DAYS];
   gint     windChill_;
-  gchar *  windDirection_;
+  const gchar * windDirection_;
   gint     windSpeed_;
   gint     humidity_;
   gdouble  pressure_;
   gdouble  visibility_;
-  gchar *  sunrise_;
-  gchar *  sunset_;
-  gchar *  time_;
+  const gchar * sunrise_;
+  const gchar * sunset_;
+  const gchar * time_;
   gint     temperature_;
-  gchar *  conditions_;
-  gchar *  imageURL_;
+  gint     code_;        // condition code of the current conditions
+  const gchar * conditions_;
+  const gchar * imageURL_;
   GdkPixbuf * image_;
+  guint    version_;
+  const gchar * daysRaw_;
+  gsize    daysRawLen_;  // right after daysRaw_, see FIELD_RECORDS
+  guint    daysVersion_;
+  guint    baseVersion_; // version of the forecast parsed over, 0 if none
+  guint    changed_;     // ForecastChange bits relative to that forecast
+  gpointer base_;        // forecast parsed over, only set before the commit
+  gboolean pooled_;      // allocated from the forecast pool
+  volatile gint refcount_;
+  gchar    strings_[];
 } ForecastInfo;
 
+/*
+ * The fields of a forecast filled in by the parsers, as
+ * X(id, name, type, member, change bit).
+ */
+#define FORECASTINFO_FIELDS(X)                                                                      \
+  X(FORECAST_FIELD_DISTANCE_UNITS,    "distance units",    FIELD_CONST_STRING, units_.distance_,    \
+    FORECAST_CHANGED_UNITS)                                                                         \
+  X(FORECAST_FIELD_PRESSURE_UNITS,    "pressure units",    FIELD_CONST_STRING, units_.pressure_,    \
+    FORECAST_CHANGED_UNITS)                                                                         \
+  X(FORECAST_FIELD_SPEED_UNITS,       "speed units",       FIELD_CONST_STRING, units_.speed_,       \
+    FORECAST_CHANGED_UNITS)                                                                         \
+  X(FORECAST_FIELD_TEMPERATURE_UNITS, "temperature units", FIELD_CONST_STRING, units_.temperature_, \
+    FORECAST_CHANGED_UNITS)                                                                         \
+  X(FORECAST_FIELD_PRESSURE_STATE,    "pressure state",    FIELD_INT,          pressureState_,      \
+    FORECAST_CHANGED_PRESSURE_STATE)                                                                \
+  X(FORECAST_FIELD_DAYS,              "days",              FIELD_RECORDS,      daysRaw_,            \
+    FORECAST_CHANGED_DAYS)                                                                          \
+  X(FORECAST_FIELD_WIND_CHILL,        "wind chill",        FIELD_INT,          windChill_,          \
+    FORECAST_CHANGED_WIND_CHILL)                                                                    \
+  X(FORECAST_FIELD_WIND_DIRECTION,    "wind direction",    FIELD_CONST_STRING, windDirection_,      \
+    FORECAST_CHANGED_WIND_DIRECTION)                                                                \
+  X(FORECAST_FIELD_WIND_SPEED,        "wind speed",        FIELD_INT,          windSpeed_,          \
+    FORECAST_CHANGED_WIND_SPEED)                                                                    \
+  X(FORECAST_FIELD_HUMIDITY,          "humidity",          FIELD_INT,          humidity_,           \
+    FORECAST_CHANGED_HUMIDITY)                                                                      \
+  X(FORECAST_FIELD_PRESSURE,          "pressure",          FIELD_DOUBLE,       pressure_,           \
+    FORECAST_CHANGED_PRESSURE)                                                                      \
+  X(FORECAST_FIELD_VISIBILITY,        "visibility",        FIELD_DOUBLE,       visibility_,         \
+    FORECAST_CHANGED_VISIBILITY)                                                                    \
+  X(FORECAST_FIELD_SUNRISE,           "sunrise",           FIELD_CONST_STRING, sunrise_,            \
+    FORECAST_CHANGED_SUNRISE)                                                                       \
+  X(FORECAST_FIELD_SUNSET,            "sunset",            FIELD_CONST_STRING, sunset_,             \
+    FORECAST_CHANGED_SUNSET)                                                                        \
+  X(FORECAST_FIELD_TIME,              "time",              FIELD_CONST_STRING, time_,               \
+    FORECAST_CHANGED_TIME)                                                                          \
+  X(FORECAST_FIELD_TEMPERATURE,       "temperature",       FIELD_INT,          temperature_,        \
+    FORECAST_CHANGED_TEMPERATURE)                                                                   \
+  X(FORECAST_FIELD_CODE,              "code",              FIELD_INT,          code_,               \
+    FORECAST_CHANGED_CONDITIONS)                                                                    \
+  X(FORECAST_FIELD_CONDITIONS,        "conditions",        FIELD_CONST_STRING, conditions_,         \
+    FORECAST_CHANGED_CONDITIONS)                                                                    \
+  X(FORECAST_FIELD_IMAGE_URL,         "image URL",         FIELD_CONST_STRING, imageURL_,           \
+    FORECAST_CHANGED_IMAGE)
+
+#define FORECASTINFO_FIELD_ID(id, name, type, member, change) id,
+
+typedef enum
+{
+  FORECASTINFO_FIELDS(FORECASTINFO_FIELD_ID)
+  FORECASTINFO_FIELD_COUNT
+} ForecastInfoField;
+
+#undef FORECASTINFO_FIELD_ID
+
+/* Defined in the .c file - describes each field, in ForecastInfoField order,
+ * with its ForecastChange bit as the flag */
+extern const FieldDescriptor ForecastInfoFields[];
+
+/* Size of the pooled forecast blocks, enough for the struct and the
+ * strings of a typical response */
+#define FORECAST_BLOCK_SIZE  1024
+
+/* Upper bound on the number of strings set through a builder */
+#define FORECAST_STRINGS_MAX 16
+
+/* Collects the strings of one parse into a single block */
+typedef struct
+{
+  GString       * block_;
+  const gchar  ** fields_[FORECAST_STRINGS_MAX];
+  gsize           offsets_[FORECAST_STRINGS_MAX];
+  gsize           lengths_[FORECAST_STRINGS_MAX];
+  const gchar   * interned_[FORECAST_STRINGS_MAX];  // NULL if in the block
+  guint           count_;
+} ForecastStrings;
+
 /**
- * Provides the mechanism to free any data associated with 
- * the ForecastInfo structure
+ * Allocates an empty forecast holding a single reference.
  *
- * @param forecast Entry to free.
+ * @return Pointer to the new forecast, or NULL if the allocation failed.
+ */
+gpointer
+forecast_new(void);
+
+/**
+ * Allocates a private copy of a forecast for the parser to update in place.
+ * The copy keeps the forecast alive until it is committed, which records
+ * the fields that differ from it. Its numbers start out cleared, as its
+ * strings end up at the commit, so that whatever the response leaves out
+ * does not carry over from the previous forecast.
+ *
+ * @param base Pointer to the forecast to start from, may be NULL, in which
+ *             case the copy is empty.
  *
+ * @return Pointer to the new forecast, or NULL if the allocation failed.
+ */
+gpointer
+forecast_derive(gpointer base);
+
+/**
+ * Takes a reference to a forecast.
+ *
+ * @param forecast Pointer to the forecast, may be NULL.
+ *
+ * @return The forecast passed in.
+ */
+gpointer
+forecast_ref(gpointer forecast);
+
+/**
+ * Releases a reference to a forecast, freeing any data associated with it
+ * once the last one is gone.
+ *
+ * @param forecast Pointer to the forecast, may be NULL.
  */
 void
-forecast_free(gpointer forecast);
+forecast_unref(gpointer forecast);
 
 /**
- * Copies a forecast entry.
+ * Stamps the forecast with a new, process-wide unique version. Done once
+ * every time the forecast is filled in by the parser.
  *
- * @param dst Address of the pointer to the forecast to set.
- * @param src Pointer to the forecast to use/copy.
+ * @param forecast Pointer to the forecast to stamp.
+ */
+void
+forecast_version_stamp(gpointer forecast);
+
+/**
+ * Returns the fields that changed since a given version of the forecast was
+ * seen. The answer is exact when that version is the one the forecast was
+ * parsed over, and FORECAST_CHANGED_ALL when it is unknown.
  *
- * @note Destination is first freed, if non-NULL, otherwise a new allocation
- *       is made. Both source and destination forecast ptrs must be released by
- *       the caller.
+ * @param forecast Pointer to the forecast, may be NULL.
+ * @param since    Version of the forecast last seen, 0 if none.
+ *
+ * @return Mask of ForecastChange bits.
+ */
+guint
+forecast_changes(gconstpointer forecast, guint since);
+
+/**
+ * Starts collecting the strings of a forecast.
+ *
+ * @param strings Pointer to the builder to initialize.
  */
 void
-forecast_copy(gpointer * dst, gpointer src);
+forecast_strings_begin(ForecastStrings * strings);
+
+/**
+ * Adds a string to the builder. The field is pointed at the copy once the
+ * builder is committed.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param value   The string to copy, may be NULL, may contain NUL bytes.
+ * @param len     Length of the string.
+ *
+ * @return 0 on success, -1 if the builder is full.
+ */
+gint
+forecast_strings_add(ForecastStrings * strings,
+                     const gchar    ** field,
+                     const gchar     * value,
+                     gsize             len);
+
+/**
+ * Adds a string from the small vocabulary shared by all forecasts, such as
+ * units and conditions. The field is pointed at the interned copy once the
+ * builder is committed, or at a private copy if the string could not be
+ * interned.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param value   The string to intern, may be NULL.
+ * @param len     Length of the string.
+ *
+ * @return 0 on success, -1 if the builder is full.
+ */
+gint
+forecast_strings_intern(ForecastStrings * strings,
+                        const gchar    ** field,
+                        const gchar     * value,
+                        gsize             len);
+
+/**
+ * Moves the forecast into a single allocation that also holds the collected
+ * strings, and points the recorded fields into it. Strings that were not
+ * added are cleared, and the multi-day records are decoded anew. If the
+ * forecast was derived from another one, the fields that differ from it are
+ * recorded in changed_, and an image whose URL changed is dropped.
+ *
+ * @param strings  Pointer to the builder, which is reset.
+ * @param forecast Pointer to the forecast the fields were recorded in. Its
+ *                 reference is taken over by the returned forecast.
+ *
+ * @return Pointer to the committed forecast, or NULL if there was no memory
+ *         for it, in which case the forecast passed in is left unchanged.
+ */
+gpointer
+forecast_strings_commit(ForecastStrings * strings, gpointer forecast);
+
+/**
+ * Throws away the collected strings without touching any forecast.
+ *
+ * @param strings Pointer to the builder, which is reset.
+ */
+void
+forecast_strings_discard(ForecastStrings * strings);
+
+/**
+ * Returns one day of the multi-day forecast. The compact records are
+ * decoded on first access. The days of a snapshot are only ever decoded
+ * once, tagged with its version, which does not change once the snapshot
+ * is shared, so the day stays as it is for as long as the forecast lives.
+ * The day names and conditions of the result are interned, or NULL if the
+ * response left them empty.
+ *
+ * @param forecast Pointer to the forecast, which the caller holds a
+ *                 reference to for as long as it uses the day.
+ * @param day      Index of the day, FORECAST_DAY_1 through FORECAST_DAY_5.
+ *
+ * @return Pointer to the day, owned by the forecast, or NULL if the index is
+ *         out of range or the forecast was never stamped.
+ */
+const ForecastDay *
+forecast_day_get(gpointer forecast, gint day);
 
 /**
  * Prints the contents of the supplied entry to stdout
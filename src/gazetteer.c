@@ -0,0 +1,307 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the offline place database (gazetteer) */
+
+#include "gazetteer.h"
+#include "location.h"
+#include "logutil.h"
+#include "textutil.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+
+/* The mapped file; read-only once open, so lookups need no locking */
+static struct
+{
+  gpointer               data;
+  gsize                  size;
+  const GazetteerEntry * entries;
+  guint32                count;
+  const gchar          * strings;
+  guint32                stringsSize;
+} g_gazetteer = { NULL, 0, NULL, 0, NULL, 0 };
+
+/**
+ * Resolves an offset into the string table.
+ *
+ * @param offset The offset.
+ *
+ * @return The string, or NULL if the offset is out of range.
+ */
+static const gchar *
+string_get(guint32 offset)
+{
+  return (offset < g_gazetteer.stringsSize) ? g_gazetteer.strings + offset : NULL;
+}
+
+/**
+ * Maps the gazetteer file into memory. Only one gazetteer is open at a
+ * time, opening another one closes the previous.
+ *
+ * @param path Path to the gazetteer file.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+gint
+gazetteer_open(const gchar * path)
+{
+  gazetteer_close();
+
+  if (!path) {
+    return -1;
+  }
+
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    LXW_LOG(LXW_DEBUG, "gazetteer::open(%s): %s", path, strerror(errno));
+
+    return -1;
+  }
+
+  struct stat st;
+
+  if (fstat(fd, &st) || (gsize)st.st_size < sizeof(GazetteerHeader)) {
+    LXW_LOG(LXW_ERROR, "gazetteer::open(%s): not a gazetteer", path);
+
+    close(fd);
+
+    return -1;
+  }
+
+  gpointer data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  /* the mapping stays valid after the descriptor is closed */
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    LXW_LOG(LXW_ERROR, "gazetteer::open(%s): %s", path, strerror(errno));
+
+    return -1;
+  }
+
+  const GazetteerHeader * header = (const GazetteerHeader *)data;
+
+  gsize size = st.st_size;
+
+  gsize entriessize = (gsize)header->count_ * sizeof(GazetteerEntry);
+
+  /* everything must fit, and the string table must end with a NUL */
+  if (memcmp(header->magic_, GAZETTEER_MAGIC, sizeof(GAZETTEER_MAGIC)) ||
+      header->version_ != GAZETTEER_VERSION ||
+      header->stringsSize_ == 0 ||
+      sizeof(GazetteerHeader) + entriessize > header->stringsOffset_ ||
+      (gsize)header->stringsOffset_ + header->stringsSize_ > size ||
+      ((const gchar *)data)[header->stringsOffset_ + header->stringsSize_ - 1]) {
+    LXW_LOG(LXW_ERROR, "gazetteer::open(%s): invalid or corrupt file", path);
+
+    munmap(data, size);
+
+    return -1;
+  }
+
+  g_gazetteer.data        = data;
+  g_gazetteer.size        = size;
+  g_gazetteer.entries     = (const GazetteerEntry *)((const gchar *)data + sizeof(GazetteerHeader));
+  g_gazetteer.count       = header->count_;
+  g_gazetteer.strings     = (const gchar *)data + header->stringsOffset_;
+  g_gazetteer.stringsSize = header->stringsSize_;
+
+  LXW_LOG(LXW_DEBUG, "gazetteer::open(%s): %u places", path, g_gazetteer.count);
+
+  return 0;
+}
+
+/**
+ * Unmaps the gazetteer file, if any.
+ *
+ */
+void
+gazetteer_close(void)
+{
+  if (g_gazetteer.data) {
+    munmap(g_gazetteer.data, g_gazetteer.size);
+  }
+
+  memset(&g_gazetteer, 0, sizeof(g_gazetteer));
+}
+
+/**
+ * Finds the places whose normalized name starts with the normalized query.
+ * Exact matches sort first.
+ *
+ * @param query The string the user searched for.
+ * @param exact Pointer to set to whether a name matched the query exactly,
+ *              rather than only starting with it, may be NULL.
+ *
+ * @return A list of at most GAZETTEER_MAX_RESULTS LocationInfo entries, or
+ *         NULL if nothing matched or no gazetteer is open. Caller is
+ *         responsible for freeing the list.
+ */
+GList *
+gazetteer_find(const gchar * query, gboolean * exact)
+{
+  if (exact) {
+    *exact = FALSE;
+  }
+
+  if (!g_gazetteer.data || !query) {
+    return NULL;
+  }
+
+  gchar * key = textutil_query_normalize(query);
+
+  gsize keylen = strlen(key);
+
+  if (!keylen) {
+    g_free(key);
+
+    return NULL;
+  }
+
+  /* lower bound: first entry whose key is not less than the query */
+  guint32 low  = 0;
+  guint32 high = g_gazetteer.count;
+
+  while (low < high) {
+    guint32 mid = low + (high - low) / 2;
+
+    const gchar * midkey = string_get(g_gazetteer.entries[mid].key_);
+
+    if (midkey && strcmp(midkey, key) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  GList * list = NULL;
+
+  guint found = 0;
+
+  /* keys sharing the prefix follow, with an exact match first */
+  for (; low < g_gazetteer.count && found < GAZETTEER_MAX_RESULTS; ++low) {
+    const GazetteerEntry * entry = &(g_gazetteer.entries[low]);
+
+    const gchar * entrykey = string_get(entry->key_);
+
+    if (!entrykey || strncmp(entrykey, key, keylen)) {
+      break;
+    }
+
+    if (exact && !entrykey[keylen]) {
+      *exact = TRUE;
+    }
+
+    LocationInfo * location = gazetteer_location_get(low);
+
+    if (!location) {
+      continue;
+    }
+
+    list = g_list_prepend(list, location);
+
+    ++found;
+  }
+
+  LXW_LOG(LXW_DEBUG, "gazetteer::find(%s): %u places", query, found);
+
+  g_free(key);
+
+  return g_list_reverse(list);
+}
+
+/**
+ * Returns the number of places in the open gazetteer.
+ *
+ * @return The number of places, 0 if no gazetteer is open.
+ */
+guint
+gazetteer_size(void)
+{
+  return g_gazetteer.count;
+}
+
+/**
+ * Returns the normalized name of a place.
+ *
+ * @param index Index of the place, below gazetteer_size().
+ *
+ * @return The name, owned by the gazetteer, or NULL if out of range.
+ */
+const gchar *
+gazetteer_key_get(guint index)
+{
+  if (index >= g_gazetteer.count) {
+    return NULL;
+  }
+
+  return string_get(g_gazetteer.entries[index].key_);
+}
+
+/**
+ * Returns the details of a place.
+ *
+ * @param index Index of the place, below gazetteer_size().
+ *
+ * @return A new LocationInfo entry, or NULL if out of range. Caller is
+ *         responsible for freeing it.
+ */
+gpointer
+gazetteer_location_get(guint index)
+{
+  if (index >= g_gazetteer.count) {
+    return NULL;
+  }
+
+  const GazetteerEntry * entry = &(g_gazetteer.entries[index]);
+
+  const gchar * fields[] = { "alias", "woeid", "city", "state", "country" };
+  const gchar * values[] = { string_get(entry->name_),
+                             string_get(entry->woeid_),
+                             string_get(entry->city_),
+                             string_get(entry->state_),
+                             string_get(entry->country_) };
+
+  if (!values[0] || !values[1] || !*values[1]) {
+    return NULL;
+  }
+
+  LocationInfo * location = (LocationInfo *)location_new();
+
+  if (location) {
+    gsize f = 0;
+    for (; f < G_N_ELEMENTS(fields); ++f) {
+      if (values[f] && *values[f]) {
+        location_property_set(location, fields[f], values[f], strlen(values[f]));
+      }
+    }
+  }
+
+  return location;
+}
@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the offline place database (gazetteer) */
+
+#ifndef LXWEATHER_GAZETTEER_HEADER
+#define LXWEATHER_GAZETTEER_HEADER
+
+#include <glib.h>
+
+/*
+ * File layout, in host byte order:
+ *
+ *   GazetteerHeader
+ *   GazetteerEntry[count_], sorted by key
+ *   string table of stringsSize_ bytes, NUL-terminated strings
+ *
+ * All GazetteerEntry fields are offsets into the string table. The key is
+ * the name normalized with textutil_query_normalize().
+ */
+#define GAZETTEER_MAGIC       "LXWGAZ1"
+#define GAZETTEER_VERSION     1
+
+/* Maximum number of places returned by one lookup */
+#define GAZETTEER_MAX_RESULTS 10
+
+typedef struct
+{
+  gchar   magic_[8];
+  guint32 version_;
+  guint32 count_;
+  guint32 stringsOffset_;
+  guint32 stringsSize_;
+} GazetteerHeader;
+
+typedef struct
+{
+  guint32 key_;
+  guint32 name_;
+  guint32 woeid_;
+  guint32 city_;
+  guint32 state_;
+  guint32 country_;
+} GazetteerEntry;
+
+/**
+ * Maps the gazetteer file into memory. Only one gazetteer is open at a
+ * time, opening another one closes the previous.
+ *
+ * @param path Path to the gazetteer file.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+gint
+gazetteer_open(const gchar * path);
+
+/**
+ * Unmaps the gazetteer file, if any.
+ *
+ */
+void
+gazetteer_close(void);
+
+/**
+ * Finds the places whose normalized name starts with the normalized query.
+ * Exact matches sort first.
+ *
+ * @param query The string the user searched for.
+ * @param exact Pointer to set to whether a name matched the query exactly,
+ *              rather than only starting with it, may be NULL.
+ *
+ * @return A list of at most GAZETTEER_MAX_RESULTS LocationInfo entries, or
+ *         NULL if nothing matched or no gazetteer is open. Caller is
+ *         responsible for freeing the list.
+ */
+GList *
+gazetteer_find(const gchar * query, gboolean * exact);
+
+/**
+ * Returns the number of places in the open gazetteer.
+ *
+ * @return The number of places, 0 if no gazetteer is open.
+ */
+guint
+gazetteer_size(void);
+
+/**
+ * Returns the normalized name of a place.
+ *
+ * @param index Index of the place, below gazetteer_size().
+ *
+ * @return The name, owned by the gazetteer, or NULL if out of range.
+ */
+const gchar *
+gazetteer_key_get(guint index);
+
+/**
+ * Returns the details of a place.
+ *
+ * @param index Index of the place, below gazetteer_size().
+ *
+ * @return A new LocationInfo entry, or NULL if out of range. Caller is
+ *         responsible for freeing it.
+ */
+gpointer
+gazetteer_location_get(guint index);
+
+#endif
@@ -0,0 +1,351 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Builds the offline place database (gazetteer) from a CSV dump */
+
+#include "gazetteer.h"
+#include "textutil.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+/* Columns of the CSV dump, in order */
+enum
+{
+  COLUMN_NAME = 0,
+  COLUMN_WOEID,
+  COLUMN_CITY,
+  COLUMN_STATE,
+  COLUMN_COUNTRY,
+  COLUMN_COUNT
+};
+
+typedef struct
+{
+  gchar * key_;
+  gchar * columns_[COLUMN_COUNT];
+} PlaceRecord;
+
+/* The string table being built, with duplicates folded */
+typedef struct
+{
+  GString    * data_;
+  GHashTable * offsets_;
+} StringTable;
+
+/**
+ * Prints out the usage help text.
+ *
+ * @param progname Pointer to the character constant with the name
+ *                 of the executable being ran.
+ */
+static void
+usage(const char * progname)
+{
+  fprintf(stderr, "Usage: %s INPUT.csv OUTPUT\n", progname);
+  fprintf(stderr, "Where INPUT.csv has one place per line with the columns:\n");
+  fprintf(stderr, "  name,woeid,city,state,country\n");
+  fprintf(stderr, "Fields may be quoted with '\"'. A header line starting with\n");
+  fprintf(stderr, "'name' is skipped.\n");
+}
+
+/**
+ * Splits one CSV line into fields. Quoted fields may contain commas, and
+ * doubled quotes inside them stand for one quote.
+ *
+ * @param line The line, without the trailing newline.
+ *
+ * @return NULL-terminated array of fields which must be freed by the caller.
+ */
+static gchar **
+csv_split(const gchar * line)
+{
+  GPtrArray * fields = g_ptr_array_new();
+  GString   * field  = g_string_new(NULL);
+
+  gboolean quoted = FALSE;
+
+  const gchar * curr = line;
+
+  for (;; ++curr) {
+    if (quoted) {
+      if (*curr == '"' && curr[1] == '"') {
+        g_string_append_c(field, '"');
+        ++curr;
+      } else if (*curr == '"') {
+        quoted = FALSE;
+      } else if (*curr) {
+        g_string_append_c(field, *curr);
+      } else {
+        /* unterminated quote, take what there is */
+        quoted = FALSE;
+        --curr;
+      }
+    } else if (*curr == '"') {
+      quoted = TRUE;
+    } else if (*curr == ',' || !*curr) {
+      g_ptr_array_add(fields, g_strstrip(g_string_free(field, FALSE)));
+
+      if (!*curr) {
+        break;
+      }
+
+      field = g_string_new(NULL);
+    } else {
+      g_string_append_c(field, *curr);
+    }
+  }
+
+  g_ptr_array_add(fields, NULL);
+
+  return (gchar **)g_ptr_array_free(fields, FALSE);
+}
+
+/**
+ * Orders records by key, then by name.
+ *
+ * @param a Pointer to the first record pointer.
+ * @param b Pointer to the second record pointer.
+ *
+ * @return Negative, zero or positive, as strcmp().
+ */
+static gint
+record_compare(gconstpointer a, gconstpointer b)
+{
+  const PlaceRecord * ra = *(const PlaceRecord * const *)a;
+  const PlaceRecord * rb = *(const PlaceRecord * const *)b;
+
+  gint rc = strcmp(ra->key_, rb->key_);
+
+  return (rc) ? rc : strcmp(ra->columns_[COLUMN_NAME], rb->columns_[COLUMN_NAME]);
+}
+
+/**
+ * Frees a record.
+ *
+ * @param data Pointer to the record.
+ */
+static void
+record_free(gpointer data)
+{
+  PlaceRecord * record = (PlaceRecord *)data;
+
+  g_free(record->key_);
+
+  gint c = 0;
+  for (; c < COLUMN_COUNT; ++c) {
+    g_free(record->columns_[c]);
+  }
+
+  g_free(record);
+}
+
+/**
+ * Adds a string to the table, reusing an earlier copy if there is one.
+ *
+ * @param table Pointer to the string table.
+ * @param str   The string to add.
+ *
+ * @return The offset of the string in the table.
+ */
+static guint32
+string_table_add(StringTable * table, const gchar * str)
+{
+  gpointer offset = NULL;
+
+  if (g_hash_table_lookup_extended(table->offsets_, str, NULL, &offset)) {
+    return GPOINTER_TO_UINT(offset);
+  }
+
+  guint32 added = (guint32)table->data_->len;
+
+  g_string_append_len(table->data_, str, strlen(str) + 1);
+
+  g_hash_table_insert(table->offsets_, g_strdup(str), GUINT_TO_POINTER(added));
+
+  return added;
+}
+
+/**
+ * Reads all places from the CSV file.
+ *
+ * @param path Path to the CSV file.
+ *
+ * @return Array of PlaceRecord pointers, or NULL on error.
+ */
+static GPtrArray *
+records_read(const gchar * path)
+{
+  FILE * input = fopen(path, "r");
+
+  if (!input) {
+    perror(path);
+
+    return NULL;
+  }
+
+  GPtrArray * records = g_ptr_array_new_with_free_func(record_free);
+
+  gchar line[4096];
+
+  guint lineno = 0;
+
+  while (fgets(line, sizeof(line), input)) {
+    ++lineno;
+
+    g_strchomp(line);
+
+    gchar ** fields = csv_split(line);
+
+    guint count = g_strv_length(fields);
+
+    if (count < COLUMN_COUNT || !*fields[COLUMN_NAME] || !*fields[COLUMN_WOEID]) {
+      if (*line) {
+        fprintf(stderr, "%s:%u: skipped, expected %d fields\n",
+                path, lineno, COLUMN_COUNT);
+      }
+    } else if (lineno == 1 && !g_ascii_strcasecmp(fields[COLUMN_NAME], "name")) {
+      /* header */
+    } else {
+      PlaceRecord * record = g_new0(PlaceRecord, 1);
+
+      gint c = 0;
+      for (; c < COLUMN_COUNT; ++c) {
+        record->columns_[c] = g_strdup(fields[c]);
+      }
+
+      record->key_ = textutil_query_normalize(record->columns_[COLUMN_NAME]);
+
+      if (*record->key_) {
+        g_ptr_array_add(records, record);
+      } else {
+        record_free(record);
+      }
+    }
+
+    g_strfreev(fields);
+  }
+
+  fclose(input);
+
+  return records;
+}
+
+/**
+ * Writes the sorted places to the gazetteer file.
+ *
+ * @param path    Path to the output file.
+ * @param records Array of sorted PlaceRecord pointers.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static gint
+records_write(const gchar * path, GPtrArray * records)
+{
+  StringTable table;
+
+  table.data_    = g_string_new(NULL);
+  table.offsets_ = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  /* offset 0 is the empty string */
+  string_table_add(&table, "");
+
+  GazetteerEntry * entries = g_new0(GazetteerEntry, records->len);
+
+  guint i = 0;
+  for (; i < records->len; ++i) {
+    PlaceRecord * record = (PlaceRecord *)g_ptr_array_index(records, i);
+
+    entries[i].key_     = string_table_add(&table, record->key_);
+    entries[i].name_    = string_table_add(&table, record->columns_[COLUMN_NAME]);
+    entries[i].woeid_   = string_table_add(&table, record->columns_[COLUMN_WOEID]);
+    entries[i].city_    = string_table_add(&table, record->columns_[COLUMN_CITY]);
+    entries[i].state_   = string_table_add(&table, record->columns_[COLUMN_STATE]);
+    entries[i].country_ = string_table_add(&table, record->columns_[COLUMN_COUNTRY]);
+  }
+
+  GazetteerHeader header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic_, GAZETTEER_MAGIC, sizeof(GAZETTEER_MAGIC));
+
+  header.version_       = GAZETTEER_VERSION;
+  header.count_         = records->len;
+  header.stringsOffset_ = sizeof(GazetteerHeader) + records->len * sizeof(GazetteerEntry);
+  header.stringsSize_   = table.data_->len;
+
+  gint retval = 0;
+
+  FILE * output = fopen(path, "wb");
+
+  if (!output ||
+      fwrite(&header, sizeof(header), 1, output) != 1 ||
+      (records->len &&
+       fwrite(entries, sizeof(GazetteerEntry), records->len, output) != records->len) ||
+      fwrite(table.data_->str, 1, table.data_->len, output) != table.data_->len) {
+    perror(path);
+
+    retval = -1;
+  }
+
+  if (output && fclose(output)) {
+    perror(path);
+
+    retval = -1;
+  }
+
+  g_free(entries);
+  g_string_free(table.data_, TRUE);
+  g_hash_table_destroy(table.offsets_);
+
+  return retval;
+}
+
+/* -- main -- */
+int
+main(int argc, char **argv)
+{
+  if (argc != 3) {
+    usage(argv[0]);
+
+    return 1;
+  }
+
+  GPtrArray * records = records_read(argv[1]);
+
+  if (!records) {
+    return 1;
+  }
+
+  g_ptr_array_sort(records, record_compare);
+
+  gint rc = records_write(argv[2], records);
+
+  if (!rc) {
+    printf("%s: %u places\n", argv[2], records->len);
+  }
+
+  g_ptr_array_free(records, TRUE);
+
+  return (rc) ? 1 : 0;
+}
@@ -21,6 +21,7 @@
 /* Provides http protocol utility functions */
 
 #include "httputil.h"
+#include "arena.h"
 
 #include <string.h>
 
@@ -48,7 +49,12 @@ cleanup(void * ctxt, char * contenttype)
     xmlFree(contenttype);
   }
 
+  /* the proxy settings are global, they never go in an arena */
+  Arena * arena = arena_enter(NULL);
+
   xmlNanoHTTPCleanup();
+
+  arena_leave(arena);
 }
 
 /**
@@ -59,7 +65,8 @@ cleanup(void * ctxt, char * contenttype)
  * @param datalen The resulting data length [out].
  *
  * @return A pointer to a null-terminated buffer containing the textual 
- *         representation of the response. Must be freed by the caller.
+ *         representation of the response, allocated from the calling
+ *         thread's arena if it has one. Must be freed with arena_free().
  */
 gpointer
 httputil_url_get(const gchar * url, gint * rc, gint * datalen)
@@ -74,8 +81,12 @@ httputil_url_get(const gchar * url, gint * rc, gint * datalen)
   gchar readbuf[READ_BUFSZ];
   memset(readbuf, 0, READ_BUFSZ);
 
+  Arena * arena = arena_enter(NULL);
+
   xmlNanoHTTPInit();
 
+  arena_leave(arena);
+
   char * contenttype = NULL;
   void * ctxt        = NULL;
   
@@ -103,12 +114,14 @@ httputil_url_get(const gchar * url, gint * rc, gint * datalen)
     /* Maintain pointer to old location, free on failure */
     inbufref = inbuf;
 
-    inbuf = g_try_realloc(inbuf, currlen + readlen);
+    inbuf = arena_realloc(inbuf, currlen + readlen);
 
     if (!inbuf || *rc != HTTP_STATUS_OK) {
       cleanup(ctxt, contenttype);
 
-      g_free(inbufref);
+      arena_free((inbuf) ? inbuf : inbufref);
+
+      inbuf = NULL;
 
       return inbuf; // it's NULL
     }
@@ -123,7 +136,7 @@ httputil_url_get(const gchar * url, gint * rc, gint * datalen)
   }
 
   if (readlen < 0) {
-    g_free(inbuf);
+    arena_free(inbuf);
 
     inbuf = NULL;
   } else {
@@ -132,10 +145,10 @@ httputil_url_get(const gchar * url, gint * rc, gint * datalen)
 
     /* Need to add '\0' at the end since we're going to treat this buffer
      * as a char buffer */
-    inbuf = g_try_realloc(inbuf, currlen + 1);
+    inbuf = arena_realloc(inbuf, currlen + 1);
 
     if (!inbuf) {
-      g_free(inbufref);
+      arena_free(inbufref);
 
       inbuf = NULL;
     } else {
@@ -35,7 +35,8 @@ static const gint HTTP_STATUS_OK = 200;
  * @param datalen The resulting data length [out].
  *
  * @return A pointer to a null-terminated buffer containing the textual
- *         representation of the response. Must be freed by the caller.
+ *         representation of the response, allocated from the calling
+ *         thread's arena if it has one. Must be freed with arena_free().
  */
 gpointer
 httputil_url_get(const gchar * url, gint * rc, gint * datalen);
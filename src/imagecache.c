@@ -0,0 +1,379 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides an asynchronous, URL-keyed cache of condition images */
+
+#include "imagecache.h"
+#include "arena.h"
+#include "httputil.h"
+#include "logutil.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include <pthread.h>
+
+typedef struct
+{
+  ImageCacheCallback callback;
+  gpointer           data;
+} ImageWaiter;
+
+typedef struct
+{
+  gchar       * url;
+  GdkPixbuf   * image;
+  ImageWaiter   waiter;
+} ImageDelivery;
+
+/* Both tables are keyed by URL and protected by the mutex:
+ * images maps to GdkPixbuf, pending maps to a GList of ImageWaiter */
+static GHashTable * g_images  = NULL;
+static GHashTable * g_pending = NULL;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Releases a list of waiters.
+ *
+ * @param list Pointer to the list to free.
+ */
+static void
+waiter_list_free(gpointer list)
+{
+  g_list_free_full((GList *)list, g_free);
+}
+
+/**
+ * Invokes the waiter's callback on the main loop.
+ *
+ * @param data Pointer to the ImageDelivery entry.
+ *
+ * @return FALSE, so that the function is not called again.
+ */
+static gboolean
+image_deliver(gpointer data)
+{
+  ImageDelivery * delivery = (ImageDelivery *)data;
+
+  delivery->waiter.callback(delivery->url, delivery->image, delivery->waiter.data);
+
+  if (delivery->image) {
+    g_object_unref(delivery->image);
+  }
+
+  g_free(delivery->url);
+  g_free(delivery);
+
+  return FALSE;
+}
+
+/**
+ * Retrieves and decodes the image at the specified URL.
+ *
+ * @param url The URL of the image.
+ *
+ * @return The decoded image, or NULL on failure.
+ */
+static GdkPixbuf *
+image_fetch(const gchar * url)
+{
+  gint rc      = 0;
+  gint datalen = 0;
+
+  /* the stream below takes the response over, so it must be on the heap */
+  Arena * arena = arena_enter(NULL);
+
+  gpointer response = httputil_url_get(url, &rc, &datalen);
+
+  arena_leave(arena);
+
+  if (!response || rc != HTTP_STATUS_OK) {
+    LXW_LOG(LXW_ERROR, "imagecache::image_fetch(): Failed to get URL (%d, %d)",
+            rc, datalen);
+
+    g_free(response);
+
+    return NULL;
+  }
+
+  GInputStream * instream = g_memory_input_stream_new_from_data(response,
+                                                                datalen,
+                                                                g_free);
+
+  GError * pError = NULL;
+
+  GdkPixbuf * image = gdk_pixbuf_new_from_stream(instream, NULL, &pError);
+
+  if (!image) {
+    LXW_LOG(LXW_ERROR,
+            "imagecache::image_fetch(): PixBuff allocation failed: %s",
+            pError->message);
+
+    g_error_free(pError);
+
+    pError = NULL;
+  }
+
+  if (!g_input_stream_close(instream, NULL, &pError)) {
+    LXW_LOG(LXW_ERROR,
+            "imagecache::image_fetch(): InputStream closure failed: %s",
+            pError->message);
+
+    g_error_free(pError);
+  }
+
+  g_object_unref(instream);
+
+  return image;
+}
+
+/**
+ * Caches the image, if any, and schedules delivery to everyone waiting
+ * for the specified URL.
+ *
+ * @param url   The URL that was retrieved.
+ * @param image The decoded image, or NULL on failure.
+ */
+static void
+image_publish(const gchar * url, GdkPixbuf * image)
+{
+  gpointer key     = NULL;
+  GList  * waiters = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_images && image) {
+    g_hash_table_replace(g_images, g_strdup(url), g_object_ref(image));
+  }
+
+  if (g_pending &&
+      g_hash_table_lookup_extended(g_pending, url, &key, (gpointer *)&waiters)) {
+    /* the waiters are notified below, outside of the lock */
+    g_hash_table_steal(g_pending, url);
+
+    g_free(key);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  GList * iter = waiters;
+
+  for (; iter != NULL; iter = iter->next) {
+    ImageDelivery * delivery = g_new0(ImageDelivery, 1);
+
+    delivery->url    = g_strdup(url);
+    delivery->image  = (image) ? g_object_ref(image) : NULL;
+    delivery->waiter = *((ImageWaiter *)iter->data);
+
+    g_idle_add(image_deliver, delivery);
+  }
+
+  waiter_list_free(waiters);
+}
+
+/**
+ * The image retrieval thread function.
+ *
+ * @param arg Pointer to the URL to retrieve, freed by this function.
+ *
+ * @return NULL
+ */
+static void *
+image_fetch_threadfunc(void * arg)
+{
+  gchar * url = (gchar *)arg;
+
+  GdkPixbuf * image = image_fetch(url);
+
+  image_publish(url, image);
+
+  if (image) {
+    g_object_unref(image);
+  }
+
+  g_free(url);
+
+  return NULL;
+}
+
+/**
+ * Initializes the image cache.
+ *
+ */
+void
+imagecache_init(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (!g_images) {
+    g_images = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                     g_free, g_object_unref);
+
+    g_pending = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      g_free, waiter_list_free);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Releases all cached images.
+ *
+ */
+void
+imagecache_cleanup(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_images) {
+    g_hash_table_destroy(g_images);
+    g_hash_table_destroy(g_pending);
+
+    g_images  = NULL;
+    g_pending = NULL;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Returns the image for the specified URL. If the image is not cached yet,
+ * it is retrieved and decoded on a separate thread and the callback is
+ * invoked on the main loop when done. Concurrent requests for the same URL
+ * share a single retrieval.
+ *
+ * @param url      The URL of the image.
+ * @param callback The function to call once the image arrives.
+ * @param data     Pointer to user data to pass to the callback.
+ *
+ * @return A new reference to the cached image, in which case the callback is
+ *         never invoked, or NULL if the image is being retrieved.
+ */
+GdkPixbuf *
+imagecache_request(const gchar      * url,
+                   ImageCacheCallback callback,
+                   gpointer           data)
+{
+  if (!url || !callback) {
+    return NULL;
+  }
+
+  GdkPixbuf * image = NULL;
+
+  gboolean fetch = FALSE;
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (!g_images) {
+    pthread_mutex_unlock(&g_mutex);
+
+    LXW_LOG(LXW_ERROR, "imagecache::imagecache_request(): Not initialized");
+
+    return NULL;
+  }
+
+  image = (GdkPixbuf *)g_hash_table_lookup(g_images, url);
+
+  if (image) {
+    g_object_ref(image);
+  } else {
+    ImageWaiter * waiter = g_new0(ImageWaiter, 1);
+
+    waiter->callback = callback;
+    waiter->data     = data;
+
+    gpointer key  = NULL;
+    GList  * list = NULL;
+
+    /* only the first waiter for a URL starts a retrieval */
+    fetch = !g_hash_table_lookup_extended(g_pending, url, &key, (gpointer *)&list);
+
+    if (fetch) {
+      g_hash_table_insert(g_pending, g_strdup(url), g_list_prepend(NULL, waiter));
+    } else {
+      /* appending keeps the head, and with it the table's pointer, intact */
+      list = g_list_append(list, waiter);
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (fetch) {
+    LXW_LOG(LXW_DEBUG, "imagecache::imagecache_request(): Retrieving %s", url);
+
+    pthread_t      thread;
+    pthread_attr_t tattr;
+
+    pthread_attr_init(&tattr);
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+
+    gchar * urlcopy = g_strdup(url);
+
+    if (pthread_create(&thread, &tattr, &image_fetch_threadfunc, urlcopy)) {
+      LXW_LOG(LXW_ERROR, "imagecache::imagecache_request(): pthread_create failed");
+
+      g_free(urlcopy);
+
+      /* let the waiters know, the next request retries */
+      image_publish(url, NULL);
+    }
+
+    pthread_attr_destroy(&tattr);
+  }
+
+  return image;
+}
+
+/**
+ * Returns the image for the specified URL, retrieving and decoding it on
+ * the calling thread if it is not cached yet. Anyone waiting on an
+ * asynchronous request for the same URL is notified as well.
+ *
+ * @param url The URL of the image.
+ *
+ * @return A new reference to the image, or NULL on failure.
+ */
+GdkPixbuf *
+imagecache_fetch(const gchar * url)
+{
+  GdkPixbuf * image = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_images) {
+    image = (GdkPixbuf *)g_hash_table_lookup(g_images, url);
+  }
+
+  if (image) {
+    g_object_ref(image);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (!image) {
+    image = image_fetch(url);
+
+    image_publish(url, image);
+  }
+
+  return image;
+}
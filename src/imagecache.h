@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides an asynchronous, URL-keyed cache of condition images */
+
+#ifndef LXWEATHER_IMAGECACHE_HEADER
+#define LXWEATHER_IMAGECACHE_HEADER
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+/**
+ * Called on the main loop once an image requested through
+ * imagecache_request() has been retrieved (or failed to be retrieved).
+ *
+ * @param url   The URL that was requested.
+ * @param image The decoded image, or NULL on failure. Owned by the cache,
+ *              take a reference to keep it.
+ * @param data  Pointer to user data supplied with the request.
+ */
+typedef void (*ImageCacheCallback)(const gchar * url,
+                                   GdkPixbuf   * image,
+                                   gpointer      data);
+
+/**
+ * Initializes the image cache.
+ *
+ */
+void
+imagecache_init(void);
+
+/**
+ * Releases all cached images.
+ *
+ */
+void
+imagecache_cleanup(void);
+
+/**
+ * Returns the image for the specified URL. If the image is not cached yet,
+ * it is retrieved and decoded on a separate thread and the callback is
+ * invoked on the main loop when done. Concurrent requests for the same URL
+ * share a single retrieval.
+ *
+ * @param url      The URL of the image.
+ * @param callback The function to call once the image arrives.
+ * @param data     Pointer to user data to pass to the callback.
+ *
+ * @return A new reference to the cached image, in which case the callback is
+ *         never invoked, or NULL if the image is being retrieved.
+ */
+GdkPixbuf *
+imagecache_request(const gchar      * url,
+                   ImageCacheCallback callback,
+                   gpointer           data);
+
+/**
+ * Returns the image for the specified URL, retrieving and decoding it on
+ * the calling thread if it is not cached yet.
+ *
+ * @param url The URL of the image.
+ *
+ * @return A new reference to the image, or NULL on failure.
+ */
+GdkPixbuf *
+imagecache_fetch(const gchar * url);
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a process-wide table of interned strings */
+
+#include "intern.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* One interned string, never freed */
+typedef struct
+{
+  guint hash_;
+  gsize len_;
+  gchar str_[];
+} InternEntry;
+
+/* Slots only ever go from NULL to an entry, so readers need no lock */
+static InternEntry * volatile g_slots[INTERN_SLOTS];
+
+/* Serializes the additions */
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile gint g_count = 0;
+
+/**
+ * Hashes a string with 32-bit FNV-1a.
+ *
+ * @param value The string.
+ * @param len   Length of the string.
+ *
+ * @return The hash.
+ */
+static guint
+intern_hash(const gchar * value, gsize len)
+{
+  guint32 hash = 2166136261U;
+
+  gsize i = 0;
+  for (; i < len; ++i) {
+    hash ^= (guchar)value[i];
+    hash *= 16777619U;
+  }
+
+  return hash;
+}
+
+/**
+ * Looks a string up in the table.
+ *
+ * @param hash  Hash of the string.
+ * @param value The string.
+ * @param len   Length of the string.
+ * @param empty Location to store the index of the slot the string would go
+ *              in, may be NULL.
+ *
+ * @return The entry holding the string, or NULL if it is not interned.
+ */
+static const InternEntry *
+intern_find(guint hash, const gchar * value, gsize len, guint * empty)
+{
+  guint index = hash & (INTERN_SLOTS - 1);
+
+  /* the table is never more than half full, an empty slot ends every probe */
+  for (;;) {
+    const InternEntry * entry = g_atomic_pointer_get(&g_slots[index]);
+
+    if (!entry) {
+      if (empty) {
+        *empty = index;
+      }
+
+      return NULL;
+    }
+
+    if (entry->hash_ == hash && entry->len_ == len && !memcmp(entry->str_, value, len)) {
+      return entry;
+    }
+
+    index = (index + 1) & (INTERN_SLOTS - 1);
+  }
+}
+
+/**
+ * Returns the canonical copy of a string. Equal strings interned anywhere
+ * in the process yield the same pointer, so they compare with ==. Lookups
+ * of strings already in the table do not take any lock.
+ *
+ * @param value The string, need not be NUL-terminated.
+ * @param len   Length of the string.
+ *
+ * @return The canonical copy, valid until the process exits, or NULL if
+ *         value is NULL, too long, or the table is full.
+ */
+const gchar *
+intern_string(const gchar * value, gsize len)
+{
+  if (!value || len > INTERN_MAX_LENGTH) {
+    return NULL;
+  }
+
+  guint hash = intern_hash(value, len);
+
+  const InternEntry * entry = intern_find(hash, value, len, NULL);
+
+  if (entry) {
+    return entry->str_;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+
+  guint empty = 0;
+
+  /* somebody may have added it in the meantime */
+  entry = intern_find(hash, value, len, &empty);
+
+  if (!entry && g_atomic_int_get(&g_count) < INTERN_MAX_COUNT) {
+    InternEntry * added = g_try_malloc(sizeof(InternEntry) + len + 1);
+
+    if (added) {
+      added->hash_ = hash;
+      added->len_  = len;
+
+      memcpy(added->str_, value, len);
+
+      added->str_[len] = '\0';
+
+      /* publish only once the entry is complete */
+      g_atomic_pointer_set(&g_slots[empty], added);
+
+      g_atomic_int_inc(&g_count);
+
+      entry = added;
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  return (entry) ? entry->str_ : NULL;
+}
+
+/**
+ * Returns the number of strings interned so far.
+ *
+ * @return The number of strings in the table.
+ */
+guint
+intern_count(void)
+{
+  return (guint)g_atomic_int_get(&g_count);
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a process-wide table of interned strings */
+
+#ifndef LXWEATHER_INTERN_HEADER
+#define LXWEATHER_INTERN_HEADER
+
+#include <glib.h>
+
+/* Number of slots in the table, a power of two */
+#define INTERN_SLOTS      1024
+
+/* Strings interned at most, the rest of the slots keep probes short */
+#define INTERN_MAX_COUNT  (INTERN_SLOTS / 2)
+
+/* Longest string interned, longer ones are rarely repeated */
+#define INTERN_MAX_LENGTH 64
+
+/**
+ * Returns the canonical copy of a string. Equal strings interned anywhere
+ * in the process yield the same pointer, so they compare with ==. Lookups
+ * of strings already in the table do not take any lock.
+ *
+ * @param value The string, need not be NUL-terminated.
+ * @param len   Length of the string.
+ *
+ * @return The canonical copy, valid until the process exits, or NULL if
+ *         value is NULL, too long, or the table is full.
+ */
+const gchar *
+intern_string(const gchar * value, gsize len);
+
+/**
+ * Returns the number of strings interned so far.
+ *
+ * @return The number of strings in the table.
+ */
+guint
+intern_count(void);
+
+#endif
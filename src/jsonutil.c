@@ -0,0 +1,551 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a minimal JSON reader, enough for service responses */
+
+#include "jsonutil.h"
+#include "slabpool.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+/* Deepest nesting accepted, the parser recurses once per level */
+#define JSONUTIL_DEPTH_MAX 64
+
+typedef struct
+{
+  const gchar * curr_;
+  const gchar * end_;
+  guint         depth_;
+} JsonUtilParser;
+
+static SlabPool g_pool = SLABPOOL_INIT("json-node", sizeof(JsonUtilNode));
+
+static JsonUtilNode *
+value_parse(JsonUtilParser * parser);
+
+/**
+ * Skips the whitespace at the current position.
+ *
+ * @param parser Pointer to the parser.
+ */
+static void
+whitespace_skip(JsonUtilParser * parser)
+{
+  while (parser->curr_ < parser->end_ &&
+         (*parser->curr_ == ' '  || *parser->curr_ == '\t' ||
+          *parser->curr_ == '\n' || *parser->curr_ == '\r')) {
+    ++parser->curr_;
+  }
+}
+
+/**
+ * Reads four hexadecimal digits.
+ *
+ * @param parser Pointer to the parser, positioned at the digits.
+ * @param value  Pointer to the value read.
+ *
+ * @return TRUE on success, FALSE if the digits are missing or invalid.
+ */
+static gboolean
+hex4_parse(JsonUtilParser * parser, gunichar * value)
+{
+  if (parser->end_ - parser->curr_ < 4) {
+    return FALSE;
+  }
+
+  *value = 0;
+
+  gint i = 0;
+  for (; i < 4; ++i) {
+    gint digit = g_ascii_xdigit_value(*parser->curr_++);
+
+    if (digit < 0) {
+      return FALSE;
+    }
+
+    *value = (*value << 4) | (gunichar)digit;
+  }
+
+  return TRUE;
+}
+
+/**
+ * Reads a string, resolving the escapes.
+ *
+ * @param parser Pointer to the parser, positioned at the opening quote.
+ *
+ * @return The string, to be freed by the caller, or NULL if malformed.
+ */
+static gchar *
+string_parse(JsonUtilParser * parser)
+{
+  if (parser->curr_ >= parser->end_ || *parser->curr_ != '"') {
+    return NULL;
+  }
+
+  ++parser->curr_;
+
+  GString * str = g_string_new(NULL);
+
+  while (parser->curr_ < parser->end_) {
+    gchar c = *parser->curr_++;
+
+    if (c == '"') {
+      return g_string_free(str, FALSE);
+    }
+
+    if ((guchar)c < 0x20) {
+      break;
+    }
+
+    if (c != '\\') {
+      g_string_append_c(str, c);
+
+      continue;
+    }
+
+    if (parser->curr_ >= parser->end_) {
+      break;
+    }
+
+    c = *parser->curr_++;
+
+    if (c == 'u') {
+      gunichar ch = 0;
+
+      if (!hex4_parse(parser, &ch)) {
+        break;
+      }
+
+      /* characters outside the BMP come as a surrogate pair */
+      if (ch >= 0xD800 && ch <= 0xDBFF) {
+        gunichar low = 0;
+
+        if (parser->end_ - parser->curr_ < 2 ||
+            parser->curr_[0] != '\\' || parser->curr_[1] != 'u') {
+          break;
+        }
+
+        parser->curr_ += 2;
+
+        if (!hex4_parse(parser, &low) || low < 0xDC00 || low > 0xDFFF) {
+          break;
+        }
+
+        ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+      } else if (ch >= 0xDC00 && ch <= 0xDFFF) {
+        break;
+      }
+
+      g_string_append_unichar(str, ch);
+
+      continue;
+    }
+
+    const gchar * escapes = "\"\\/bfnrt";
+    const gchar * values  = "\"\\/\b\f\n\r\t";
+
+    const gchar * escape = (c) ? strchr(escapes, c) : NULL;
+
+    if (!escape) {
+      break;
+    }
+
+    g_string_append_c(str, values[escape - escapes]);
+  }
+
+  g_string_free(str, TRUE);
+
+  return NULL;
+}
+
+/**
+ * Reads a number, which is kept as text.
+ *
+ * @param parser Pointer to the parser, positioned at the number.
+ *
+ * @return The new node, or NULL if malformed.
+ */
+static JsonUtilNode *
+number_parse(JsonUtilParser * parser)
+{
+  const gchar * start = parser->curr_;
+
+  if (parser->curr_ < parser->end_ && *parser->curr_ == '-') {
+    ++parser->curr_;
+  }
+
+  const gchar * digits = parser->curr_;
+
+  while (parser->curr_ < parser->end_ && g_ascii_isdigit(*parser->curr_)) {
+    ++parser->curr_;
+  }
+
+  if (parser->curr_ == digits) {
+    return NULL;
+  }
+
+  if (parser->curr_ < parser->end_ && *parser->curr_ == '.') {
+    digits = ++parser->curr_;
+
+    while (parser->curr_ < parser->end_ && g_ascii_isdigit(*parser->curr_)) {
+      ++parser->curr_;
+    }
+
+    if (parser->curr_ == digits) {
+      return NULL;
+    }
+  }
+
+  if (parser->curr_ < parser->end_ && (*parser->curr_ == 'e' || *parser->curr_ == 'E')) {
+    ++parser->curr_;
+
+    if (parser->curr_ < parser->end_ && (*parser->curr_ == '+' || *parser->curr_ == '-')) {
+      ++parser->curr_;
+    }
+
+    digits = parser->curr_;
+
+    while (parser->curr_ < parser->end_ && g_ascii_isdigit(*parser->curr_)) {
+      ++parser->curr_;
+    }
+
+    if (parser->curr_ == digits) {
+      return NULL;
+    }
+  }
+
+  JsonUtilNode * node = slabpool_alloc0(&g_pool);
+
+  if (!node) {
+    return NULL;
+  }
+
+  node->type_  = JSONUTIL_NUMBER;
+  node->value_ = g_strndup(start, parser->curr_ - start);
+
+  return node;
+}
+
+/**
+ * Reads true, false or null.
+ *
+ * @param parser Pointer to the parser, positioned at the literal.
+ *
+ * @return The new node, or NULL if malformed.
+ */
+static JsonUtilNode *
+literal_parse(JsonUtilParser * parser)
+{
+  static const struct
+  {
+    const gchar * text;
+    JsonUtilType  type;
+  } literals[] = {
+    { "true",  JSONUTIL_BOOLEAN },
+    { "false", JSONUTIL_BOOLEAN },
+    { "null",  JSONUTIL_NULL }
+  };
+
+  gsize i = 0;
+  for (; i < G_N_ELEMENTS(literals); ++i) {
+    gsize len = strlen(literals[i].text);
+
+    if ((gsize)(parser->end_ - parser->curr_) >= len &&
+        !memcmp(parser->curr_, literals[i].text, len)) {
+      parser->curr_ += len;
+
+      JsonUtilNode * node = slabpool_alloc0(&g_pool);
+
+      if (!node) {
+        return NULL;
+      }
+
+      node->type_  = literals[i].type;
+      node->value_ = (literals[i].type == JSONUTIL_NULL) ? NULL : g_strdup(literals[i].text);
+
+      return node;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Reads the elements of an array or the members of an object.
+ *
+ * @param parser Pointer to the parser, positioned at the opening bracket.
+ * @param type   JSONUTIL_ARRAY or JSONUTIL_OBJECT.
+ *
+ * @return The new node, or NULL if malformed.
+ */
+static JsonUtilNode *
+container_parse(JsonUtilParser * parser, JsonUtilType type)
+{
+  gchar close = (type == JSONUTIL_OBJECT) ? '}' : ']';
+
+  if (++parser->depth_ > JSONUTIL_DEPTH_MAX) {
+    return NULL;
+  }
+
+  ++parser->curr_;
+
+  JsonUtilNode * node = slabpool_alloc0(&g_pool);
+
+  if (!node) {
+    return NULL;
+  }
+
+  node->type_ = type;
+
+  JsonUtilNode ** tail = &node->children_;
+
+  whitespace_skip(parser);
+
+  if (parser->curr_ < parser->end_ && *parser->curr_ == close) {
+    ++parser->curr_;
+
+    --parser->depth_;
+
+    return node;
+  }
+
+  while (parser->curr_ < parser->end_) {
+    gchar * name = NULL;
+
+    if (type == JSONUTIL_OBJECT) {
+      name = string_parse(parser);
+
+      whitespace_skip(parser);
+
+      if (!name || parser->curr_ >= parser->end_ || *parser->curr_ != ':') {
+        g_free(name);
+
+        break;
+      }
+
+      ++parser->curr_;
+    }
+
+    JsonUtilNode * child = value_parse(parser);
+
+    if (!child) {
+      g_free(name);
+
+      break;
+    }
+
+    child->name_ = name;
+
+    *tail = child;
+
+    tail = &child->next_;
+
+    whitespace_skip(parser);
+
+    if (parser->curr_ >= parser->end_) {
+      break;
+    }
+
+    gchar c = *parser->curr_++;
+
+    if (c == close) {
+      --parser->depth_;
+
+      return node;
+    }
+
+    if (c != ',') {
+      break;
+    }
+
+    whitespace_skip(parser);
+  }
+
+  jsonutil_free(node);
+
+  return NULL;
+}
+
+/**
+ * Reads any value.
+ *
+ * @param parser Pointer to the parser.
+ *
+ * @return The new node, or NULL if malformed.
+ */
+static JsonUtilNode *
+value_parse(JsonUtilParser * parser)
+{
+  whitespace_skip(parser);
+
+  if (parser->curr_ >= parser->end_) {
+    return NULL;
+  }
+
+  switch (*parser->curr_) {
+  case '{':
+    return container_parse(parser, JSONUTIL_OBJECT);
+
+  case '[':
+    return container_parse(parser, JSONUTIL_ARRAY);
+
+  case '"':
+    {
+      gchar * value = string_parse(parser);
+
+      if (!value) {
+        return NULL;
+      }
+
+      JsonUtilNode * node = slabpool_alloc0(&g_pool);
+
+      if (!node) {
+        g_free(value);
+
+        return NULL;
+      }
+
+      node->type_  = JSONUTIL_STRING;
+      node->value_ = value;
+
+      return node;
+    }
+
+  case 't':
+  case 'f':
+  case 'n':
+    return literal_parse(parser);
+
+  default:
+    return number_parse(parser);
+  }
+}
+
+/**
+ * Parses a JSON document.
+ *
+ * @param text   The document.
+ * @param length The length of the document.
+ *
+ * @return The root value, to be freed with jsonutil_free(), or NULL if the
+ *         document is malformed or nested too deeply.
+ */
+JsonUtilNode *
+jsonutil_parse(const gchar * text, gsize length)
+{
+  if (!text) {
+    return NULL;
+  }
+
+  JsonUtilParser parser = { text, text + length, 0 };
+
+  JsonUtilNode * root = value_parse(&parser);
+
+  whitespace_skip(&parser);
+
+  if (root && parser.curr_ != parser.end_) {
+    /* trailing garbage */
+    jsonutil_free(root);
+
+    root = NULL;
+  }
+
+  return root;
+}
+
+/**
+ * Frees a value and everything under it.
+ *
+ * @param node Pointer to the value, may be NULL.
+ */
+void
+jsonutil_free(JsonUtilNode * node)
+{
+  while (node) {
+    JsonUtilNode * next = node->next_;
+
+    jsonutil_free(node->children_);
+
+    g_free(node->name_);
+    g_free(node->value_);
+
+    slabpool_free(&g_pool, node);
+
+    node = next;
+  }
+}
+
+/**
+ * Follows a dotted path of member names from a value.
+ *
+ * @param node Pointer to the object to start from, may be NULL.
+ * @param path The member names separated by dots, e.g. "query.results".
+ *
+ * @return Pointer to the value found, owned by the document, or NULL.
+ */
+JsonUtilNode *
+jsonutil_path(JsonUtilNode * node, const gchar * path)
+{
+  while (node && *path) {
+    const gchar * dot = strchr(path, '.');
+
+    gsize len = (dot) ? (gsize)(dot - path) : strlen(path);
+
+    JsonUtilNode * child = (node->type_ == JSONUTIL_OBJECT) ? node->children_ : NULL;
+
+    while (child && (strncmp(child->name_, path, len) || child->name_[len])) {
+      child = child->next_;
+    }
+
+    node = child;
+
+    path += len;
+
+    if (*path == '.') {
+      ++path;
+    }
+  }
+
+  return node;
+}
+
+/**
+ * Returns the text of a scalar member.
+ *
+ * @param node Pointer to the object, may be NULL.
+ * @param name Name of the member.
+ *
+ * @return The text, owned by the document, or NULL if the member is missing
+ *         or is not a string, number or boolean.
+ */
+const gchar *
+jsonutil_string(JsonUtilNode * node, const gchar * name)
+{
+  JsonUtilNode * member = jsonutil_path(node, name);
+
+  if (!member || member->type_ == JSONUTIL_OBJECT || member->type_ == JSONUTIL_ARRAY) {
+    return NULL;
+  }
+
+  return member->value_;
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a minimal JSON reader, enough for service responses */
+
+#ifndef LXWEATHER_JSONUTIL_HEADER
+#define LXWEATHER_JSONUTIL_HEADER
+
+#include <glib.h>
+
+typedef enum
+{
+  JSONUTIL_NULL = 0,
+  JSONUTIL_BOOLEAN,
+  JSONUTIL_NUMBER,
+  JSONUTIL_STRING,
+  JSONUTIL_ARRAY,
+  JSONUTIL_OBJECT
+} JsonUtilType;
+
+/* One value of a parsed document. Members of an object and elements of an
+ * array are chained through next_, in document order. */
+typedef struct _JsonUtilNode
+{
+  JsonUtilType           type_;
+  gchar                * name_;      // member name, NULL outside objects
+  gchar                * value_;     // scalars only, unescaped, as text
+  struct _JsonUtilNode * children_;
+  struct _JsonUtilNode * next_;
+} JsonUtilNode;
+
+/**
+ * Parses a JSON document.
+ *
+ * @param text   The document.
+ * @param length The length of the document.
+ *
+ * @return The root value, to be freed with jsonutil_free(), or NULL if the
+ *         document is malformed or nested too deeply.
+ */
+JsonUtilNode *
+jsonutil_parse(const gchar * text, gsize length);
+
+/**
+ * Frees a value and everything under it.
+ *
+ * @param node Pointer to the value, may be NULL.
+ */
+void
+jsonutil_free(JsonUtilNode * node);
+
+/**
+ * Follows a dotted path of member names from a value.
+ *
+ * @param node Pointer to the object to start from, may be NULL.
+ * @param path The member names separated by dots, e.g. "query.results".
+ *
+ * @return Pointer to the value found, owned by the document, or NULL.
+ */
+JsonUtilNode *
+jsonutil_path(JsonUtilNode * node, const gchar * path);
+
+/**
+ * Returns the text of a scalar member.
+ *
+ * @param node Pointer to the object, may be NULL.
+ * @param name Name of the member.
+ *
+ * @return The text, owned by the document, or NULL if the member is missing
+ *         or is not a string, number or boolean.
+ */
+const gchar *
+jsonutil_string(JsonUtilNode * node, const gchar * name);
+
+#endif
@@ -22,37 +22,120 @@
 
 #include "location.h" // includes glib.h
 #include "logutil.h"
+#include "slabpool.h"
 
 #include <stdio.h>
 #include <string.h>
 
-#define RESET_PROP_VALUE(p, v, sz)  \
-  do {                              \
-    if (p) {                        \
-      g_free(p);                    \
-    }                               \
-    p = g_strndup(v, sz);           \
-  } while (0);
-
-const gchar * LocationInfoFieldNames[] = { "alias",
-                                           "city",
-                                           "state",
-                                           "country",
-                                           "woeid",
-                                           "units",
-                                           "interval",
-                                           "enabled",
-                                           NULL};
+#define LOCATIONINFO_FIELD_NAME(id, name, type, member) name,
+
+#define LOCATIONINFO_FIELD_DESCRIBE(id, name, type, member) \
+  FIELD_DESCRIBE(LocationInfo, name, type, member, id),
+
+const gchar * LocationInfoFieldNames[] = {
+  LOCATIONINFO_FIELDS(LOCATIONINFO_FIELD_NAME)
+  NULL
+};
+
+const FieldDescriptor LocationInfoFields[] = {
+  LOCATIONINFO_FIELDS(LOCATIONINFO_FIELD_DESCRIBE)
+};
+
+/* Slots of the property names, see location_property_find() */
+#define LOCATION_PROPERTY_SLOTS 16
+
+/* Perfect hash of the property names. The multipliers were picked so that
+ * no two names share a slot; adding a name means picking them again. */
+#define LOCATION_PROPERTY_HASH(name, len) \
+  (((len) + 2 * (guchar)(name)[0] + 9 * (guchar)(name)[(len) - 1]) & \
+   (LOCATION_PROPERTY_SLOTS - 1))
+
+static const struct
+{
+  const gchar     * name_;
+  LocationInfoField field_;
+} g_properties[LOCATION_PROPERTY_SLOTS] = {
+  [ 1] = { "line4",    COUNTRY  },
+  [ 2] = { "alias",    ALIAS    },
+  [ 5] = { "enabled",  ENABLED  },
+  [ 6] = { "interval", INTERVAL },
+  [ 7] = { "woeid",    WOEID    },
+  [ 8] = { "state",    STATE    },
+  [10] = { "units",    UNITS    },
+  [11] = { "city",     CITY     },
+  [14] = { "country",  COUNTRY  },
+  [15] = { "line2",    ALIAS    }
+};
+
+static SlabPool g_pool = SLABPOOL_INIT("location", sizeof(LocationInfo));
+
+/* Last version handed out by location_version_stamp() */
+static volatile gint g_version = 0;
 
 /**
- * Provides the mechanism to free any data associated with 
- * the LocationInfo structure
+ * Stamps the location with a new, process-wide unique version, so that
+ * whoever remembers the previous one knows to look again.
  *
- * @param location Location entry to free.
+ * @param info Pointer to the location to stamp.
+ */
+static void
+location_version_stamp(LocationInfo * info)
+{
+  /* never hand out 0, it stands for 'no location' */
+  gint version = 0;
+
+  do {
+    version = g_atomic_int_add(&g_version, 1) + 1;
+  } while (!version);
+
+  info->version_ = (guint)version;
+}
+
+/**
+ * Allocates an empty location holding a single reference.
  *
+ * @return Pointer to the new location, or NULL if the allocation failed.
+ */
+gpointer
+location_new(void)
+{
+  LocationInfo * info = slabpool_alloc0(&g_pool);
+
+  if (info) {
+    info->units_    = 'f';
+    info->refcount_ = 1;
+
+    location_version_stamp(info);
+  }
+
+  return info;
+}
+
+/**
+ * Takes a reference to a location.
+ *
+ * @param location Pointer to the location, may be NULL.
+ *
+ * @return The location passed in.
+ */
+gpointer
+location_ref(gpointer location)
+{
+  if (location) {
+    g_atomic_int_inc(&((LocationInfo *)location)->refcount_);
+  }
+
+  return location;
+}
+
+/**
+ * Releases a reference to a location, freeing any data associated with it
+ * once the last one is gone.
+ *
+ * @param location Pointer to the location, may be NULL.
  */
 void
-location_free(gpointer location)
+location_unref(gpointer location)
 {
   if (!location) {
     return;
@@ -60,13 +143,16 @@ location_free(gpointer location)
 
   LocationInfo * info = (LocationInfo *)location;
 
-  g_free(info->alias_);
-  g_free(info->city_);
-  g_free(info->state_);
-  g_free(info->country_);
-  g_free(info->woeid_);
+  if (!g_atomic_int_dec_and_test(&info->refcount_)) {
+    return;
+  }
+
+  gint f = 0;
+  for (; f < LOCATIONINFO_FIELD_COUNT; ++f) {
+    field_clear(&LocationInfoFields[f], info);
+  }
 
-  g_free(location);
+  slabpool_free(&g_pool, info);
 }
 
 /**
@@ -88,22 +174,54 @@ location_print(gpointer location G_GNUC_UNUSED)
   LocationInfo * info = (LocationInfo *)location;
 
   LXW_LOG(LXW_VERBOSE, "Entry:");
-  LXW_LOG(LXW_VERBOSE, "\tAlias: %s",    (const char *)info->alias_);
-  LXW_LOG(LXW_VERBOSE, "\tCity: %s",     (const char *)info->city_);
-  LXW_LOG(LXW_VERBOSE, "\tState: %s",    (const char *)info->state_);
-  LXW_LOG(LXW_VERBOSE, "\tCountry: %s",  (const char *)info->country_);
-  LXW_LOG(LXW_VERBOSE, "\tWOEID: %s",    (const char *)info->woeid_);
-  LXW_LOG(LXW_VERBOSE, "\tUnits: %c",    (info->units_)?info->units_:'A');
-  LXW_LOG(LXW_VERBOSE, "\tInterval: %u", info->interval_);
-  LXW_LOG(LXW_VERBOSE, "\tEnabled: %s",  (info->enabled_)?"yes":"no");
+
+  gint f = 0;
+  for (; f < LOCATIONINFO_FIELD_COUNT; ++f) {
+    gchar * value = field_format(&LocationInfoFields[f], info);
+
+    LXW_LOG(LXW_VERBOSE, "\t%s: %s", LocationInfoFields[f].name_, value);
+
+    g_free(value);
+  }
 #endif
 }
 
 
 /**
- * Sets the given property for the location
+ * Finds the field a property name sets.
+ *
+ * @param property Name of the property.
+ *
+ * @return The descriptor of the field, or NULL if the name is unknown.
+ */
+static const FieldDescriptor *
+location_property_find(const gchar * property)
+{
+  gsize len = (property) ? strlen(property) : 0;
+
+  if (!len) {
+    return NULL;
+  }
+
+  guint slot = LOCATION_PROPERTY_HASH(property, len);
+
+  const gchar * name = g_properties[slot].name_;
+
+  /* a single comparison settles it */
+  if (!name || strcmp(name, property)) {
+    return NULL;
+  }
+
+  return &LocationInfoFields[g_properties[slot].field_];
+}
+
+/**
+ * Sets the given property for the location. Besides the field names, the
+ * placefinder's line2 and line4 set the alias and the country. Unknown
+ * properties are ignored.
  *
- * @param location Pointer to the location to modify.
+ * @param location Pointer to the location to modify, which must not be
+ *                 shared, see location_writable().
  * @param property Name of the property to set.
  * @param value    Value to assign to the property.
  * @param len      Length of the value to assign to the property (think strlen())
@@ -120,87 +238,104 @@ location_property_set(gpointer      location,
     return;
   }
 
-  LocationInfo * info = (LocationInfo *)location;
+  const FieldDescriptor * field = location_property_find(property);
+
+  if (field) {
+    field_parse(field, location, value, len);
 
-  if (!strcmp(property, "alias")) {
-    RESET_PROP_VALUE(info->alias_, value, len);
-  } else if (!strcmp(property, "city")) {
-    RESET_PROP_VALUE(info->city_, value, len);
-  } else if (!strcmp(property, "state")) {
-    RESET_PROP_VALUE(info->state_, value, len);
-  } else if (!strcmp(property, "country")) {
-    RESET_PROP_VALUE(info->country_, value, len);
-  } else if (!strcmp(property, "woeid")) {
-    RESET_PROP_VALUE(info->woeid_, value, len);
-  } else if (!strcmp(property, "line2")) {
-    RESET_PROP_VALUE(info->alias_, value, len);
-  } else if (!strcmp(property, "line4")) {
-    RESET_PROP_VALUE(info->country_, value, len);
+    location_version_stamp((LocationInfo *)location);
   }
 }
 
 /**
- * Copies a location entry.
+ * Makes sure the caller holds the only reference to a location, so that it
+ * can be modified. A shared location is replaced by a private copy, and the
+ * caller's reference to the shared one is released. Either way, the
+ * location gets a new version.
+ *
+ * @param location Address of the pointer to the location.
+ *
+ * @return Pointer to the location that may be modified, or NULL if a copy
+ *         was needed but could not be made. *location is left as-is then.
+ */
+gpointer
+location_writable(gpointer * location)
+{
+  if (!location || !*location) {
+    return NULL;
+  }
+
+  LocationInfo * srcinfo = (LocationInfo *) *location;
+
+  if (g_atomic_int_get(&srcinfo->refcount_) == 1) {
+    /* the caller is about to modify it */
+    location_version_stamp(srcinfo);
+
+    return srcinfo;
+  }
+
+  LocationInfo * dstinfo = (LocationInfo *)location_new();
+
+  if (!dstinfo) {
+    return NULL;
+  }
+
+  gint f = 0;
+  for (; f < LOCATIONINFO_FIELD_COUNT; ++f) {
+    field_copy(&LocationInfoFields[f], dstinfo, srcinfo);
+  }
+
+  if (!dstinfo->units_) {
+    dstinfo->units_ = 'f';
+  }
+
+  location_unref(srcinfo);
+
+  *location = dstinfo;
+
+  return dstinfo;
+}
+
+/**
+ * Points a location reference at another location.
  *
  * @param dst Address of the pointer to the location to set.
- * @param src      Pointer to the location to use/copy.
+ * @param src Pointer to the location to use.
  *
- * @note Destination is first freed, if non-NULL, otherwise a new allocation
- *       is made. Both source and destination locations must be released by
- *       the caller.
+ * @note If both describe the same place, only the alias of the source is
+ *       taken over and the settings of the destination are kept, copying the
+ *       destination first if it is shared. Otherwise the destination's
+ *       reference is released and a reference to the source is taken.
  */
 void
-location_copy(gpointer * dst, gpointer src)
+location_assign(gpointer * dst, gpointer src)
 {
-  if (!src || !dst) {
+  if (!src || !dst || *dst == src) {
     return;
   }
 
-  if ((LocationInfo *) *dst) {
-    /* Check if the two are the same, first */
-    LocationInfo * dstinfo = (LocationInfo *) *dst;
-    LocationInfo * srcinfo = (LocationInfo *) src;
+  LocationInfo * dstinfo = (LocationInfo *) *dst;
+  LocationInfo * srcinfo = (LocationInfo *) src;
+
+  if (dstinfo && !g_strcmp0(dstinfo->woeid_, srcinfo->woeid_)) {
+    if (!g_strcmp0(dstinfo->alias_, srcinfo->alias_)) {
+      return;
+    }
+
+    dstinfo = (LocationInfo *)location_writable(dst);
 
-    if (!strncmp(dstinfo->woeid_, srcinfo->woeid_, strlen(srcinfo->woeid_))) {
+    if (dstinfo) {
       /* they're the same, no need to copy, just assign alias */
-      location_property_set(*dst,
+      location_property_set(dstinfo,
                             "alias",
                             srcinfo->alias_,
                             (srcinfo->alias_) ? strlen(srcinfo->alias_) : 0);
-          
-      return;
     }
 
-    location_free(*dst);
-
-    *dst = NULL;
-  }
-
-  /* allocate new */
-  *dst = g_try_new0(LocationInfo, 1);
-
-  if (*dst) {
-    LocationInfo * dstinfo = (LocationInfo *) *dst;
-    LocationInfo * srcinfo  = (LocationInfo *)src;
-
-    dstinfo->alias_ = g_strndup(srcinfo->alias_,
-                                (srcinfo->alias_)?strlen(srcinfo->alias_):0);
-    
-    dstinfo->city_ = g_strndup(srcinfo->city_,
-                               (srcinfo->city_)?strlen(srcinfo->city_):0);
-    
-    dstinfo->state_ = g_strndup(srcinfo->state_,
-                                (srcinfo->state_)?strlen(srcinfo->state_):0);
-    
-    dstinfo->country_ = g_strndup(srcinfo->country_,
-                                  (srcinfo->country_)?strlen(srcinfo->country_):0);
-    
-    dstinfo->woeid_ = g_strndup(srcinfo->woeid_,
-                                (srcinfo->woeid_)?strlen(srcinfo->woeid_):0);
-    
-    dstinfo->units_    = (srcinfo->units_) ? srcinfo->units_ : 'f';
-    dstinfo->interval_ = srcinfo->interval_;
-    dstinfo->enabled_  = srcinfo->enabled_;
-  }
-  
+    return;
+  }
+
+  location_unref(dstinfo);
+
+  *dst = location_ref(srcinfo);
 }
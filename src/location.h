@@ -23,14 +23,18 @@
 #ifndef LXWEATHER_LOCATION_HEADER
 #define LXWEATHER_LOCATION_HEADER
 
-#include <glib.h>
+#include "field.h" // includes glib.h
+
 #include <string.h>
 
 /* */
 #define LOCATIONINFO_GROUP_NAME "Location"
 #define LOCATIONINFO_GROUP_NAME_LENGTH strlen(LOCATIONINFO_GROUP_NAME)
 
-/* LocationInfo struct definition */
+/*
+ * LocationInfo struct definition. Locations are shared by reference, so
+ * one that has been handed out is only modified through location_writable()
+ */
 typedef struct 
 {
   gchar *  alias_;
@@ -41,34 +45,67 @@ typedef struct
   gchar    units_;
   guint    interval_;
   gboolean enabled_;
+  guint    version_;   // process-wide unique, new with every modification
+  volatile gint refcount_;
 } LocationInfo;
 
+/*
+ * The fields of a location, as X(id, name, type, member). The names are
+ * the keys of the configuration file and of the location cache.
+ */
+#define LOCATIONINFO_FIELDS(X)                    \
+  X(ALIAS,    "alias",    FIELD_STRING,  alias_)    \
+  X(CITY,     "city",     FIELD_STRING,  city_)     \
+  X(STATE,    "state",    FIELD_STRING,  state_)    \
+  X(COUNTRY,  "country",  FIELD_STRING,  country_)  \
+  X(WOEID,    "woeid",    FIELD_STRING,  woeid_)    \
+  X(UNITS,    "units",    FIELD_CHAR,    units_)    \
+  X(INTERVAL, "interval", FIELD_UINT,    interval_) \
+  X(ENABLED,  "enabled",  FIELD_BOOLEAN, enabled_)
+
 /* Configuration helpers */
+#define LOCATIONINFO_FIELD_ID(id, name, type, member) id,
+
 typedef enum
 {
-  ALIAS = 0,
-  CITY,
-  STATE,
-  COUNTRY,
-  WOEID,
-  UNITS,
-  INTERVAL,
-  ENABLED,
+  LOCATIONINFO_FIELDS(LOCATIONINFO_FIELD_ID)
   LOCATIONINFO_FIELD_COUNT
 } LocationInfoField;
 
+#undef LOCATIONINFO_FIELD_ID
+
 /* Defined in the .c file - specifies the array of field names */
 extern const gchar * LocationInfoFieldNames[];
 
+/* Defined in the .c file - describes each field, in LocationInfoField order */
+extern const FieldDescriptor LocationInfoFields[];
+
+/**
+ * Allocates an empty location holding a single reference.
+ *
+ * @return Pointer to the new location, or NULL if the allocation failed.
+ */
+gpointer
+location_new(void);
+
 /**
- * Provides the mechanism to free any data associated with 
- * the LocationInfo structure
+ * Takes a reference to a location.
+ *
+ * @param location Pointer to the location, may be NULL.
  *
- * @param location Location entry to free.
+ * @return The location passed in.
+ */
+gpointer
+location_ref(gpointer location);
+
+/**
+ * Releases a reference to a location, freeing any data associated with it
+ * once the last one is gone.
  *
+ * @param location Pointer to the location, may be NULL.
  */
 void
-location_free(gpointer location);
+location_unref(gpointer location);
 
 /**
  * Prints the contents of the supplied entry to stdout
@@ -80,9 +117,12 @@ void
 location_print(gpointer location);
 
 /**
- * Sets the given property for the location
+ * Sets the given property for the location. Besides the field names, the
+ * placefinder's line2 and line4 set the alias and the country. Unknown
+ * properties are ignored.
  *
- * @param location Pointer to the location to modify.
+ * @param location Pointer to the location to modify, which must not be
+ *                 shared, see location_writable().
  * @param property Name of the property to set.
  * @param value    Value to assign to the property.
  * @param len      Length of the value to assign to the property (think strlen())
@@ -94,16 +134,31 @@ location_property_set(gpointer      location,
                       gsize         len);
 
 /**
- * Copies a location entry.
+ * Makes sure the caller holds the only reference to a location, so that it
+ * can be modified. A shared location is replaced by a private copy, and the
+ * caller's reference to the shared one is released. Either way, the
+ * location gets a new version.
+ *
+ * @param location Address of the pointer to the location.
+ *
+ * @return Pointer to the location that may be modified, or NULL if a copy
+ *         was needed but could not be made. *location is left as-is then.
+ */
+gpointer
+location_writable(gpointer * location);
+
+/**
+ * Points a location reference at another location.
  *
  * @param dst Address of the pointer to the location to set.
- * @param src Pointer to the location to use/copy.
+ * @param src Pointer to the location to use.
  *
- * @note Destination is first freed, if non-NULL, otherwise a new allocation
- *       is made. Both source and destination locations must be released by
- *       the caller.
+ * @note If both describe the same place, only the alias of the source is
+ *       taken over and the settings of the destination are kept, copying the
+ *       destination first if it is shared. Otherwise the destination's
+ *       reference is released and a reference to the source is taken.
  */
 void
-location_copy(gpointer * dst, gpointer src);
+location_assign(gpointer * dst, gpointer src);
 
 #endif
@@ -0,0 +1,442 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a persistent cache of location search results */
+
+#include "locationcache.h"
+#include "location.h"
+#include "logutil.h"
+#include "textutil.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* Key holding the time an entry was stored */
+#define LOCATIONCACHE_STORED_KEY "stored"
+
+/* Fields kept for every result, in the order of LocationInfoField */
+#define LOCATIONCACHE_FIELD_COUNT (WOEID + 1)
+
+typedef struct
+{
+  gint64  stored_;
+  GList * list_;
+} LocationCacheEntry;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Normalized query -> LocationCacheEntry */
+static GHashTable * g_entries = NULL;
+
+/* Mirror of the file backing the cache */
+static GKeyFile   * g_keyfile = NULL;
+static gchar      * g_path    = NULL;
+
+/**
+ * Frees a cache entry and its results.
+ *
+ * @param data Pointer to the entry to free.
+ */
+static void
+entry_free(gpointer data)
+{
+  LocationCacheEntry * entry = (LocationCacheEntry *)data;
+
+  if (entry) {
+    g_list_free_full(entry->list_, location_unref);
+
+    g_free(entry);
+  }
+}
+
+/**
+ * Copies a list of LocationInfo entries, sharing the entries themselves.
+ *
+ * @param list The list to copy.
+ *
+ * @return The copy, which must be freed by the caller.
+ */
+static GList *
+list_copy(GList * list)
+{
+  GList * copy = g_list_copy(list);
+
+  GList * iter = copy;
+
+  for (; iter; iter = iter->next) {
+    location_ref(iter->data);
+  }
+
+  return copy;
+}
+
+/**
+ * Reads the entry stored in one group of the key file.
+ *
+ * @param group The group holding the entry.
+ *
+ * @return The entry, or NULL if it is malformed.
+ */
+static LocationCacheEntry *
+entry_read(const gchar * group)
+{
+  gchar ** fields[LOCATIONCACHE_FIELD_COUNT];
+  gsize    count = 0;
+
+  gint64 stored = g_key_file_get_int64(g_keyfile, group, LOCATIONCACHE_STORED_KEY, NULL);
+
+  gint f = 0;
+  for (; f < LOCATIONCACHE_FIELD_COUNT; ++f) {
+    gsize len = 0;
+
+    fields[f] = g_key_file_get_string_list(g_keyfile,
+                                           group,
+                                           LocationInfoFieldNames[f],
+                                           &len,
+                                           NULL);
+
+    /* all fields must have one value per result */
+    if (!f) {
+      count = len;
+    } else if (len != count) {
+      count = 0;
+    }
+  }
+
+  LocationCacheEntry * entry = NULL;
+
+  if (count && stored > 0) {
+    entry = g_new0(LocationCacheEntry, 1);
+
+    entry->stored_ = stored;
+
+    gsize i = 0;
+    for (; i < count; ++i) {
+      LocationInfo * location = (LocationInfo *)location_new();
+
+      if (!location) {
+        continue;
+      }
+
+      for (f = 0; f < LOCATIONCACHE_FIELD_COUNT; ++f) {
+        /* empty strings stand for missing values */
+        if (*fields[f][i]) {
+          location_property_set(location,
+                                LocationInfoFieldNames[f],
+                                fields[f][i],
+                                strlen(fields[f][i]));
+        }
+      }
+
+      entry->list_ = g_list_prepend(entry->list_, location);
+    }
+
+    entry->list_ = g_list_reverse(entry->list_);
+  }
+
+  for (f = 0; f < LOCATIONCACHE_FIELD_COUNT; ++f) {
+    g_strfreev(fields[f]);
+  }
+
+  return entry;
+}
+
+/**
+ * Writes an entry into one group of the key file.
+ *
+ * @param group The group to hold the entry.
+ * @param entry The entry to write.
+ */
+static void
+entry_write(const gchar * group, LocationCacheEntry * entry)
+{
+  guint count = g_list_length(entry->list_);
+
+  g_key_file_remove_group(g_keyfile, group, NULL);
+
+  g_key_file_set_int64(g_keyfile, group, LOCATIONCACHE_STORED_KEY, entry->stored_);
+
+  gint f = 0;
+  for (; f < LOCATIONCACHE_FIELD_COUNT; ++f) {
+    const gchar ** values = g_new0(const gchar *, count + 1);
+
+    GList * iter = entry->list_;
+
+    guint i = 0;
+    for (; iter; iter = iter->next, ++i) {
+      LocationInfo * location = (LocationInfo *)iter->data;
+
+      /* the cached fields are all strings */
+      const gchar * value = G_STRUCT_MEMBER(const gchar *, location,
+                                            LocationInfoFields[f].offset_);
+
+      values[i] = (value) ? value : "";
+    }
+
+    g_key_file_set_string_list(g_keyfile, group, LocationInfoFieldNames[f], values, count);
+
+    g_free(values);
+  }
+}
+
+/**
+ * Writes the key file to disk, creating the directory if needed.
+ * Must be called with the mutex held.
+ */
+static void
+cache_save(void)
+{
+  if (!g_path) {
+    return;
+  }
+
+  gchar * dirpath = g_path_get_dirname(g_path);
+
+  if (g_mkdir_with_parents(dirpath, 0700)) {
+    LXW_LOG(LXW_ERROR, "locationcache::save(): could not create %s", dirpath);
+
+    g_free(dirpath);
+
+    return;
+  }
+
+  g_free(dirpath);
+
+  gsize    datalen = 0;
+  GError * pError  = NULL;
+
+  gchar * data = g_key_file_to_data(g_keyfile, &datalen, NULL);
+
+  if (!g_file_set_contents(g_path, data, datalen, &pError)) {
+    LXW_LOG(LXW_ERROR, "locationcache::save(): could not write %s: %s",
+            g_path, pError->message);
+
+    g_error_free(pError);
+  }
+
+  g_free(data);
+}
+
+/**
+ * Initializes the cache and loads the entries stored at the path.
+ *
+ * @param path Path to the file backing the cache.
+ */
+void
+locationcache_init(const gchar * path)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (!g_entries) {
+    g_entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, entry_free);
+    g_keyfile = g_key_file_new();
+    g_path    = g_strdup(path);
+
+    GError * pError = NULL;
+
+    if (g_path &&
+        !g_key_file_load_from_file(g_keyfile, g_path, G_KEY_FILE_NONE, &pError)) {
+      /* a missing cache is not an error */
+      LXW_LOG(LXW_DEBUG, "locationcache::init(%s): %s", g_path, pError->message);
+
+      g_error_free(pError);
+    }
+
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    gboolean pruned = FALSE;
+
+    gchar ** groups = g_key_file_get_groups(g_keyfile, NULL);
+
+    gsize i = 0;
+    for (; groups && groups[i]; ++i) {
+      LocationCacheEntry * entry = entry_read(groups[i]);
+
+      if (entry && now - entry->stored_ < LOCATIONCACHE_TTL) {
+        g_hash_table_insert(g_entries, g_strdup(groups[i]), entry);
+      } else {
+        entry_free(entry);
+
+        g_key_file_remove_group(g_keyfile, groups[i], NULL);
+
+        pruned = TRUE;
+      }
+    }
+
+    g_strfreev(groups);
+
+    if (pruned) {
+      cache_save();
+    }
+
+    LXW_LOG(LXW_DEBUG, "locationcache::init(%s): %u entries",
+            g_path, g_hash_table_size(g_entries));
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Releases all cached entries.
+ *
+ */
+void
+locationcache_cleanup(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_entries) {
+    g_hash_table_destroy(g_entries);
+    g_key_file_free(g_keyfile);
+    g_free(g_path);
+
+    g_entries = NULL;
+    g_keyfile = NULL;
+    g_path    = NULL;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Looks up the results of an earlier search. The query is normalized, so
+ * differences in case, accents, punctuation and spacing do not matter.
+ *
+ * @param query The string the user searched for.
+ *
+ * @return A list of shared LocationInfo references, or NULL if there is no
+ *         fresh entry.
+ *         Caller is responsible for freeing the list.
+ */
+GList *
+locationcache_lookup(const gchar * query)
+{
+  if (!query) {
+    return NULL;
+  }
+
+  gchar * key = textutil_query_normalize(query);
+
+  GList * list = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+
+  LocationCacheEntry * entry = (g_entries) ? g_hash_table_lookup(g_entries, key) : NULL;
+
+  if (entry) {
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    if (now - entry->stored_ < LOCATIONCACHE_TTL) {
+      list = list_copy(entry->list_);
+    } else {
+      /* stale, the next search goes to the network */
+      g_hash_table_remove(g_entries, key);
+      g_key_file_remove_group(g_keyfile, key, NULL);
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  LXW_LOG(LXW_DEBUG, "locationcache::lookup(%s): '%s' %s",
+          query, key, (list) ? "hit" : "miss");
+
+  g_free(key);
+
+  return list;
+}
+
+/**
+ * Stores the results of a search, in memory and on disk. Empty results are
+ * not stored.
+ *
+ * @param query The string the user searched for.
+ * @param list  The list of LocationInfo results, referenced by the cache.
+ */
+void
+locationcache_store(const gchar * query, GList * list)
+{
+  if (!query || !list) {
+    return;
+  }
+
+  gchar * key = textutil_query_normalize(query);
+
+  if (!*key) {
+    g_free(key);
+
+    return;
+  }
+
+  LocationCacheEntry * entry = g_new0(LocationCacheEntry, 1);
+
+  entry->stored_ = g_get_real_time() / G_USEC_PER_SEC;
+  entry->list_   = list_copy(list);
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_entries) {
+    entry_write(key, entry);
+
+    /* the table takes ownership of both */
+    g_hash_table_replace(g_entries, key, entry);
+
+    cache_save();
+  } else {
+    entry_free(entry);
+
+    g_free(key);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Calls the function for every cached LocationInfo result, with the cache
+ * locked. The function must not call back into the cache.
+ *
+ * @param func Function to call with each LocationInfo entry.
+ * @param data Pointer to user data passed to the function.
+ */
+void
+locationcache_foreach(GFunc func, gpointer data)
+{
+  if (!func) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_entries) {
+    GHashTableIter iter;
+
+    gpointer value = NULL;
+
+    g_hash_table_iter_init(&iter, g_entries);
+
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      g_list_foreach(((LocationCacheEntry *)value)->list_, func, data);
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a persistent cache of location search results */
+
+#ifndef LXWEATHER_LOCATIONCACHE_HEADER
+#define LXWEATHER_LOCATIONCACHE_HEADER
+
+#include <glib.h>
+
+/* Place data hardly ever changes, keep results for 30 days */
+#define LOCATIONCACHE_TTL (30 * 24 * 60 * 60)
+
+/**
+ * Initializes the cache and loads the entries stored at the path.
+ *
+ * @param path Path to the file backing the cache.
+ */
+void
+locationcache_init(const gchar * path);
+
+/**
+ * Releases all cached entries.
+ *
+ */
+void
+locationcache_cleanup(void);
+
+/**
+ * Looks up the results of an earlier search. The query is normalized, so
+ * differences in case, accents, punctuation and spacing do not matter.
+ *
+ * @param query The string the user searched for.
+ *
+ * @return A list of shared LocationInfo references, or NULL if there is no
+ *         fresh entry.
+ *         Caller is responsible for freeing the list.
+ */
+GList *
+locationcache_lookup(const gchar * query);
+
+/**
+ * Stores the results of a search, in memory and on disk. Empty results are
+ * not stored.
+ *
+ * @param query The string the user searched for.
+ * @param list  The list of LocationInfo results, referenced by the cache.
+ */
+void
+locationcache_store(const gchar * query, GList * list);
+
+/**
+ * Calls the function for every cached LocationInfo result, with the cache
+ * locked. The function must not call back into the cache.
+ *
+ * @param func Function to call with each LocationInfo entry.
+ * @param data Pointer to user data passed to the function.
+ */
+void
+locationcache_foreach(GFunc func, gpointer data);
+
+#endif
@@ -20,10 +20,17 @@
 
 #include "logutil.h"
 #include "yahooutil.h"
+#include "provider.h"
 #include "fileutil.h"
+#include "gazetteer.h"
+#include "locationcache.h"
+#include "placeindex.h"
+#include "refresh.h"
+#include "fleet.h"
 #include "location.h"
 #include "forecast.h"
 #include "weatherwidget.h"
+#include "imagecache.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -36,6 +43,9 @@
 
 #define APP_NAME "lxweather"
 
+/* Seconds between the refresh statistics in the debug log */
+#define STATS_LOG_INTERVAL 300
+
 /* signal handler to insure cleanup */
 static void
 sighandler(int signal)
@@ -77,6 +87,7 @@ static struct option longopts[] =
   {"config",   1, NULL, 2},
   {"logfile",  1, NULL, 3},
   {"loglevel", 1, NULL, 4},
+  {"gazetteer", 1, NULL, 5},
   {NULL,       0, NULL, 0}
 };
 
@@ -85,6 +96,7 @@ typedef struct
 {
   GtkWeather    * widget_;
   GtkStatusIcon * icon_;
+  guint           version_;  // of the forecast the icon shows, 0 if none
 } WeatherWidgetEntry;
 
 /* List with WeatherWidgetEntry entries */
@@ -107,6 +119,8 @@ usage(const char *progname)
   fprintf(stderr, "  -l|--loglevel Specify the level to log at. Acceptable values: \n");
   fprintf(stderr, "                0 (no logging), 1 (log only errors), 2 (log errors and debug messages),\n");
   fprintf(stderr, "                3 (show verbose output) [Default: 0]\n");
+  fprintf(stderr, "  -g|--gazetteer Specify the offline place database to search first\n");
+  fprintf(stderr, "                [Default: $HOME/.local/share/" APP_NAME "/gazetteer, if present].\n");
   fprintf(stderr, "  -h|--help     Print this message and exit.\n");
 }
 
@@ -131,6 +145,8 @@ location_changed(GtkWeather * weather  G_GNUC_UNUSED,
 
   if (entry) {
     gtk_status_icon_set_from_stock(entry->icon_, GTK_STOCK_DIALOG_WARNING);
+
+    entry->version_ = 0;
   }
 }
 
@@ -138,11 +154,12 @@ location_changed(GtkWeather * weather  G_GNUC_UNUSED,
  * Handles the forecast-changed event.
  *
  * @param weather Pointer to the weather instance generating the event.
- * @param forecast Pointer to the ForecastInfo object (can be NULL).
+ * @param forecast Pointer to the ForecastInfo object (can be NULL). Only
+ *                 valid for the duration of the call, unless referenced.
  * @param data     Pointer to user data.
  */
 static void
-forecast_changed(GtkWeather * weather, gpointer forecast, gpointer data)
+forecast_changed(GtkWeather * weather G_GNUC_UNUSED, gpointer forecast, gpointer data)
 {
   WeatherWidgetEntry * entry = (WeatherWidgetEntry *) data;
 
@@ -151,29 +168,31 @@ forecast_changed(GtkWeather * weather, gpointer forecast, gpointer data)
   
   if (entry) {
     if (forecast) {
-      LXW_LOG(LXW_DEBUG, "Setting status icon.");
-      gtk_status_icon_set_from_pixbuf(entry->icon_,
-                                      ((ForecastInfo *)forecast)->image_);
+      guint changes = forecast_changes(forecast, entry->version_);
+
+      entry->version_ = ((ForecastInfo *)forecast)->version_;
+
+      /* most refreshes leave the conditions, and so the image, alone */
+      if ((changes & FORECAST_CHANGED_IMAGE) &&
+          ((ForecastInfo *)forecast)->image_) {
+        LXW_LOG(LXW_DEBUG, "Setting status icon.");
+        gtk_status_icon_set_from_pixbuf(entry->icon_,
+                                        ((ForecastInfo *)forecast)->image_);
+      }
     } else {
       LXW_LOG(LXW_DEBUG, "Setting status icon STOCK.");
       gtk_status_icon_set_from_stock(entry->icon_,
                                      GTK_STOCK_DIALOG_WARNING);
-    }
 
-    LXW_LOG(LXW_DEBUG, "Getting status tooltip.");
-    gchar * tooltip_text = gtk_weather_get_tooltip_text(GTK_WIDGET(weather));
+      entry->version_ = 0;
+    }
 
-    LXW_LOG(LXW_DEBUG, "Setting status tooltip.");
-    gtk_status_icon_set_tooltip_text(entry->icon_, tooltip_text);
 
     LXW_LOG(LXW_DEBUG, "Setting icon visible %d, %d.",
             gtk_status_icon_get_visible(entry->icon_),
             gtk_status_icon_is_embedded(entry->icon_));
 
     //gtk_status_icon_set_visible(entry->icon_, TRUE);
-
-    LXW_LOG(LXW_DEBUG, "free tooltip.");
-    g_free(tooltip_text);
   }
 
   LXW_LOG(LXW_DEBUG, "...Done.");
@@ -217,6 +236,42 @@ icon_popup_menu(GtkStatusIcon * icon, guint button, guint time, gpointer data)
   gtk_weather_run_popup_menu(GTK_WIDGET(data));
 }
 
+/**
+ * Handles the 'query-tooltip' signal for the status icon. The tooltip text
+ * is only generated when the icon is actually hovered.
+ *
+ * @param icon          Pointer to the status icon from which the signal is emitted.
+ * @param x             The x coordinate of the cursor position.
+ * @param y             The y coordinate of the cursor position.
+ * @param keyboard_mode TRUE if the tooltip was triggered using the keyboard.
+ * @param tooltip       Pointer to the tooltip to fill in.
+ * @param data          Pointer to user data.
+ *
+ * @return TRUE if the tooltip should be shown, FALSE otherwise.
+ */
+static gboolean
+icon_query_tooltip(GtkStatusIcon * icon,
+                   gint            x,
+                   gint            y,
+                   gboolean        keyboard_mode,
+                   GtkTooltip    * tooltip,
+                   gpointer        data)
+{
+  /* To avoid compiler warning */
+  (void)icon;
+  (void)x;
+  (void)y;
+  (void)keyboard_mode;
+
+  gchar * tooltip_text = gtk_weather_get_tooltip_text(GTK_WIDGET(data));
+
+  gtk_tooltip_set_text(tooltip, tooltip_text);
+
+  g_free(tooltip_text);
+
+  return TRUE;
+}
+
 /* WeatherWidget UTILITY functions */
 
 /**
@@ -258,6 +313,13 @@ entry_new()
                      G_CALLBACK(icon_popup_menu),
                      (gpointer)weather);
 
+    g_signal_connect(G_OBJECT(icon),
+                     "query-tooltip",
+                     G_CALLBACK(icon_query_tooltip),
+                     (gpointer)weather);
+
+    gtk_status_icon_set_has_tooltip(icon, TRUE);
+
     entry->widget_ = GTK_WEATHER(weather);
     entry->icon_   = icon;
   }
@@ -285,6 +347,21 @@ entry_free(gpointer entry)
   }
 }
 
+/**
+ * Logs the refresh statistics.
+ *
+ * @param data Unused.
+ *
+ * @return TRUE, so that the function is called again.
+ */
+static gboolean
+stats_log_timeout(gpointer data G_GNUC_UNUSED)
+{
+  refresh_stats_log();
+
+  return TRUE;
+}
+
 /* -- main -- */
 int
 main(int argc, char **argv)
@@ -294,9 +371,10 @@ main(int argc, char **argv)
 
   gchar * config   = NULL;
   gchar * logfile  = NULL;
+  gchar * gazetteer = NULL;
   gint    loglevel = LXW_NONE;
   
-  while ((rc = getopt_long(argc, argv, "c:hf:l:", longopts, &optindx)) != -1) {
+  while ((rc = getopt_long(argc, argv, "c:hf:l:g:", longopts, &optindx)) != -1) {
     switch (rc) {
     case 1:
     case 'h':
@@ -325,6 +403,11 @@ main(int argc, char **argv)
 
       break;
 
+    case 5:
+    case 'g':
+      gazetteer = g_strndup(optarg, strlen(optarg));
+      break;
+
     default:
       /* Unhandled */
       usage(argv[0]);
@@ -363,6 +446,41 @@ main(int argc, char **argv)
   /* do some magic here */
   yahooutil_init();
 
+  provider_init();
+
+  gchar * locationcache = g_strdup_printf("%s%s%s%slocations",
+                                          g_get_user_cache_dir(),
+                                          G_DIR_SEPARATOR_S,
+                                          APP_NAME,
+                                          G_DIR_SEPARATOR_S);
+
+  locationcache_init(locationcache);
+
+  g_free(locationcache);
+
+  if (!gazetteer) {
+    gazetteer = g_strdup_printf("%s%s%s%sgazetteer",
+                                g_get_user_data_dir(),
+                                G_DIR_SEPARATOR_S,
+                                APP_NAME,
+                                G_DIR_SEPARATOR_S);
+  }
+
+  /* optional, location search goes to the network without it */
+  gazetteer_open(gazetteer);
+
+  g_free(gazetteer);
+
+  imagecache_init();
+
+  refresh_init();
+
+  /* the statistics take every stage lock and scan the fleet, so they are
+   * only gathered when somebody reads them */
+  guint statsid = (loglevel >= LXW_DEBUG)
+    ? g_timeout_add_seconds(STATS_LOG_INTERVAL, stats_log_timeout, NULL)
+    : 0;
+
   GList * list = fileutil_config_locations_load(config);
 
   LXW_LOG(LXW_DEBUG, "Size of configured list: %u", g_list_length(list));
@@ -406,7 +524,7 @@ main(int argc, char **argv)
   }
 
   /* Free location list from configuration */
-  g_list_free_full(list, location_free);
+  g_list_free_full(list, location_unref);
 
   list = NULL;
 
@@ -433,7 +551,8 @@ main(int argc, char **argv)
                           "location",
                           &location);
 
-    list = g_list_prepend(list, g_value_get_pointer(&location));
+    /* the widget keeps its location, a reference is enough */
+    list = g_list_prepend(list, location_ref(g_value_get_pointer(&location)));
 
     iter = g_list_next(iter);
   }
@@ -444,8 +563,7 @@ main(int argc, char **argv)
     fileutil_config_locations_save(list, config);
   }
 
-  /* The local list does NOT own the data in each entry, do not free_full */
-  g_list_free(list);
+  g_list_free_full(list, location_unref);
 
   list = NULL;
 
@@ -455,6 +573,30 @@ main(int argc, char **argv)
 
   g_free(config);
 
+  if (statsid) {
+    g_source_remove(statsid);
+  }
+
+  refresh_cleanup();
+
+  /* refreshes release their widget from an idle callback, and the last
+   * release finalizes it, so run what the pipeline left behind */
+  while (gtk_events_pending()) {
+    gtk_main_iteration();
+  }
+
+  fleet_cleanup();
+
+  imagecache_cleanup();
+
+  placeindex_cleanup();
+
+  locationcache_cleanup();
+
+  gazetteer_close();
+
+  provider_cleanup();
+
   yahooutil_cleanup();
 
   LXW_LOG(LXW_DEBUG, "Done.");
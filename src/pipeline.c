@@ -0,0 +1,381 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a chain of worker stages connected by bounded queues */
+
+#include "pipeline.h"
+#include "logutil.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+typedef struct _PipelineStage PipelineStage;
+
+struct _PipelineStage
+{
+  Pipeline        * pipeline_;
+  PipelineStage   * next_;
+  PipelineFunc      func_;
+  gpointer          data_;
+  pthread_t       * threads_;
+  guint             started_;
+
+  /* Everything below is protected by the mutex */
+  pthread_mutex_t   mutex_;
+  pthread_cond_t    ready_;   // an item was queued, or the stage is stopping
+  pthread_cond_t    room_;    // an item was taken, or the stage is stopping
+  GQueue            queue_;
+  gboolean          stopping_;
+  PipelineStageStats stats_;
+};
+
+struct _Pipeline
+{
+  GPtrArray      * stages_;
+  GDestroyNotify   item_free_;
+};
+
+/**
+ * Releases an item that leaves the pipeline without being consumed.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param item     Pointer to the item.
+ */
+static void
+item_release(Pipeline * pipeline, gpointer item)
+{
+  if (item && pipeline->item_free_) {
+    pipeline->item_free_(item);
+  }
+}
+
+/**
+ * Queues an item on a stage, waiting while the stage is full.
+ *
+ * @param stage Pointer to the stage.
+ * @param item  Pointer to the item.
+ *
+ * @return TRUE if the item was queued, FALSE if the stage is stopping,
+ *         in which case the item has been released.
+ */
+static gboolean
+stage_push(PipelineStage * stage, gpointer item)
+{
+  pthread_mutex_lock(&stage->mutex_);
+
+  /* backpressure: a full stage holds up the one feeding it */
+  while (!stage->stopping_ && stage->stats_.depth_ >= stage->stats_.capacity_) {
+    pthread_cond_wait(&stage->room_, &stage->mutex_);
+  }
+
+  gboolean queued = !stage->stopping_;
+
+  if (queued) {
+    g_queue_push_tail(&stage->queue_, item);
+
+    stage->stats_.depth_++;
+
+    stage->stats_.peak_ = MAX(stage->stats_.peak_, stage->stats_.depth_);
+
+    pthread_cond_signal(&stage->ready_);
+  }
+
+  pthread_mutex_unlock(&stage->mutex_);
+
+  if (!queued) {
+    item_release(stage->pipeline_, item);
+  }
+
+  return queued;
+}
+
+/**
+ * The stage worker thread function: takes items off the stage's queue,
+ * processes them and hands the results to the next stage.
+ *
+ * @param arg Pointer to the stage.
+ *
+ * @return NULL
+ */
+static void *
+stage_threadfunc(void * arg)
+{
+  PipelineStage * stage = (PipelineStage *)arg;
+
+  pthread_mutex_lock(&stage->mutex_);
+
+  while (TRUE) {
+    while (!stage->stopping_ && g_queue_is_empty(&stage->queue_)) {
+      pthread_cond_wait(&stage->ready_, &stage->mutex_);
+    }
+
+    if (stage->stopping_) {
+      break;
+    }
+
+    gpointer item = g_queue_pop_head(&stage->queue_);
+
+    stage->stats_.depth_--;
+
+    pthread_cond_signal(&stage->room_);
+
+    pthread_mutex_unlock(&stage->mutex_);
+
+    gint64 started = g_get_monotonic_time();
+
+    item = stage->func_(item, stage->data_);
+
+    gint64 finished = g_get_monotonic_time();
+
+    if (item) {
+      if (stage->next_) {
+        stage_push(stage->next_, item);
+      } else {
+        item_release(stage->pipeline_, item);
+      }
+    }
+
+    pthread_mutex_lock(&stage->mutex_);
+
+    stage->stats_.processed_++;
+    stage->stats_.service_ += (guint64)(finished - started);
+  }
+
+  pthread_mutex_unlock(&stage->mutex_);
+
+  return NULL;
+}
+
+/**
+ * Creates an empty pipeline.
+ *
+ * @param item_free Function releasing items that are still queued when the
+ *                  pipeline is freed, or returned by the last stage.
+ *
+ * @return The new pipeline, to be freed with pipeline_free().
+ */
+Pipeline *
+pipeline_new(GDestroyNotify item_free)
+{
+  Pipeline * pipeline = g_new0(Pipeline, 1);
+
+  pipeline->stages_    = g_ptr_array_new();
+  pipeline->item_free_ = item_free;
+
+  return pipeline;
+}
+
+/**
+ * Appends a stage to a pipeline that has not been started yet.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param name     Name of the stage, for statistics. Not copied.
+ * @param func     Function processing the items of the stage.
+ * @param data     Pointer to data passed to the function.
+ * @param workers  Number of threads serving the stage.
+ * @param capacity Number of items the stage queues before producers block.
+ */
+void
+pipeline_stage_add(Pipeline    * pipeline,
+                   const gchar * name,
+                   PipelineFunc  func,
+                   gpointer      data,
+                   guint         workers,
+                   guint         capacity)
+{
+  PipelineStage * stage = g_new0(PipelineStage, 1);
+
+  stage->pipeline_ = pipeline;
+  stage->func_     = func;
+  stage->data_     = data;
+  stage->threads_  = g_new0(pthread_t, MAX(workers, 1));
+
+  pthread_mutex_init(&stage->mutex_, NULL);
+  pthread_cond_init(&stage->ready_, NULL);
+  pthread_cond_init(&stage->room_, NULL);
+
+  g_queue_init(&stage->queue_);
+
+  stage->stats_.name_     = name;
+  stage->stats_.workers_  = MAX(workers, 1);
+  stage->stats_.capacity_ = MAX(capacity, 1);
+
+  if (pipeline->stages_->len) {
+    PipelineStage * last = g_ptr_array_index(pipeline->stages_,
+                                             pipeline->stages_->len - 1);
+
+    last->next_ = stage;
+  }
+
+  g_ptr_array_add(pipeline->stages_, stage);
+}
+
+/**
+ * Starts the workers of every stage.
+ *
+ * @param pipeline Pointer to the pipeline.
+ *
+ * @return 0 on success, -1 if a worker could not be started.
+ */
+gint
+pipeline_start(Pipeline * pipeline)
+{
+  guint index = 0;
+
+  for (; index < pipeline->stages_->len; ++index) {
+    PipelineStage * stage = g_ptr_array_index(pipeline->stages_, index);
+
+    for (; stage->started_ < stage->stats_.workers_; ++stage->started_) {
+      int ret = pthread_create(&stage->threads_[stage->started_],
+                               NULL,
+                               stage_threadfunc,
+                               stage);
+
+      if (ret) {
+        LXW_LOG(LXW_ERROR, "pipeline::start(%s): failed to start worker: %s",
+                stage->stats_.name_, strerror(ret));
+
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Queues an item on the first stage, waiting while that stage is full.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param item     Pointer to the item, owned by the pipeline from now on.
+ *
+ * @return TRUE if the item was queued, FALSE if the pipeline is stopping,
+ *         in which case the item has been released.
+ */
+gboolean
+pipeline_push(Pipeline * pipeline, gpointer item)
+{
+  if (!pipeline->stages_->len) {
+    item_release(pipeline, item);
+
+    return FALSE;
+  }
+
+  return stage_push(g_ptr_array_index(pipeline->stages_, 0), item);
+}
+
+/**
+ * Returns the number of stages in a pipeline.
+ *
+ * @param pipeline Pointer to the pipeline.
+ *
+ * @return The number of stages.
+ */
+guint
+pipeline_stage_count(Pipeline * pipeline)
+{
+  return pipeline->stages_->len;
+}
+
+/**
+ * Takes a snapshot of the statistics of a stage.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param index    Index of the stage.
+ * @param stats    Pointer to the structure to fill in.
+ */
+void
+pipeline_stage_stats(Pipeline * pipeline, guint index, PipelineStageStats * stats)
+{
+  g_return_if_fail(index < pipeline->stages_->len);
+
+  PipelineStage * stage = g_ptr_array_index(pipeline->stages_, index);
+
+  pthread_mutex_lock(&stage->mutex_);
+
+  *stats = stage->stats_;
+
+  pthread_mutex_unlock(&stage->mutex_);
+}
+
+/**
+ * Stops the workers, releases the items still queued and frees the
+ * pipeline. Items being processed are finished first.
+ *
+ * @param pipeline Pointer to the pipeline, may be NULL.
+ */
+void
+pipeline_free(Pipeline * pipeline)
+{
+  if (!pipeline) {
+    return;
+  }
+
+  guint index = 0;
+
+  /* stop every stage before joining any, so that no worker stays blocked
+   * handing an item to a stage that is already gone */
+  for (index = 0; index < pipeline->stages_->len; ++index) {
+    PipelineStage * stage = g_ptr_array_index(pipeline->stages_, index);
+
+    pthread_mutex_lock(&stage->mutex_);
+
+    stage->stopping_ = TRUE;
+
+    pthread_cond_broadcast(&stage->ready_);
+    pthread_cond_broadcast(&stage->room_);
+
+    pthread_mutex_unlock(&stage->mutex_);
+  }
+
+  for (index = 0; index < pipeline->stages_->len; ++index) {
+    PipelineStage * stage = g_ptr_array_index(pipeline->stages_, index);
+
+    guint thread = 0;
+
+    for (; thread < stage->started_; ++thread) {
+      pthread_join(stage->threads_[thread], NULL);
+    }
+  }
+
+  for (index = 0; index < pipeline->stages_->len; ++index) {
+    PipelineStage * stage = g_ptr_array_index(pipeline->stages_, index);
+
+    gpointer item = NULL;
+
+    while ((item = g_queue_pop_head(&stage->queue_)) != NULL) {
+      item_release(pipeline, item);
+    }
+
+    pthread_mutex_destroy(&stage->mutex_);
+    pthread_cond_destroy(&stage->ready_);
+    pthread_cond_destroy(&stage->room_);
+
+    g_free(stage->threads_);
+    g_free(stage);
+  }
+
+  g_ptr_array_free(pipeline->stages_, TRUE);
+
+  g_free(pipeline);
+}
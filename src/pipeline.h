@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a chain of worker stages connected by bounded queues */
+
+#ifndef LXWEATHER_PIPELINE_HEADER
+#define LXWEATHER_PIPELINE_HEADER
+
+#include <glib.h>
+
+typedef struct _Pipeline Pipeline;
+
+/**
+ * Processes one item in a stage.
+ *
+ * @param item Pointer to the item.
+ * @param data Pointer to the data supplied with the stage.
+ *
+ * @return The item to hand to the next stage, or NULL if the item was
+ *         consumed and goes no further.
+ */
+typedef gpointer (*PipelineFunc)(gpointer item, gpointer data);
+
+/* Snapshot of a stage, see pipeline_stage_stats() */
+typedef struct
+{
+  const gchar * name_;
+  guint         workers_;
+  guint         capacity_;
+  guint         depth_;      // items waiting now
+  guint         peak_;       // most items ever waiting
+  guint64       processed_;
+  guint64       service_;    // microseconds spent processing, in total
+} PipelineStageStats;
+
+/**
+ * Creates an empty pipeline.
+ *
+ * @param item_free Function releasing items that are still queued when the
+ *                  pipeline is freed, or returned by the last stage.
+ *
+ * @return The new pipeline, to be freed with pipeline_free().
+ */
+Pipeline *
+pipeline_new(GDestroyNotify item_free);
+
+/**
+ * Appends a stage to a pipeline that has not been started yet.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param name     Name of the stage, for statistics. Not copied.
+ * @param func     Function processing the items of the stage.
+ * @param data     Pointer to data passed to the function.
+ * @param workers  Number of threads serving the stage.
+ * @param capacity Number of items the stage queues before producers block.
+ */
+void
+pipeline_stage_add(Pipeline    * pipeline,
+                   const gchar * name,
+                   PipelineFunc  func,
+                   gpointer      data,
+                   guint         workers,
+                   guint         capacity);
+
+/**
+ * Starts the workers of every stage.
+ *
+ * @param pipeline Pointer to the pipeline.
+ *
+ * @return 0 on success, -1 if a worker could not be started.
+ */
+gint
+pipeline_start(Pipeline * pipeline);
+
+/**
+ * Queues an item on the first stage, waiting while that stage is full.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param item     Pointer to the item, owned by the pipeline from now on.
+ *
+ * @return TRUE if the item was queued, FALSE if the pipeline is stopping,
+ *         in which case the item has been released.
+ */
+gboolean
+pipeline_push(Pipeline * pipeline, gpointer item);
+
+/**
+ * Returns the number of stages in a pipeline.
+ *
+ * @param pipeline Pointer to the pipeline.
+ *
+ * @return The number of stages.
+ */
+guint
+pipeline_stage_count(Pipeline * pipeline);
+
+/**
+ * Takes a snapshot of the statistics of a stage.
+ *
+ * @param pipeline Pointer to the pipeline.
+ * @param index    Index of the stage.
+ * @param stats    Pointer to the structure to fill in.
+ */
+void
+pipeline_stage_stats(Pipeline * pipeline, guint index, PipelineStageStats * stats);
+
+/**
+ * Stops the workers, releases the items still queued and frees the
+ * pipeline. Items being processed are finished first.
+ *
+ * @param pipeline Pointer to the pipeline, may be NULL.
+ */
+void
+pipeline_free(Pipeline * pipeline);
+
+#endif
@@ -0,0 +1,582 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides typo-tolerant search over the locally known place names */
+
+#include "placeindex.h"
+#include "gazetteer.h"
+#include "location.h"
+#include "locationcache.h"
+#include "logutil.h"
+#include "textutil.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* Packs three characters into a trigram key */
+#define TRIGRAM(s) \
+  ((guint32)(guchar)(s)[0] << 16 | (guint32)(guchar)(s)[1] << 8 | (guchar)(s)[2])
+
+typedef struct
+{
+  const gchar  * key_;        // normalized name
+  LocationInfo * location_;   // owned reference, NULL for gazetteer places
+  guint          gazetteer_;  // index in the gazetteer if location_ is NULL
+} PlaceName;
+
+typedef struct
+{
+  guint32 id_;
+  guint   shared_;
+  guint   distance_;
+} PlaceCandidate;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static gboolean     g_built    = FALSE;
+static GArray     * g_names    = NULL;  // PlaceName
+static GHashTable * g_postings = NULL;  // trigram -> GArray of name ids
+static GHashTable * g_woeids   = NULL;  // WOEIDs of cached places
+
+/**
+ * Calls the function for every distinct trigram of the padded key.
+ *
+ * @param key  The normalized key.
+ * @param func Function to call with each trigram.
+ * @param data Pointer to user data passed to the function.
+ */
+static void
+trigrams_foreach(const gchar * key, void (*func)(guint32, gpointer), gpointer data)
+{
+  gchar padded[PLACEINDEX_MAX_KEY + 4];
+
+  /* words are padded so short names and word starts still match */
+  g_snprintf(padded, sizeof(padded), "  %s ", key);
+
+  gsize len = strlen(padded);
+
+  guint32 seen[PLACEINDEX_MAX_KEY + 2];
+  guint   seencnt = 0;
+
+  gsize i = 0;
+  for (; i + 3 <= len; ++i) {
+    guint32 trigram = TRIGRAM(padded + i);
+
+    guint s = 0;
+    while (s < seencnt && seen[s] != trigram) {
+      ++s;
+    }
+
+    if (s == seencnt) {
+      seen[seencnt++] = trigram;
+
+      func(trigram, data);
+    }
+  }
+}
+
+/**
+ * Adds the current name to the posting list of a trigram.
+ *
+ * @param trigram The trigram.
+ * @param data    Pointer to the id of the name.
+ */
+static void
+posting_add(guint32 trigram, gpointer data)
+{
+  guint32 id = *(guint32 *)data;
+
+  GArray * posting = g_hash_table_lookup(g_postings, GUINT_TO_POINTER(trigram));
+
+  if (!posting) {
+    posting = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    g_hash_table_insert(g_postings, GUINT_TO_POINTER(trigram), posting);
+  }
+
+  g_array_append_val(posting, id);
+}
+
+/**
+ * Adds a name to the index. Must be called with the mutex held.
+ *
+ * @param name The name to add, copied into the index.
+ */
+static void
+name_add(PlaceName * name)
+{
+  guint32 id = g_names->len;
+
+  g_array_append_val(g_names, *name);
+
+  trigrams_foreach(name->key_, posting_add, &id);
+}
+
+/**
+ * Adds one cached or searched place to the index, unless it is already
+ * there. Must be called with the mutex held.
+ *
+ * @param data Pointer to the LocationInfo entry, referenced by the index.
+ * @param user Unused.
+ */
+static void
+location_add(gpointer data, gpointer user G_GNUC_UNUSED)
+{
+  LocationInfo * location = (LocationInfo *)data;
+
+  if (!location || !location->woeid_ || !location->alias_ ||
+      g_hash_table_lookup(g_woeids, location->woeid_)) {
+    return;
+  }
+
+  gchar * key = textutil_query_normalize(location->alias_);
+
+  if (!*key) {
+    g_free(key);
+
+    return;
+  }
+
+  PlaceName name = { key, location_ref(location), 0 };
+
+  g_hash_table_insert(g_woeids, g_strdup(location->woeid_), GINT_TO_POINTER(1));
+
+  name_add(&name);
+}
+
+/**
+ * Builds the index from the gazetteer and the location cache. Must be
+ * called with the mutex held.
+ */
+static void
+index_build(void)
+{
+  g_names    = g_array_new(FALSE, FALSE, sizeof(PlaceName));
+  g_postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                     (GDestroyNotify)g_array_unref);
+  g_woeids   = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  guint count = gazetteer_size();
+
+  guint i = 0;
+  for (; i < count; ++i) {
+    PlaceName name = { gazetteer_key_get(i), NULL, i };
+
+    if (name.key_ && *name.key_) {
+      name_add(&name);
+    }
+  }
+
+  locationcache_foreach(location_add, NULL);
+
+  g_built = TRUE;
+
+  LXW_LOG(LXW_DEBUG, "placeindex::build(): %u names, %u trigrams",
+          g_names->len, g_hash_table_size(g_postings));
+}
+
+/**
+ * Computes the edit distance between two strings, giving up once it is
+ * known to exceed the bound.
+ *
+ * @param a     The first string.
+ * @param alen  The length of the first string, at most PLACEINDEX_MAX_KEY.
+ * @param b     The second string.
+ * @param blen  The length of the second string, at most PLACEINDEX_MAX_KEY.
+ * @param bound The largest distance of interest.
+ *
+ * @return The distance, or bound + 1 if it is larger than the bound.
+ */
+static guint
+distance_bounded(const gchar * a, gsize alen, const gchar * b, gsize blen, guint bound)
+{
+  if ((alen > blen ? alen - blen : blen - alen) > bound) {
+    return bound + 1;
+  }
+
+  guint rows[2][PLACEINDEX_MAX_KEY + 1];
+
+  guint * prev = rows[0];
+  guint * curr = rows[1];
+
+  gsize j = 0;
+  for (; j <= blen; ++j) {
+    prev[j] = j;
+  }
+
+  gsize i = 1;
+  for (; i <= alen; ++i) {
+    curr[0] = i;
+
+    guint rowmin = curr[0];
+
+    for (j = 1; j <= blen; ++j) {
+      guint cost = (a[i - 1] == b[j - 1]) ? 0 : 1;
+
+      guint best = prev[j - 1] + cost;
+
+      if (prev[j] + 1 < best) {
+        best = prev[j] + 1;
+      }
+
+      if (curr[j - 1] + 1 < best) {
+        best = curr[j - 1] + 1;
+      }
+
+      curr[j] = best;
+
+      if (best < rowmin) {
+        rowmin = best;
+      }
+    }
+
+    if (rowmin > bound) {
+      return bound + 1;
+    }
+
+    guint * swap = prev;
+    prev = curr;
+    curr = swap;
+  }
+
+  return (prev[blen] > bound) ? bound + 1 : prev[blen];
+}
+
+/**
+ * Computes the distance between the query and a name, comparing only as
+ * many words of the name as the query has, so "chicgo" is close to
+ * "chicago il".
+ *
+ * @param query The normalized query.
+ * @param key   The normalized name.
+ * @param bound The largest distance of interest.
+ *
+ * @return The distance, or bound + 1 if it is larger than the bound.
+ */
+static guint
+name_distance(const gchar * query, const gchar * key, guint bound)
+{
+  guint words = 1;
+
+  const gchar * curr = query;
+  for (; *curr; ++curr) {
+    words += (*curr == ' ');
+  }
+
+  gsize keylen = 0;
+  for (; key[keylen]; ++keylen) {
+    if (key[keylen] == ' ' && !--words) {
+      break;
+    }
+  }
+
+  return distance_bounded(query, MIN(strlen(query), PLACEINDEX_MAX_KEY),
+                          key, MIN(keylen, PLACEINDEX_MAX_KEY),
+                          bound);
+}
+
+/**
+ * Counts one shared trigram for every name on its posting list.
+ *
+ * @param trigram The trigram of the query.
+ * @param data    Pointer to the table of name id -> shared trigram count.
+ */
+static void
+posting_count(guint32 trigram, gpointer data)
+{
+  GHashTable * counts = (GHashTable *)data;
+
+  GArray * posting = g_hash_table_lookup(g_postings, GUINT_TO_POINTER(trigram));
+
+  guint i = 0;
+  for (; posting && i < posting->len; ++i) {
+    gpointer id = GUINT_TO_POINTER(g_array_index(posting, guint32, i));
+
+    guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, id));
+
+    g_hash_table_insert(counts, id, GUINT_TO_POINTER(count + 1));
+  }
+}
+
+/**
+ * Counts the trigrams of the query.
+ *
+ * @param trigram The trigram.
+ * @param data    Pointer to the count.
+ */
+static void
+trigram_count(guint32 trigram G_GNUC_UNUSED, gpointer data)
+{
+  ++*(guint *)data;
+}
+
+/**
+ * Orders candidates by shared trigrams, most first.
+ *
+ * @param a Pointer to the first candidate.
+ * @param b Pointer to the second candidate.
+ *
+ * @return Negative, zero or positive, as strcmp().
+ */
+static gint
+candidate_shared_compare(gconstpointer a, gconstpointer b)
+{
+  const PlaceCandidate * ca = (const PlaceCandidate *)a;
+  const PlaceCandidate * cb = (const PlaceCandidate *)b;
+
+  if (ca->shared_ != cb->shared_) {
+    return (ca->shared_ > cb->shared_) ? -1 : 1;
+  }
+
+  return (ca->id_ < cb->id_) ? -1 : (ca->id_ > cb->id_);
+}
+
+/**
+ * Orders candidates by edit distance, then by shared trigrams.
+ *
+ * @param a Pointer to the first candidate.
+ * @param b Pointer to the second candidate.
+ *
+ * @return Negative, zero or positive, as strcmp().
+ */
+static gint
+candidate_rank_compare(gconstpointer a, gconstpointer b)
+{
+  const PlaceCandidate * ca = (const PlaceCandidate *)a;
+  const PlaceCandidate * cb = (const PlaceCandidate *)b;
+
+  if (ca->distance_ != cb->distance_) {
+    return (ca->distance_ < cb->distance_) ? -1 : 1;
+  }
+
+  return candidate_shared_compare(a, b);
+}
+
+/**
+ * Drops the index and frees its memory. The index is built again from the
+ * location cache and the gazetteer on the next lookup. Must be called
+ * before the gazetteer is closed.
+ *
+ */
+void
+placeindex_cleanup(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_built) {
+    guint i = 0;
+    for (; i < g_names->len; ++i) {
+      PlaceName * name = &g_array_index(g_names, PlaceName, i);
+
+      /* gazetteer keys live in the mapped file */
+      if (name->location_) {
+        g_free((gchar *)name->key_);
+
+        location_unref(name->location_);
+      }
+    }
+
+    g_array_free(g_names, TRUE);
+    g_hash_table_destroy(g_postings);
+    g_hash_table_destroy(g_woeids);
+
+    g_names    = NULL;
+    g_postings = NULL;
+    g_woeids   = NULL;
+    g_built    = FALSE;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Adds search results to the index, if it has been built already.
+ *
+ * @param list List of LocationInfo entries, referenced by the index.
+ */
+void
+placeindex_add(GList * list)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  /* otherwise the build picks them up from the cache */
+  if (g_built) {
+    g_list_foreach(list, location_add, NULL);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Finds the places whose names are within a small edit distance of the
+ * query. Candidates are gathered through a trigram inverted index, then
+ * ranked by edit distance.
+ *
+ * @param query The string the user searched for.
+ * @param exact Pointer to set to whether a whole name matched the query
+ *              exactly, rather than only being close to it or starting
+ *              with it, may be NULL.
+ *
+ * @return A list of at most PLACEINDEX_MAX_RESULTS LocationInfo entries,
+ *         best first, or NULL if nothing is close enough. Caller is
+ *         responsible for freeing the list.
+ */
+GList *
+placeindex_find(const gchar * query, gboolean * exact)
+{
+  if (exact) {
+    *exact = FALSE;
+  }
+
+  if (!query) {
+    return NULL;
+  }
+
+  gchar * key = textutil_query_normalize(query);
+
+  gsize keylen = strlen(key);
+
+  if (!keylen || keylen > PLACEINDEX_MAX_KEY) {
+    g_free(key);
+
+    return NULL;
+  }
+
+  /* about one typo per three characters, at most three */
+  guint bound = CLAMP((keylen + 2) / 3, 1, 3);
+
+  GList * list = NULL;
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (!g_built) {
+    index_build();
+  }
+
+  guint trigrams = 0;
+
+  trigrams_foreach(key, trigram_count, &trigrams);
+
+  GHashTable * counts = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  trigrams_foreach(key, posting_count, counts);
+
+  /* a name within the bound still shares a good part of the trigrams */
+  guint minshared = (trigrams + 2) / 3;
+
+  GArray * candidates = g_array_new(FALSE, FALSE, sizeof(PlaceCandidate));
+
+  GHashTableIter iter;
+
+  gpointer id     = NULL;
+  gpointer shared = NULL;
+
+  g_hash_table_iter_init(&iter, counts);
+
+  while (g_hash_table_iter_next(&iter, &id, &shared)) {
+    if (GPOINTER_TO_UINT(shared) >= minshared) {
+      PlaceCandidate candidate = { GPOINTER_TO_UINT(id), GPOINTER_TO_UINT(shared), 0 };
+
+      g_array_append_val(candidates, candidate);
+    }
+  }
+
+  g_hash_table_destroy(counts);
+
+  g_array_sort(candidates, candidate_shared_compare);
+
+  if (candidates->len > PLACEINDEX_MAX_CANDIDATES) {
+    g_array_set_size(candidates, PLACEINDEX_MAX_CANDIDATES);
+  }
+
+  guint kept = 0;
+
+  guint i = 0;
+  for (; i < candidates->len; ++i) {
+    PlaceCandidate * candidate = &g_array_index(candidates, PlaceCandidate, i);
+
+    PlaceName * name = &g_array_index(g_names, PlaceName, candidate->id_);
+
+    candidate->distance_ = name_distance(key, name->key_, bound);
+
+    if (candidate->distance_ <= bound) {
+      g_array_index(candidates, PlaceCandidate, kept++) = *candidate;
+    }
+  }
+
+  g_array_set_size(candidates, kept);
+
+  g_array_sort(candidates, candidate_rank_compare);
+
+  GHashTable * woeids = g_hash_table_new(g_str_hash, g_str_equal);
+
+  guint found = 0;
+
+  for (i = 0; i < candidates->len && found < PLACEINDEX_MAX_RESULTS; ++i) {
+    PlaceCandidate * candidate = &g_array_index(candidates, PlaceCandidate, i);
+
+    PlaceName * name = &g_array_index(g_names, PlaceName, candidate->id_);
+
+    gpointer location = NULL;
+
+    if (name->location_) {
+      location = location_ref(name->location_);
+    } else {
+      location = gazetteer_location_get(name->gazetteer_);
+    }
+
+    LocationInfo * info = (LocationInfo *)location;
+
+    /* the same place may be both cached and in the gazetteer */
+    if (!info || g_hash_table_lookup(woeids, info->woeid_)) {
+      location_unref(location);
+
+      continue;
+    }
+
+    list = g_list_prepend(list, location);
+
+    g_hash_table_insert(woeids, info->woeid_, info);
+
+    /* a word prefix of a longer name, as "paris" of "paris tx", only
+     * suggests; the whole name must match */
+    if (exact && !strcmp(key, name->key_)) {
+      *exact = TRUE;
+    }
+
+    ++found;
+  }
+
+  g_hash_table_destroy(woeids);
+
+  g_array_free(candidates, TRUE);
+
+  pthread_mutex_unlock(&g_mutex);
+
+  LXW_LOG(LXW_DEBUG, "placeindex::find(%s): %u places within %u edits",
+          query, found, bound);
+
+  g_free(key);
+
+  return g_list_reverse(list);
+}
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides typo-tolerant search over the locally known place names */
+
+#ifndef LXWEATHER_PLACEINDEX_HEADER
+#define LXWEATHER_PLACEINDEX_HEADER
+
+#include <glib.h>
+
+/* Maximum number of places returned by one lookup */
+#define PLACEINDEX_MAX_RESULTS    10
+
+/* Number of best trigram matches checked with the edit distance */
+#define PLACEINDEX_MAX_CANDIDATES 200
+
+/* Longest name prefix compared with the edit distance */
+#define PLACEINDEX_MAX_KEY        64
+
+/**
+ * Drops the index and frees its memory. The index is built again from the
+ * location cache and the gazetteer on the next lookup. Must be called
+ * before the gazetteer is closed.
+ *
+ */
+void
+placeindex_cleanup(void);
+
+/**
+ * Adds search results to the index, if it has been built already.
+ *
+ * @param list List of LocationInfo entries, referenced by the index.
+ */
+void
+placeindex_add(GList * list);
+
+/**
+ * Finds the places whose names are within a small edit distance of the
+ * query. Candidates are gathered through a trigram inverted index, then
+ * ranked by edit distance.
+ *
+ * @param query The string the user searched for.
+ * @param exact Pointer to set to whether a whole name matched the query
+ *              exactly, rather than only being close to it or starting
+ *              with it, may be NULL.
+ *
+ * @return A list of at most PLACEINDEX_MAX_RESULTS LocationInfo entries,
+ *         best first, or NULL if nothing is close enough. Caller is
+ *         responsible for freeing the list.
+ */
+GList *
+placeindex_find(const gchar * query, gboolean * exact);
+
+#endif
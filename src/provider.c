@@ -0,0 +1,782 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the weather provider registry and the routing between providers */
+
+#include "provider.h"
+#include "arena.h"
+#include "yahooutil.h"
+#include "yqljson.h"
+#include "stubweather.h"
+#include "gazetteer.h"
+#include "locationcache.h"
+#include "placeindex.h"
+#include "location.h"
+#include "forecast.h"
+#include "logutil.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* Upper bound on the number of registered providers */
+#define PROVIDER_MAX 8
+
+/* Weight of the newest sample in the moving averages */
+#define PROVIDER_EWMA_WEIGHT 0.2
+
+/* Error rate past which a provider is only used when all others are worse */
+#define PROVIDER_UNHEALTHY 0.5
+
+/* How much the error rate inflates the latency when ranking providers */
+#define PROVIDER_ERROR_PENALTY 4.0
+
+/* Every this many requests the least recently used provider goes first, so
+ * that one which recovered is noticed */
+#define PROVIDER_PROBE_INTERVAL 16
+
+#define DIGEST_OFFSET_BASIS G_GUINT64_CONSTANT(14695981039346656037)
+#define DIGEST_PRIME        G_GUINT64_CONSTANT(1099511628211)
+
+typedef struct
+{
+  const WeatherProvider * provider_;
+  gdouble                 latency_;
+  gdouble                 errorRate_;
+  guint64                 requests_;
+  guint64                 failures_;
+  guint64                 lastUsed_;
+} ProviderEntry;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ProviderEntry g_providers[PROVIDER_MAX];
+
+static guint g_count = 0;
+
+/* Requests routed so far, orders the probes */
+static guint64 g_sequence = 0;
+
+/* Responses received, and how many of them matched the previous digest */
+static volatile gint g_forecast_fetched   = 0;
+static volatile gint g_forecast_unchanged = 0;
+
+/**
+ * Adds the bytes to a 64-bit FNV-1a digest.
+ *
+ * @param digest The digest so far.
+ * @param data   The bytes to add.
+ * @param len    The number of bytes.
+ *
+ * @return The updated digest.
+ */
+static guint64
+digest_update(guint64 digest, const gchar * data, gsize len)
+{
+  gsize i = 0;
+  for (; i < len; ++i) {
+    digest ^= (guchar)data[i];
+    digest *= DIGEST_PRIME;
+  }
+
+  return digest;
+}
+
+/**
+ * Computes the digest of a forecast response, leaving out the parts that
+ * change on every request. The location and units are part of the digest,
+ * so responses for different locations never match.
+ *
+ * @param provider The provider the response came from.
+ * @param woeid    WOEID string the response is for.
+ * @param units    Units character the response is in.
+ * @param response The response body.
+ * @param len      The length of the response body.
+ *
+ * @return The digest, never 0.
+ */
+static guint64
+response_digest(const WeatherProvider * provider,
+                const gchar           * woeid,
+                const gchar             units,
+                const gchar           * response,
+                gsize                   len)
+{
+  guint64 digest = DIGEST_OFFSET_BASIS;
+
+  digest = digest_update(digest, woeid, strlen(woeid) + 1);
+  digest = digest_update(digest, &units, 1);
+
+  const ProviderSpan * spans = provider->volatile_;
+
+  const gchar * curr = response;
+  const gchar * end  = response + len;
+  const gchar * run  = curr;
+
+  while (curr < end) {
+    guint s = 0;
+    for (; s < provider->volatileCount_; ++s) {
+      if (*curr == spans[s].start_[0] &&
+          (gsize)(end - curr) >= spans[s].startlen_ &&
+          !memcmp(curr, spans[s].start_, spans[s].startlen_)) {
+        break;
+      }
+    }
+
+    if (s < provider->volatileCount_) {
+      const gchar * from = curr + spans[s].startlen_;
+
+      const gchar * close = g_strstr_len(from, end - from, spans[s].end_);
+
+      if (close) {
+        digest = digest_update(digest, run, curr - run);
+
+        curr = run = close + spans[s].endlen_;
+
+        continue;
+      }
+    }
+
+    ++curr;
+  }
+
+  digest = digest_update(digest, run, end - run);
+
+  /* 0 is reserved for 'no digest' */
+  return (digest) ? digest : 1;
+}
+
+/**
+ * Tells whether the first entry should be tried before the second. Untried
+ * providers go first, then healthy before unhealthy ones, then by latency
+ * inflated by the error rate.
+ *
+ * @param a Pointer to the first entry.
+ * @param b Pointer to the second entry.
+ *
+ * @return TRUE if a ranks before b, FALSE otherwise.
+ */
+static gboolean
+entry_ranks_before(const ProviderEntry * a, const ProviderEntry * b)
+{
+  if (!a->requests_ || !b->requests_) {
+    return (!a->requests_ && b->requests_);
+  }
+
+  gboolean ahealthy = (a->errorRate_ <= PROVIDER_UNHEALTHY);
+  gboolean bhealthy = (b->errorRate_ <= PROVIDER_UNHEALTHY);
+
+  if (ahealthy != bhealthy) {
+    return ahealthy;
+  }
+
+  return (a->latency_ * (1.0 + PROVIDER_ERROR_PENALTY * a->errorRate_) <
+          b->latency_ * (1.0 + PROVIDER_ERROR_PENALTY * b->errorRate_));
+}
+
+/**
+ * Ranks the providers for one request.
+ *
+ * @param order     Array of PROVIDER_MAX entries receiving the indices of
+ *                  the providers, best first.
+ * @param providers Array of PROVIDER_MAX entries receiving the providers,
+ *                  in the same order.
+ *
+ * @return The number of providers.
+ */
+static guint
+providers_rank(guint * order, const WeatherProvider ** providers)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  guint count = g_count;
+
+  guint index = 0;
+
+  /* insertion sort, there are only a handful */
+  for (; index < count; ++index) {
+    guint slot = index;
+
+    while (slot && entry_ranks_before(&g_providers[index], &g_providers[order[slot - 1]])) {
+      order[slot] = order[slot - 1];
+
+      --slot;
+    }
+
+    order[slot] = index;
+  }
+
+  if (count > 1 && !(++g_sequence % PROVIDER_PROBE_INTERVAL)) {
+    guint probe = count - 1;
+
+    for (index = count - 1; index-- > 0;) {
+      if (g_providers[order[index]].lastUsed_ < g_providers[order[probe]].lastUsed_) {
+        probe = index;
+      }
+    }
+
+    guint chosen = order[probe];
+
+    memmove(order + 1, order, probe * sizeof(*order));
+
+    order[0] = chosen;
+  }
+
+  for (index = 0; index < count; ++index) {
+    providers[index] = g_providers[order[index]].provider_;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  return count;
+}
+
+/**
+ * Records the outcome of a request to a provider.
+ *
+ * @param index   Index of the provider.
+ * @param latency Time the request took in microseconds, negative if it
+ *                should not count towards the latency.
+ * @param success Whether the request succeeded.
+ */
+static void
+provider_report(guint index, gint64 latency, gboolean success)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (index < g_count) {
+    ProviderEntry * entry = &g_providers[index];
+
+    if (latency >= 0) {
+      entry->latency_ = (entry->requests_) ?
+        entry->latency_ + PROVIDER_EWMA_WEIGHT * (latency - entry->latency_) :
+        (gdouble)latency;
+    }
+
+    entry->errorRate_ += PROVIDER_EWMA_WEIGHT * (((success) ? 0.0 : 1.0) - entry->errorRate_);
+
+    entry->requests_++;
+
+    if (!success) {
+      entry->failures_++;
+    }
+
+    entry->lastUsed_ = g_sequence;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Finds the index of a registered provider.
+ *
+ * @param provider Pointer to the provider.
+ *
+ * @return The index, or PROVIDER_MAX if it is not registered.
+ */
+static guint
+provider_index(const WeatherProvider * provider)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  guint index = 0;
+
+  while (index < g_count && g_providers[index].provider_ != provider) {
+    ++index;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+
+  return (index < g_count) ? index : PROVIDER_MAX;
+}
+
+/**
+ * Registers the built-in providers.
+ *
+ */
+void
+provider_init(void)
+{
+  provider_register(yahooutil_provider());
+
+  provider_register(yqljson_provider());
+
+  /* only there when asked for, it would always be the fastest */
+  const WeatherProvider * stub = stubweather_provider();
+
+  if (stub) {
+    provider_register(stub);
+  }
+}
+
+/**
+ * Forgets all providers.
+ *
+ */
+void
+provider_cleanup(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  memset(g_providers, 0, sizeof(g_providers));
+
+  g_count = 0;
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Adds a provider to the ones requests are routed to.
+ *
+ * @param provider Pointer to the provider, which must stay valid until
+ *                 provider_cleanup().
+ */
+void
+provider_register(const WeatherProvider * provider)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (g_count < PROVIDER_MAX) {
+    ProviderEntry * entry = &g_providers[g_count++];
+
+    memset(entry, 0, sizeof(*entry));
+
+    entry->provider_ = provider;
+
+    LXW_LOG(LXW_DEBUG, "provider::register(%s)", provider->name_);
+  } else {
+    LXW_LOG(LXW_ERROR, "provider::register(%s): Too many providers", provider->name_);
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Appends the locations of one list that are not in another yet.
+ *
+ * @param list Pointer to the list to append to.
+ * @param more Pointer to the list to take the locations from. Ownership is
+ *             taken, the locations already listed are released.
+ *
+ * @return The combined list.
+ */
+static GList *
+location_list_merge(GList * list, GList * more)
+{
+  GList * iter = more;
+
+  for (; iter; iter = iter->next) {
+    LocationInfo * location = (LocationInfo *)iter->data;
+
+    GList * known = list;
+
+    while (known &&
+           g_strcmp0(((LocationInfo *)known->data)->woeid_, location->woeid_)) {
+      known = known->next;
+    }
+
+    if (known) {
+      location_unref(location);
+    } else {
+      list = g_list_append(list, location);
+    }
+  }
+
+  g_list_free(more);
+
+  return list;
+}
+
+/**
+ * Looks up the specified location in the local sources only: the offline
+ * gazetteer, the result cache and the fuzzy place index. The sources are
+ * asked in turn until one knows the query exactly; the names that only
+ * start with it or are close to it are suggestions. Cheap enough to run
+ * on every keystroke.
+ *
+ * @param location The string containing the name/code of the location
+ * @param exact    Pointer to set to whether a source knew the query exactly,
+ *                 may be NULL.
+ *
+ * @return A pointer to a list of LocationInfo entries, NULL if nothing local
+ *         matched. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find_local(const gchar * location, gboolean * exact)
+{
+  gboolean hit = FALSE;
+
+  /* the offline gazetteer answers without a round trip, if installed */
+  GList * list = gazetteer_find(location, &hit);
+
+  if (!hit) {
+    /* the answer to an earlier search for the same query */
+    GList * cached = locationcache_lookup(location);
+
+    hit = (cached != NULL);
+
+    list = (hit) ? location_list_merge(cached, list) : list;
+  }
+
+  if (!hit) {
+    /* close matches, for queries with a typo in them */
+    list = location_list_merge(list, placeindex_find(location, &hit));
+  }
+
+  if (exact) {
+    *exact = hit;
+  }
+
+  return list;
+}
+
+/**
+ * Retrieves the details for the specified location from the best provider,
+ * unless an earlier lookup of the same query is still cached. Successful
+ * results are added to the cache and to the place index.
+ *
+ * @param location The string containing the name/code of the location
+ *
+ * @return A pointer to a list of LocationInfo entries, possibly empty, 
+ *         if no details were found. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find_remote(const gchar * location)
+{
+  GList * list = locationcache_lookup(location);
+
+  if (list) {
+    /* place data does not change, no need to ask again */
+    return list;
+  }
+
+  guint order[PROVIDER_MAX];
+
+  const WeatherProvider * providers[PROVIDER_MAX];
+
+  guint count = providers_rank(order, providers);
+
+  guint index = 0;
+
+  for (; index < count; ++index) {
+    gint64 start = g_get_monotonic_time();
+
+    gint ret = providers[index]->location_find_(location, &list);
+
+    provider_report(order[index], g_get_monotonic_time() - start, !ret);
+
+    LXW_LOG(LXW_DEBUG, "provider::location_find_remote(%s): %s returned %d",
+            location, providers[index]->name_, ret);
+
+    if (!ret) {
+      locationcache_store(location, list);
+
+      placeindex_add(list);
+
+      break;
+    }
+
+    g_list_free_full(list, location_unref);
+
+    list = NULL;
+  }
+
+  return list;
+}
+
+/**
+ * Retrieves the details for the specified location, locally if a local
+ * source knows it exactly. Otherwise the network is asked, and the local
+ * suggestions follow its results.
+ *
+ * @param location The string containing the name/code of the location
+ *
+ * @return A pointer to a list of LocationInfo entries, possibly empty, 
+ *         if no details were found. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find(const gchar * location)
+{
+  gboolean exact = FALSE;
+
+  GList * local = provider_location_find_local(location, &exact);
+
+  if (exact) {
+    return local;
+  }
+
+  /* a close name may be a typo, or a real place the network knows */
+  return location_list_merge(provider_location_find_remote(location), local);
+}
+
+/**
+ * Retrieves the raw forecast response from the best provider, falling back
+ * to the others in order if it fails.
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param length   Pointer to the length of the response, set on success.
+ * @param provider Pointer to the provider that answered, set on success.
+ *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
+ */
+gchar *
+provider_forecast_fetch(const gchar             * woeid,
+                        const gchar               units,
+                        gint                    * length,
+                        const WeatherProvider  ** provider)
+{
+  guint order[PROVIDER_MAX];
+
+  const WeatherProvider * providers[PROVIDER_MAX];
+
+  guint count = providers_rank(order, providers);
+
+  guint index = 0;
+
+  for (; index < count; ++index) {
+    gint64 start = g_get_monotonic_time();
+
+    gchar * response = providers[index]->forecast_fetch_(woeid, units, length);
+
+    provider_report(order[index], g_get_monotonic_time() - start, (response != NULL));
+
+    if (response) {
+      *provider = providers[index];
+
+      return response;
+    }
+
+    LXW_LOG(LXW_DEBUG, "provider::forecast_fetch(%s): %s failed",
+            woeid, providers[index]->name_);
+  }
+
+  LXW_LOG(LXW_ERROR, "provider::forecast_fetch(%s): No provider answered", woeid);
+
+  return NULL;
+}
+
+/**
+ * Parses a forecast response retrieved with provider_forecast_fetch(),
+ * unless it matches the digest of the previous one. A response that does
+ * not parse counts against the provider.
+ *
+ * @param provider The provider that answered.
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param response The response to parse.
+ * @param length   The length of the response.
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ * @param digest   Pointer to the digest of the last response for this
+ *                 location, 0 to force parsing. Updated on return.
+ *
+ * @return PROVIDER_FORECAST_UPDATED if the forecast was filled in,
+ *         PROVIDER_FORECAST_UNCHANGED if the response matched the digest and
+ *         was not parsed, PROVIDER_FORECAST_FAILED otherwise.
+ */
+gint
+provider_forecast_parse(const WeatherProvider * provider,
+                        const gchar           * woeid,
+                        const gchar             units,
+                        const gchar           * response,
+                        gint                    length,
+                        gpointer              * forecast,
+                        guint64               * digest)
+{
+  gint status = PROVIDER_FORECAST_FAILED;
+
+  guint64 current = response_digest(provider, woeid, units, response, length);
+
+  g_atomic_int_inc(&g_forecast_fetched);
+
+  if (digest && *digest == current) {
+    g_atomic_int_inc(&g_forecast_unchanged);
+
+    status = PROVIDER_FORECAST_UNCHANGED;
+  } else {
+    gint ret = provider->forecast_parse_(response, length, forecast);
+    
+    LXW_LOG(LXW_DEBUG,
+            "provider::forecast_parse(%s): %s parsing returned %d",
+            woeid, provider->name_, ret);
+
+    if (ret) {
+      forecast_unref(*forecast);
+
+      *forecast = NULL;
+
+      /* a response that does not parse is as bad as none at all */
+      provider_report(provider_index(provider), -1, FALSE);
+    } else {
+      status = PROVIDER_FORECAST_UPDATED;
+
+      if (digest) {
+        *digest = current;
+      }
+    }
+  }
+
+  LXW_LOG(LXW_DEBUG,
+          "provider::forecast_parse(%s): %d of %d responses unchanged",
+          woeid,
+          g_atomic_int_get(&g_forecast_unchanged),
+          g_atomic_int_get(&g_forecast_fetched));
+
+  return status;
+}
+
+/**
+ * Retrieves the forecast for the specified location WOEID
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ * @param digest   Pointer to the digest of the last response for this
+ *                 location, 0 to force parsing. Updated on return.
+ *
+ * @return PROVIDER_FORECAST_UPDATED if the forecast was filled in,
+ *         PROVIDER_FORECAST_UNCHANGED if the response matched the digest and
+ *         was not parsed, PROVIDER_FORECAST_FAILED otherwise.
+ */
+gint
+provider_forecast_get(const gchar * woeid,
+                      const gchar   units,
+                      gpointer    * forecast,
+                      guint64     * digest)
+{
+  gint length = 0;
+
+  const WeatherProvider * provider = NULL;
+
+  gchar * response = provider_forecast_fetch(woeid, units, &length, &provider);
+
+  if (!response) {
+    return PROVIDER_FORECAST_FAILED;
+  }
+
+  gint status = provider_forecast_parse(provider, woeid, units, response, length,
+                                        forecast, digest);
+
+  arena_free(response);
+
+  return status;
+}
+
+/**
+ * Reports how many forecast responses were skipped as unchanged.
+ *
+ * @param fetched   Pointer to the number of responses received, may be NULL.
+ * @param unchanged Pointer to the number of those that were skipped,
+ *                  may be NULL.
+ */
+void
+provider_forecast_stats(guint * fetched, guint * unchanged)
+{
+  if (fetched) {
+    *fetched = (guint)g_atomic_int_get(&g_forecast_fetched);
+  }
+
+  if (unchanged) {
+    *unchanged = (guint)g_atomic_int_get(&g_forecast_unchanged);
+  }
+}
+
+/**
+ * Returns the number of registered providers.
+ *
+ * @return The number of providers.
+ */
+guint
+provider_count(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  guint count = g_count;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  return count;
+}
+
+/**
+ * Takes a snapshot of one provider's health.
+ *
+ * @param index Index of the provider, in registration order.
+ * @param stats Pointer to the snapshot to fill in.
+ */
+void
+provider_stats(guint index, ProviderStats * stats)
+{
+  memset(stats, 0, sizeof(*stats));
+
+  pthread_mutex_lock(&g_mutex);
+
+  if (index < g_count) {
+    ProviderEntry * entry = &g_providers[index];
+
+    stats->name_      = entry->provider_->name_;
+    stats->latency_   = entry->latency_;
+    stats->errorRate_ = entry->errorRate_;
+    stats->requests_  = entry->requests_;
+    stats->failures_  = entry->failures_;
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Logs the health of every provider, and how many forecast responses were
+ * skipped as unchanged.
+ *
+ */
+void
+provider_stats_log(void)
+{
+  guint fetched   = 0;
+  guint unchanged = 0;
+
+  provider_forecast_stats(&fetched, &unchanged);
+
+  LXW_LOG(LXW_DEBUG,
+          "provider: %u of %u forecast responses unchanged (%.0f%%)",
+          unchanged, fetched,
+          (fetched) ? 100.0 * unchanged / fetched : 0.0);
+
+  guint index = 0;
+
+  for (; index < provider_count(); ++index) {
+    ProviderStats stats;
+
+    provider_stats(index, &stats);
+
+    LXW_LOG(LXW_DEBUG,
+            "provider::%s: %.0fus average, %.0f%% errors, "
+            "%" G_GUINT64_FORMAT " requests, %" G_GUINT64_FORMAT " failed",
+            stats.name_, stats.latency_, stats.errorRate_ * 100.0,
+            stats.requests_, stats.failures_);
+  }
+}
@@ -0,0 +1,269 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the weather provider interface and the routing between providers */
+
+#ifndef LXWEATHER_PROVIDER_HEADER
+#define LXWEATHER_PROVIDER_HEADER
+
+#include <glib.h>
+
+/* Outcome of a forecast retrieval */
+enum
+{
+  PROVIDER_FORECAST_FAILED    = -1,
+  PROVIDER_FORECAST_UPDATED   = 0,
+  PROVIDER_FORECAST_UNCHANGED = 1
+};
+
+/* Part of a response that differs on every request, left out of the digest */
+typedef struct
+{
+  const gchar * start_;
+  gsize         startlen_;
+  const gchar * end_;
+  gsize         endlen_;
+} ProviderSpan;
+
+#define PROVIDER_SPAN(s, e) { s, sizeof(s) - 1, e, sizeof(e) - 1 }
+
+/* One weather service. Locations are identified by WOEID throughout, so a
+ * location found through one provider can be refreshed through any other. */
+typedef struct
+{
+  const gchar * name_;
+
+  /**
+   * Retrieves the locations matching a query from the service.
+   *
+   * @param location The string containing the name/code of the location
+   * @param list     Pointer to the list to fill with LocationInfo entries.
+   *
+   * @return 0 on success, even if nothing matched, -1 on failure.
+   */
+  gint (*location_find_)(const gchar * location, GList ** list);
+
+  /**
+   * Retrieves the raw forecast response for a location.
+   *
+   * @param woeid  The string containing the WOEID of the location
+   * @param units  The character containing the units for the forecast (c|f)
+   * @param length Pointer to the length of the response, set on success.
+   *
+   * @return The response, to be freed with arena_free(), or NULL on
+   *         failure.
+   */
+  gchar * (*forecast_fetch_)(const gchar * woeid, const gchar units, gint * length);
+
+  /**
+   * Parses a response retrieved with forecast_fetch_.
+   *
+   * @param response The response, NUL-terminated.
+   * @param length   The length of the response.
+   * @param forecast The pointer to the previous forecast, or to NULL. On
+   *                 success it is replaced by the new forecast, parsed over
+   *                 the previous one.
+   *
+   * @return 0 on success, -1 on failure.
+   */
+  gint (*forecast_parse_)(const gchar * response, gint length, gpointer * forecast);
+
+  /* parts of the responses to leave out of the digest */
+  const ProviderSpan * volatile_;
+  guint                volatileCount_;
+} WeatherProvider;
+
+/* Snapshot of a provider's health, see provider_stats() */
+typedef struct
+{
+  const gchar * name_;
+  gdouble       latency_;    // moving average, microseconds
+  gdouble       errorRate_;  // moving average, 0 to 1
+  guint64       requests_;
+  guint64       failures_;
+} ProviderStats;
+
+/**
+ * Registers the built-in providers.
+ *
+ */
+void
+provider_init(void);
+
+/**
+ * Forgets all providers.
+ *
+ */
+void
+provider_cleanup(void);
+
+/**
+ * Adds a provider to the ones requests are routed to.
+ *
+ * @param provider Pointer to the provider, which must stay valid until
+ *                 provider_cleanup().
+ */
+void
+provider_register(const WeatherProvider * provider);
+
+/**
+ * Looks up the specified location in the local sources only: the offline
+ * gazetteer, the result cache and the fuzzy place index. The sources are
+ * asked in turn until one knows the query exactly; the names that only
+ * start with it or are close to it are suggestions.
+ *
+ * @param location The string containing the name/code of the location
+ * @param exact    Pointer to set to whether a source knew the query exactly,
+ *                 may be NULL.
+ *
+ * @return A pointer to a list of LocationInfo entries, NULL if nothing local
+ *         matched. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find_local(const gchar * location, gboolean * exact);
+
+/**
+ * Retrieves the details for the specified location from the best provider,
+ * unless an earlier lookup of the same query is still cached.
+ *
+ * @param location The string containing the name/code of the location
+ *
+ * @return A pointer to a list of LocationInfo entries, possibly empty, 
+ *         if no details were found. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find_remote(const gchar * location);
+
+/**
+ * Retrieves the details for the specified location, locally if a local
+ * source knows it exactly. Otherwise the network is asked, and the local
+ * suggestions follow its results.
+ *
+ * @param location The string containing the name/code of the location
+ *
+ * @return A pointer to a list of LocationInfo entries, possibly empty, 
+ *         if no details were found. Caller is responsible for freeing the list.
+ */
+GList *
+provider_location_find(const gchar * location);
+
+/**
+ * Retrieves the raw forecast response from the best provider, falling back
+ * to the others in order if it fails.
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param length   Pointer to the length of the response, set on success.
+ * @param provider Pointer to the provider that answered, set on success.
+ *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
+ */
+gchar *
+provider_forecast_fetch(const gchar             * woeid,
+                        const gchar               units,
+                        gint                    * length,
+                        const WeatherProvider  ** provider);
+
+/**
+ * Parses a forecast response retrieved with provider_forecast_fetch(),
+ * unless it matches the digest of the previous one.
+ *
+ * @param provider The provider that answered.
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param response The response to parse.
+ * @param length   The length of the response.
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ * @param digest   Pointer to the digest of the last response for this
+ *                 location, 0 to force parsing. Updated on return.
+ *
+ * @return PROVIDER_FORECAST_UPDATED if the forecast was filled in,
+ *         PROVIDER_FORECAST_UNCHANGED if the response matched the digest and
+ *         was not parsed, PROVIDER_FORECAST_FAILED otherwise.
+ */
+gint
+provider_forecast_parse(const WeatherProvider * provider,
+                        const gchar           * woeid,
+                        const gchar             units,
+                        const gchar           * response,
+                        gint                    length,
+                        gpointer              * forecast,
+                        guint64               * digest);
+
+/**
+ * Retrieves the forecast for the specified location WOEID
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ * @param digest   Pointer to the digest of the last response for this
+ *                 location, 0 to force parsing. Updated on return.
+ *
+ * @return PROVIDER_FORECAST_UPDATED if the forecast was filled in,
+ *         PROVIDER_FORECAST_UNCHANGED if the response matched the digest and
+ *         was not parsed, PROVIDER_FORECAST_FAILED otherwise.
+ */
+gint
+provider_forecast_get(const gchar * woeid,
+                      const gchar   units,
+                      gpointer    * forecast,
+                      guint64     * digest);
+
+/**
+ * Reports how many forecast responses were skipped as unchanged.
+ *
+ * @param fetched   Pointer to the number of responses received, may be NULL.
+ * @param unchanged Pointer to the number of those that were skipped,
+ *                  may be NULL.
+ */
+void
+provider_forecast_stats(guint * fetched, guint * unchanged);
+
+/**
+ * Returns the number of registered providers.
+ *
+ * @return The number of providers.
+ */
+guint
+provider_count(void);
+
+/**
+ * Takes a snapshot of one provider's health.
+ *
+ * @param index Index of the provider, in registration order.
+ * @param stats Pointer to the snapshot to fill in.
+ */
+void
+provider_stats(guint index, ProviderStats * stats);
+
+/**
+ * Logs the health of every provider, and how many forecast responses were
+ * skipped as unchanged.
+ *
+ */
+void
+provider_stats_log(void);
+
+#endif
@@ -0,0 +1,392 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the staged forecast refresh: fetch, parse, image and publish */
+
+#include "refresh.h"
+#include "arena.h"
+#include "fleet.h"
+#include "pipeline.h"
+#include "provider.h"
+#include "imagecache.h"
+#include "forecast.h"
+#include "logutil.h"
+#include "slabpool.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+/* Workers and queue capacity of each stage. Network reads get the most
+ * workers, so that a slow server does not stall the stages behind it.
+ * Parsing gets one worker per processor, up to a limit. */
+#define REFRESH_FETCH_WORKERS    4
+#define REFRESH_FETCH_CAPACITY   16
+#define REFRESH_PARSE_WORKERS    8
+#define REFRESH_PARSE_CAPACITY   8
+#define REFRESH_IMAGE_WORKERS    2
+#define REFRESH_IMAGE_CAPACITY   8
+#define REFRESH_PUBLISH_WORKERS  1
+#define REFRESH_PUBLISH_CAPACITY 8
+
+typedef struct
+{
+  gchar                 * woeid_;
+  gchar                   units_;
+  guint64                 digest_;
+  const WeatherProvider * provider_;   // the one that answered the fetch
+  gchar                 * response_;   // from arena_
+  gint                    length_;
+  gpointer                forecast_;   // parsed over, then the new one
+  RefreshCallback         callback_;
+  gpointer                data_;
+  GDestroyNotify          destroy_;
+  Arena                   arena_;      // temporaries of the fetch and parse
+} RefreshJob;
+
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static Pipeline * g_pipeline = NULL;
+
+static SlabPool g_pool = SLABPOOL_INIT("refresh-job", sizeof(RefreshJob));
+
+/**
+ * Releases a refresh job and everything it holds.
+ *
+ * @param data Pointer to the job.
+ */
+static void
+job_free(gpointer data)
+{
+  RefreshJob * job = (RefreshJob *)data;
+
+  if (job->destroy_) {
+    job->destroy_(job->data_);
+  }
+
+  forecast_unref(job->forecast_);
+
+  arena_free(job->response_);
+  arena_reset(&job->arena_);
+
+  g_free(job->woeid_);
+
+  slabpool_free(&g_pool, job);
+}
+
+/**
+ * The fetch stage: retrieves the response from the best provider.
+ *
+ * @param item Pointer to the job.
+ * @param data Unused.
+ *
+ * @return The job, or NULL if the retrieval failed.
+ */
+static gpointer
+fetch_stage(gpointer item, gpointer data G_GNUC_UNUSED)
+{
+  RefreshJob * job = (RefreshJob *)item;
+
+  Arena * arena = arena_enter(&job->arena_);
+
+  job->response_ = provider_forecast_fetch(job->woeid_,
+                                           job->units_,
+                                           &job->length_,
+                                           &job->provider_);
+
+  arena_leave(arena);
+
+  if (!job->response_) {
+    fleet_update(job->woeid_, NULL, TRUE);
+
+    job_free(job);
+
+    return NULL;
+  }
+
+  return job;
+}
+
+/**
+ * The parse stage: turns the response into a forecast, unless it did not
+ * change since the last one.
+ *
+ * @param item Pointer to the job.
+ * @param data Unused.
+ *
+ * @return The job, or NULL if there is nothing new to publish.
+ */
+static gpointer
+parse_stage(gpointer item, gpointer data G_GNUC_UNUSED)
+{
+  RefreshJob * job = (RefreshJob *)item;
+
+  Arena * arena = arena_enter(&job->arena_);
+
+  gint status = provider_forecast_parse(job->provider_,
+                                        job->woeid_,
+                                        job->units_,
+                                        job->response_,
+                                        job->length_,
+                                        &job->forecast_,
+                                        &job->digest_);
+
+  arena_leave(arena);
+
+  /* the response, the document and everything else of the parse go at once */
+  arena_free(job->response_);
+  arena_reset(&job->arena_);
+
+  job->response_ = NULL;
+
+  if (status != PROVIDER_FORECAST_UPDATED) {
+    fleet_update(job->woeid_, NULL, status == PROVIDER_FORECAST_FAILED);
+
+    LXW_LOG(LXW_DEBUG, "refresh::parse_stage(%s): nothing to publish (%d)",
+            job->woeid_, status);
+
+    job_free(job);
+
+    return NULL;
+  }
+
+  return job;
+}
+
+/**
+ * The image stage: attaches the condition image, retrieving and decoding
+ * it if it is not cached yet. If that fails, the forecast is published
+ * without it and with a digest of 0, so that the next refresh parses the
+ * response again and retries the image.
+ *
+ * @param item Pointer to the job.
+ * @param data Unused.
+ *
+ * @return The job.
+ */
+static gpointer
+image_stage(gpointer item, gpointer data G_GNUC_UNUSED)
+{
+  RefreshJob   * job      = (RefreshJob *)item;
+  ForecastInfo * forecast = (ForecastInfo *)job->forecast_;
+
+  if (forecast->imageURL_ && !forecast->image_) {
+    forecast->image_ = imagecache_fetch(forecast->imageURL_);
+
+    /* not published yet, so the change can still be recorded */
+    if (forecast->image_) {
+      forecast->changed_ |= FORECAST_CHANGED_IMAGE;
+    } else {
+      job->digest_ = 0;
+    }
+  }
+
+  return job;
+}
+
+/**
+ * The publish stage: hands the forecast to the requester.
+ *
+ * @param item Pointer to the job.
+ * @param data Unused.
+ *
+ * @return NULL, the job is done.
+ */
+static gpointer
+publish_stage(gpointer item, gpointer data G_GNUC_UNUSED)
+{
+  RefreshJob * job = (RefreshJob *)item;
+
+  fleet_update(job->woeid_, job->forecast_, FALSE);
+
+  job->callback_(job->woeid_, job->forecast_, job->digest_, job->data_);
+
+  job_free(job);
+
+  return NULL;
+}
+
+/**
+ * Returns the number of parse workers: one per online processor, at least
+ * one and at most REFRESH_PARSE_WORKERS.
+ *
+ * @return The number of workers.
+ */
+static guint
+parse_workers(void)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return (guint)CLAMP(cpus, 1, REFRESH_PARSE_WORKERS);
+}
+
+/**
+ * Starts the refresh pipeline.
+ *
+ */
+void
+refresh_init(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (!g_pipeline) {
+    g_pipeline = pipeline_new(job_free);
+
+    pipeline_stage_add(g_pipeline, "fetch", fetch_stage, NULL,
+                       REFRESH_FETCH_WORKERS, REFRESH_FETCH_CAPACITY);
+
+    pipeline_stage_add(g_pipeline, "parse", parse_stage, NULL,
+                       parse_workers(), REFRESH_PARSE_CAPACITY);
+
+    pipeline_stage_add(g_pipeline, "image", image_stage, NULL,
+                       REFRESH_IMAGE_WORKERS, REFRESH_IMAGE_CAPACITY);
+
+    pipeline_stage_add(g_pipeline, "publish", publish_stage, NULL,
+                       REFRESH_PUBLISH_WORKERS, REFRESH_PUBLISH_CAPACITY);
+
+    if (pipeline_start(g_pipeline)) {
+      LXW_LOG(LXW_ERROR, "refresh::init(): pipeline did not fully start");
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Stops the refresh pipeline, dropping refreshes still queued.
+ *
+ */
+void
+refresh_cleanup(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  Pipeline * pipeline = g_pipeline;
+
+  g_pipeline = NULL;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  pipeline_free(pipeline);
+}
+
+/**
+ * Queues a forecast refresh, waiting while the fetch stage is full.
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param digest   The digest of the last response for this location, 0 to
+ *                 force parsing.
+ * @param forecast The forecast shown for this location, which the new one
+ *                 is parsed over, may be NULL. A reference is taken.
+ * @param callback The function to call with the new forecast.
+ * @param data     Pointer to user data to pass to the callback.
+ * @param destroy  Function releasing the user data once the refresh is
+ *                 done, may be NULL.
+ *
+ * @return TRUE if the refresh was queued, FALSE otherwise, in which case
+ *         the user data has been released.
+ */
+gboolean
+refresh_request(const gchar   * woeid,
+                gchar           units,
+                guint64         digest,
+                gpointer        forecast,
+                RefreshCallback callback,
+                gpointer        data,
+                GDestroyNotify  destroy)
+{
+  RefreshJob * job = slabpool_alloc0(&g_pool);
+
+  if (!job) {
+    LXW_LOG(LXW_ERROR, "refresh::refresh_request(%s): out of memory", woeid);
+
+    if (destroy) {
+      destroy(data);
+    }
+
+    return FALSE;
+  }
+
+  job->woeid_    = g_strdup(woeid);
+  job->units_    = units;
+  job->digest_   = digest;
+  job->forecast_ = forecast_ref(forecast);
+  job->callback_ = callback;
+  job->data_     = data;
+  job->destroy_  = destroy;
+
+  pthread_mutex_lock(&g_mutex);
+
+  Pipeline * pipeline = g_pipeline;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (!pipeline) {
+    LXW_LOG(LXW_ERROR, "refresh::refresh_request(%s): Not initialized", woeid);
+
+    job_free(job);
+
+    return FALSE;
+  }
+
+  return pipeline_push(pipeline, job);
+}
+
+/**
+ * Logs the queue depth and service time of every stage, the health of the
+ * providers, and the allocations of the record pools.
+ *
+ */
+void
+refresh_stats_log(void)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  Pipeline * pipeline = g_pipeline;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (!pipeline) {
+    return;
+  }
+
+  guint index = 0;
+
+  for (; index < pipeline_stage_count(pipeline); ++index) {
+    PipelineStageStats stats;
+
+    pipeline_stage_stats(pipeline, index, &stats);
+
+    LXW_LOG(LXW_DEBUG,
+            "refresh::%s: depth %u/%u (peak %u), %u workers, "
+            "%" G_GUINT64_FORMAT " processed, %" G_GUINT64_FORMAT "us average",
+            stats.name_, stats.depth_, stats.capacity_, stats.peak_, stats.workers_,
+            stats.processed_,
+            (stats.processed_) ? stats.service_ / stats.processed_ : 0);
+  }
+
+  provider_stats_log();
+
+  slabpool_stats_log();
+
+  fleet_stats_log();
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the staged forecast refresh: fetch, parse, image and publish */
+
+#ifndef LXWEATHER_REFRESH_HEADER
+#define LXWEATHER_REFRESH_HEADER
+
+#include <glib.h>
+
+/**
+ * Called from the publish stage once a refresh produced a new forecast.
+ * Not called for refreshes that failed, or whose response was unchanged.
+ *
+ * @param woeid    The WOEID the forecast was requested for.
+ * @param forecast Pointer to the new forecast, with its image attached if
+ *                 one could be retrieved. Owned by the pipeline, take a
+ *                 reference with forecast_ref() to keep it.
+ * @param digest   The digest of the response behind the forecast, or 0 if
+ *                 its image could not be retrieved, so that the next
+ *                 refresh parses it again.
+ * @param data     Pointer to the user data supplied with the request.
+ */
+typedef void (*RefreshCallback)(const gchar * woeid,
+                                gpointer      forecast,
+                                guint64       digest,
+                                gpointer      data);
+
+/**
+ * Starts the refresh pipeline.
+ *
+ */
+void
+refresh_init(void);
+
+/**
+ * Stops the refresh pipeline, dropping refreshes still queued.
+ *
+ */
+void
+refresh_cleanup(void);
+
+/**
+ * Queues a forecast refresh, waiting while the fetch stage is full.
+ *
+ * @param woeid    The string containing the WOEID of the location
+ * @param units    The character containing the units for the forecast (c|f)
+ * @param digest   The digest of the last response for this location, 0 to
+ *                 force parsing.
+ * @param forecast The forecast shown for this location, which the new one
+ *                 is parsed over, may be NULL. A reference is taken.
+ * @param callback The function to call with the new forecast.
+ * @param data     Pointer to user data to pass to the callback.
+ * @param destroy  Function releasing the user data once the refresh is
+ *                 done, may be NULL.
+ *
+ * @return TRUE if the refresh was queued, FALSE otherwise, in which case
+ *         the user data has been released.
+ */
+gboolean
+refresh_request(const gchar   * woeid,
+                gchar           units,
+                guint64         digest,
+                gpointer        forecast,
+                RefreshCallback callback,
+                gpointer        data,
+                GDestroyNotify  destroy);
+
+/**
+ * Logs the queue depth and service time of every stage, the health of the
+ * providers, and the allocations of the record pools.
+ *
+ */
+void
+refresh_stats_log(void);
+
+#endif
@@ -0,0 +1,463 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides fixed-size object pools with per-thread caches */
+
+#include "slabpool.h"
+#include "logutil.h"
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* Objects are aligned as malloc() aligns them */
+#define SLABPOOL_ALIGN (2 * sizeof(gpointer))
+
+/* Pool of a thread cache beyond SLABPOOL_MAX */
+#define SLABPOOL_UNCACHED -2
+
+/* Under the address sanitizer every object comes from malloc() so that
+ * reuse after free is still caught; the stats are kept either way. */
+#if defined(__SANITIZE_ADDRESS__)
+#define SLABPOOL_PASSTHROUGH 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SLABPOOL_PASSTHROUGH 1
+#endif
+#endif
+
+/* Objects one thread holds for one pool, taken and returned last in, first
+ * out so that the most recently touched object is handed out again */
+typedef struct
+{
+  SlabPool * pool_;
+  guint      count_;
+  gpointer   objects_[SLABPOOL_MAGAZINE];
+} SlabMagazine;
+
+typedef struct
+{
+  SlabMagazine magazines_[SLABPOOL_MAX];
+} SlabCache;
+
+/* Serializes the registration of pools */
+static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SlabPool      * g_pools[SLABPOOL_MAX];
+static volatile gint   g_count = 0;
+
+static pthread_once_t  g_once = PTHREAD_ONCE_INIT;
+static pthread_key_t   g_key;
+
+/* Set from G_SLICE=always-malloc, which memory checkers rely on already */
+static gboolean        g_passthrough = FALSE;
+
+/**
+ * Returns objects to the pool's free list. The pool must be locked.
+ *
+ * @param pool    Pointer to the pool.
+ * @param objects Array of objects.
+ * @param count   Number of objects in the array.
+ */
+static void
+slabpool_put(SlabPool * pool, gpointer * objects, guint count)
+{
+  guint index = 0;
+
+  for (; index < count; ++index) {
+    *(gpointer *)objects[index] = pool->free_;
+
+    pool->free_ = objects[index];
+  }
+}
+
+/**
+ * Carves a new slab into objects on the pool's free list. The pool must be
+ * locked.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return 0 on success, -1 if there was no memory for the slab.
+ */
+static gint
+slabpool_grow(SlabPool * pool)
+{
+  gsize stride = MAX(pool->size_, sizeof(gpointer));
+
+  stride = (stride + SLABPOOL_ALIGN - 1) & ~(SLABPOOL_ALIGN - 1);
+
+  gchar * slab = g_try_malloc(stride * SLABPOOL_SLAB);
+
+  if (!slab) {
+    LXW_LOG(LXW_ERROR, "slabpool::grow(%s): out of memory", pool->name_);
+
+    return -1;
+  }
+
+  pool->slabs_ = g_slist_prepend(pool->slabs_, slab);
+
+  gint index = SLABPOOL_SLAB - 1;
+
+  for (; index >= 0; --index) {
+    gpointer object = slab + index * stride;
+
+    slabpool_put(pool, &object, 1);
+  }
+
+  return 0;
+}
+
+/**
+ * Takes objects off the pool's free list, growing the pool as needed. The
+ * pool must be locked.
+ *
+ * @param pool    Pointer to the pool.
+ * @param objects Array to store the objects in.
+ * @param count   Number of objects wanted.
+ *
+ * @return Number of objects taken, fewer than wanted only if the pool could
+ *         not grow.
+ */
+static guint
+slabpool_take(SlabPool * pool, gpointer * objects, guint count)
+{
+  guint taken = 0;
+
+  while (taken < count) {
+    if (!pool->free_ && slabpool_grow(pool)) {
+      break;
+    }
+
+    objects[taken] = pool->free_;
+
+    pool->free_ = *(gpointer *)objects[taken];
+
+    ++taken;
+  }
+
+  return taken;
+}
+
+/**
+ * Returns everything a thread cache holds to the pools, when the thread
+ * exits.
+ *
+ * @param data Pointer to the cache.
+ */
+static void
+slabpool_cache_free(gpointer data)
+{
+  SlabCache * cache = (SlabCache *)data;
+
+  guint index = 0;
+
+  for (; index < SLABPOOL_MAX; ++index) {
+    SlabMagazine * magazine = &cache->magazines_[index];
+
+    if (magazine->pool_ && magazine->count_) {
+      pthread_mutex_lock(&magazine->pool_->mutex_);
+
+      slabpool_put(magazine->pool_, magazine->objects_, magazine->count_);
+
+      pthread_mutex_unlock(&magazine->pool_->mutex_);
+    }
+  }
+
+  g_free(cache);
+}
+
+/**
+ * Creates the key of the thread caches.
+ *
+ */
+static void
+slabpool_once(void)
+{
+  const gchar * slice = g_getenv("G_SLICE");
+
+  g_passthrough = (slice && strstr(slice, "always-malloc"));
+
+  pthread_key_create(&g_key, slabpool_cache_free);
+}
+
+/**
+ * Gives the pool the index of its thread cache, on first use.
+ *
+ * @param pool Pointer to the pool.
+ */
+static void
+slabpool_register(SlabPool * pool)
+{
+  pthread_mutex_lock(&g_mutex);
+
+  if (pool->id_ == -1) {
+    gint count = g_atomic_int_get(&g_count);
+
+    if (count < SLABPOOL_MAX) {
+      g_pools[count] = pool;
+
+      g_atomic_int_set(&pool->id_, count);
+      g_atomic_int_set(&g_count, count + 1);
+    } else {
+      LXW_LOG(LXW_ERROR, "slabpool::register(%s): Too many pools", pool->name_);
+
+      g_atomic_int_set(&pool->id_, SLABPOOL_UNCACHED);
+    }
+  }
+
+  pthread_mutex_unlock(&g_mutex);
+}
+
+/**
+ * Returns the calling thread's cache of a pool.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return Pointer to the magazine, or NULL if the pool has no thread cache
+ *         or there was no memory for one.
+ */
+static SlabMagazine *
+slabpool_magazine(SlabPool * pool)
+{
+  gint id = g_atomic_int_get(&pool->id_);
+
+  if (id == -1) {
+    slabpool_register(pool);
+
+    id = g_atomic_int_get(&pool->id_);
+  }
+
+  if (id < 0) {
+    return NULL;
+  }
+
+  SlabCache * cache = pthread_getspecific(g_key);
+
+  if (!cache) {
+    cache = g_try_new0(SlabCache, 1);
+
+    if (!cache || pthread_setspecific(g_key, cache)) {
+      g_free(cache);
+
+      return NULL;
+    }
+  }
+
+  SlabMagazine * magazine = &cache->magazines_[id];
+
+  magazine->pool_ = pool;
+
+  return magazine;
+}
+
+/**
+ * Allocates a zeroed object from the pool.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return Pointer to the object, or NULL if the allocation failed.
+ */
+gpointer
+slabpool_alloc0(SlabPool * pool)
+{
+  pthread_once(&g_once, slabpool_once);
+
+  gpointer object = NULL;
+
+#ifdef SLABPOOL_PASSTHROUGH
+  gboolean passthrough = TRUE;
+#else
+  gboolean passthrough = g_passthrough;
+#endif
+
+  if (passthrough) {
+    if (g_atomic_int_get(&pool->id_) == -1) {
+      slabpool_register(pool);
+    }
+
+    object = g_try_malloc0(pool->size_);
+  } else {
+    SlabMagazine * magazine = slabpool_magazine(pool);
+
+    if (magazine) {
+      if (!magazine->count_) {
+        pthread_mutex_lock(&pool->mutex_);
+
+        magazine->count_ = slabpool_take(pool, magazine->objects_, SLABPOOL_MAGAZINE / 2);
+
+        pthread_mutex_unlock(&pool->mutex_);
+      }
+
+      if (magazine->count_) {
+        object = magazine->objects_[--magazine->count_];
+      }
+    } else {
+      pthread_mutex_lock(&pool->mutex_);
+
+      slabpool_take(pool, &object, 1);
+
+      pthread_mutex_unlock(&pool->mutex_);
+    }
+
+    if (object) {
+      memset(object, 0, pool->size_);
+    }
+  }
+
+  if (!object) {
+    return NULL;
+  }
+
+  gint live = g_atomic_int_add(&pool->live_, 1) + 1;
+  gint peak = g_atomic_int_get(&pool->peak_);
+
+  while (live > peak && !g_atomic_int_compare_and_exchange(&pool->peak_, peak, live)) {
+    peak = g_atomic_int_get(&pool->peak_);
+  }
+
+  /* gsize wide, which only the pointer atomics are */
+  g_atomic_pointer_add(&pool->total_, 1);
+
+  return object;
+}
+
+/**
+ * Returns an object to the pool it was allocated from.
+ *
+ * @param pool   Pointer to the pool.
+ * @param object Pointer to the object, may be NULL.
+ */
+void
+slabpool_free(SlabPool * pool, gpointer object)
+{
+  if (!object) {
+    return;
+  }
+
+  g_atomic_int_add(&pool->live_, -1);
+
+#ifdef SLABPOOL_PASSTHROUGH
+  gboolean passthrough = TRUE;
+#else
+  gboolean passthrough = g_passthrough;
+#endif
+
+  if (passthrough) {
+    g_free(object);
+
+    return;
+  }
+
+  SlabMagazine * magazine = slabpool_magazine(pool);
+
+  if (!magazine) {
+    pthread_mutex_lock(&pool->mutex_);
+
+    slabpool_put(pool, &object, 1);
+
+    pthread_mutex_unlock(&pool->mutex_);
+
+    return;
+  }
+
+  /* keep half, so that alternating frees and allocations stay local */
+  if (magazine->count_ == SLABPOOL_MAGAZINE) {
+    pthread_mutex_lock(&pool->mutex_);
+
+    slabpool_put(pool,
+                 magazine->objects_ + SLABPOOL_MAGAZINE / 2,
+                 SLABPOOL_MAGAZINE - SLABPOOL_MAGAZINE / 2);
+
+    pthread_mutex_unlock(&pool->mutex_);
+
+    magazine->count_ = SLABPOOL_MAGAZINE / 2;
+  }
+
+  magazine->objects_[magazine->count_++] = object;
+}
+
+/**
+ * Returns the number of pools allocated from so far.
+ *
+ * @return The number of pools.
+ */
+guint
+slabpool_count(void)
+{
+  return g_atomic_int_get(&g_count);
+}
+
+/**
+ * Takes a snapshot of one pool.
+ *
+ * @param index Index of the pool, in order of first use.
+ * @param stats Pointer to the snapshot to fill in.
+ */
+void
+slabpool_stats(guint index, SlabPoolStats * stats)
+{
+  memset(stats, 0, sizeof(SlabPoolStats));
+
+  pthread_mutex_lock(&g_mutex);
+
+  SlabPool * pool = (index < (guint)g_count) ? g_pools[index] : NULL;
+
+  pthread_mutex_unlock(&g_mutex);
+
+  if (!pool) {
+    return;
+  }
+
+  stats->name_  = pool->name_;
+  stats->size_  = pool->size_;
+  stats->live_  = MAX(g_atomic_int_get(&pool->live_), 0);
+  stats->peak_  = g_atomic_int_get(&pool->peak_);
+  stats->total_ = (gsize)g_atomic_pointer_get(&pool->total_);
+
+  pthread_mutex_lock(&pool->mutex_);
+
+  stats->slabs_ = g_slist_length(pool->slabs_);
+
+  pthread_mutex_unlock(&pool->mutex_);
+}
+
+/**
+ * Logs the allocations of every pool.
+ *
+ */
+void
+slabpool_stats_log(void)
+{
+  guint index = 0;
+
+  for (; index < slabpool_count(); ++index) {
+    SlabPoolStats stats;
+
+    slabpool_stats(index, &stats);
+
+    LXW_LOG(LXW_DEBUG,
+            "slabpool::%s: %u live (peak %u), %" G_GUINT64_FORMAT " allocated, "
+            "%u slabs of %u x %" G_GSIZE_FORMAT " bytes",
+            stats.name_, stats.live_, stats.peak_, stats.total_,
+            stats.slabs_, SLABPOOL_SLAB, stats.size_);
+  }
+}
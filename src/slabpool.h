@@ -0,0 +1,117 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides fixed-size object pools with per-thread caches */
+
+#ifndef LXWEATHER_SLABPOOL_HEADER
+#define LXWEATHER_SLABPOOL_HEADER
+
+#include <pthread.h>
+
+#include <glib.h>
+
+/* Pools with a per-thread cache, any further ones go through their lock */
+#define SLABPOOL_MAX      8
+
+/* Objects carved out of every slab */
+#define SLABPOOL_SLAB     64
+
+/* Objects each thread keeps at hand, per pool */
+#define SLABPOOL_MAGAZINE 32
+
+/*
+ * A pool of objects of one size. Pools are defined statically with
+ * SLABPOOL_INIT() and live as long as the process, as do their slabs:
+ * freed objects go back to the pool, never to the system, so the heap of
+ * a long-running process does not fragment over the records it churns.
+ *
+ * Everything but name_ and size_ is private to slabpool.c.
+ */
+typedef struct
+{
+  const gchar   * name_;
+  gsize           size_;
+  pthread_mutex_t mutex_;
+  gpointer        free_;     // objects not held by any thread cache
+  GSList        * slabs_;
+  volatile gint   id_;       // index of the thread cache, -1 if none
+  volatile gint   live_;
+  volatile gint   peak_;
+  volatile gsize  total_;
+} SlabPool;
+
+#define SLABPOOL_INIT(name, size) \
+  { (name), (size), PTHREAD_MUTEX_INITIALIZER, NULL, NULL, -1, 0, 0, 0 }
+
+/* Snapshot of a pool, see slabpool_stats() */
+typedef struct
+{
+  const gchar * name_;
+  gsize         size_;
+  guint         live_;       // objects allocated now
+  guint         peak_;       // most objects ever allocated at once
+  guint64       total_;      // objects allocated since startup
+  guint         slabs_;
+} SlabPoolStats;
+
+/**
+ * Allocates a zeroed object from the pool.
+ *
+ * @param pool Pointer to the pool.
+ *
+ * @return Pointer to the object, or NULL if the allocation failed.
+ */
+gpointer
+slabpool_alloc0(SlabPool * pool);
+
+/**
+ * Returns an object to the pool it was allocated from.
+ *
+ * @param pool   Pointer to the pool.
+ * @param object Pointer to the object, may be NULL.
+ */
+void
+slabpool_free(SlabPool * pool, gpointer object);
+
+/**
+ * Returns the number of pools allocated from so far.
+ *
+ * @return The number of pools.
+ */
+guint
+slabpool_count(void);
+
+/**
+ * Takes a snapshot of one pool.
+ *
+ * @param index Index of the pool, in order of first use.
+ * @param stats Pointer to the snapshot to fill in.
+ */
+void
+slabpool_stats(guint index, SlabPoolStats * stats);
+
+/**
+ * Logs the allocations of every pool.
+ *
+ */
+void
+slabpool_stats_log(void);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a local stand-in for the weather services */
+
+#include "stubweather.h"
+#include "yahooutil.h"
+#include "location.h"
+#include "logutil.h"
+#include "textutil.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#define STUBWEATHER_PLACES   "places.xml"
+#define STUBWEATHER_DEFAULT  "default.xml"
+
+/* Directory holding the canned responses */
+static const gchar * g_directory = NULL;
+
+/**
+ * Reads a canned response.
+ *
+ * @param name   Name of the file in the stub directory.
+ * @param length Pointer to the length of the response, set on success.
+ *
+ * @return The response, which must be freed by the caller, or NULL if there
+ *         is no such file.
+ */
+static gchar *
+response_read(const gchar * name, gint * length)
+{
+  gchar * path = g_build_filename(g_directory, name, NULL);
+
+  gchar * contents = NULL;
+
+  gsize len = 0;
+
+  if (!g_file_get_contents(path, &contents, &len, NULL)) {
+    contents = NULL;
+  } else if (length) {
+    *length = (gint)len;
+  }
+
+  g_free(path);
+
+  return contents;
+}
+
+/**
+ * Retrieves the canned places whose city starts with the query.
+ *
+ * @param location The string containing the name of the location
+ * @param list     Pointer to the list to fill with LocationInfo entries.
+ *
+ * @return 0 on success, even if nothing matched, -1 if there are no places.
+ */
+static gint
+location_find(const gchar * location, GList ** list)
+{
+  gchar * response = response_read(STUBWEATHER_PLACES, NULL);
+
+  GList * places = NULL;
+
+  if (!response || location_response_parse(response, &places)) {
+    g_free(response);
+
+    g_list_free_full(places, location_unref);
+
+    return -1;
+  }
+
+  gchar * query = textutil_query_normalize(location);
+
+  GList * curr = places;
+
+  while (curr) {
+    GList * next = curr->next;
+
+    LocationInfo * place = (LocationInfo *)curr->data;
+
+    gchar * city = textutil_query_normalize((place->city_) ? place->city_ : "");
+
+    if (g_str_has_prefix(city, query)) {
+      places = g_list_remove_link(places, curr);
+
+      *list = g_list_concat(*list, curr);
+    }
+
+    g_free(city);
+
+    curr = next;
+  }
+
+  g_free(query);
+  g_free(response);
+
+  g_list_free_full(places, location_unref);
+
+  return 0;
+}
+
+/**
+ * Reads the canned forecast for a location, or the default one.
+ *
+ * @param woeid  The string containing the WOEID of the location
+ * @param units  Unused, the canned responses are in whatever units they are.
+ * @param length Pointer to the length of the response, set on success.
+ *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
+ */
+static gchar *
+forecast_fetch(const gchar * woeid, const gchar units G_GNUC_UNUSED, gint * length)
+{
+  gchar * response = NULL;
+
+  /* only plain WOEIDs make it into a file name */
+  if (*woeid && strspn(woeid, "0123456789") == strlen(woeid)) {
+    gchar * name = g_strconcat(woeid, ".xml", NULL);
+
+    response = response_read(name, length);
+
+    g_free(name);
+  }
+
+  if (!response) {
+    response = response_read(STUBWEATHER_DEFAULT, length);
+  }
+
+  LXW_LOG(LXW_DEBUG, "stubweather::forecast_fetch(%s): %s",
+          woeid, (response) ? "found" : "no canned response");
+
+  return response;
+}
+
+/**
+ * Parses a canned forecast.
+ *
+ * @param response The response, NUL-terminated.
+ * @param length   Unused, the response is NUL-terminated.
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static gint
+forecast_parse(const gchar * response, gint length G_GNUC_UNUSED, gpointer * forecast)
+{
+  return forecast_response_parse((gpointer)response, forecast);
+}
+
+/* The canned responses; they only change when edited, nothing is volatile */
+static const WeatherProvider g_provider = {
+  "stub",
+  location_find,
+  forecast_fetch,
+  forecast_parse,
+  NULL,
+  0
+};
+
+/**
+ * Returns the provider answering from canned responses on disk: places.xml
+ * for location searches, and WOEID.xml, or default.xml, for forecasts.
+ *
+ * @return Pointer to the provider, or NULL if STUBWEATHER_DIR_VARIABLE is
+ *         not set.
+ */
+const WeatherProvider *
+stubweather_provider(void)
+{
+  g_directory = g_getenv(STUBWEATHER_DIR_VARIABLE);
+
+  return (g_directory && *g_directory) ? &g_provider : NULL;
+}
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides a local stand-in for the weather services */
+
+#ifndef LXWEATHER_STUBWEATHER_HEADER
+#define LXWEATHER_STUBWEATHER_HEADER
+
+#include "provider.h"
+
+#include <glib.h>
+
+/* Directory holding the canned responses, the stub is off if unset */
+#define STUBWEATHER_DIR_VARIABLE "LXWEATHER_STUB_DIR"
+
+/**
+ * Returns the provider answering from canned responses on disk: places.xml
+ * for location searches, and WOEID.xml, or default.xml, for forecasts. Both
+ * are in the YQL XML format.
+ *
+ * @return Pointer to the provider, or NULL if STUBWEATHER_DIR_VARIABLE is
+ *         not set.
+ */
+const WeatherProvider *
+stubweather_provider(void);
+
+#endif
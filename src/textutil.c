@@ -0,0 +1,410 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides reentrant text helpers for building queries */
+
+#include "textutil.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+/* Replacement for characters without an ASCII equivalent */
+#define TEXTUTIL_UNKNOWN "?"
+
+/* ASCII transliterations of Latin-1 Supplement and Latin Extended-A */
+static const char * const g_latin_table[] = {
+  /* U+00A0 */ " ", "!", "c", "GBP", "?", "JPY", "|", "SS",
+  /* U+00A8 */ "\"", "(C)", "a", "<<", "!", "-", "(R)", "-",
+  /* U+00B0 */ "?", "+/-", "2", "3", "'", "u", "P", ".",
+  /* U+00B8 */ ",", "1", "o", ">>", " 1/4", " 1/2", " 3/4", "?",
+  /* U+00C0 */ "A", "A", "A", "A", "A", "A", "AE", "C",
+  /* U+00C8 */ "E", "E", "E", "E", "I", "I", "I", "I",
+  /* U+00D0 */ "D", "N", "O", "O", "O", "O", "O", "x",
+  /* U+00D8 */ "O", "U", "U", "U", "U", "Y", "TH", "ss",
+  /* U+00E0 */ "a", "a", "a", "a", "a", "a", "ae", "c",
+  /* U+00E8 */ "e", "e", "e", "e", "i", "i", "i", "i",
+  /* U+00F0 */ "d", "n", "o", "o", "o", "o", "o", ":",
+  /* U+00F8 */ "o", "u", "u", "u", "u", "y", "th", "y",
+  /* U+0100 */ "A", "a", "A", "a", "A", "a", "C", "c",
+  /* U+0108 */ "C", "c", "C", "c", "C", "c", "D", "d",
+  /* U+0110 */ "D", "d", "E", "e", "E", "e", "E", "e",
+  /* U+0118 */ "E", "e", "E", "e", "G", "g", "G", "g",
+  /* U+0120 */ "G", "g", "G", "g", "H", "h", "H", "h",
+  /* U+0128 */ "I", "i", "I", "i", "I", "i", "I", "i",
+  /* U+0130 */ "I", "i", "IJ", "ij", "J", "j", "K", "k",
+  /* U+0138 */ "q", "L", "l", "L", "l", "L", "l", "L",
+  /* U+0140 */ "l", "L", "l", "N", "n", "N", "n", "N",
+  /* U+0148 */ "n", "'n", "N", "n", "O", "o", "O", "o",
+  /* U+0150 */ "O", "o", "OE", "oe", "R", "r", "R", "r",
+  /* U+0158 */ "R", "r", "S", "s", "S", "s", "S", "s",
+  /* U+0160 */ "S", "s", "T", "t", "T", "t", "T", "t",
+  /* U+0168 */ "U", "u", "U", "u", "U", "u", "U", "u",
+  /* U+0170 */ "U", "u", "U", "u", "W", "w", "Y", "y",
+  /* U+0178 */ "Y", "Z", "z", "Z", "z", "Z", "z", "s",
+};
+
+/* ASCII transliterations of Latin Extended-B */
+static const char * const g_latin_b_table[] = {
+  /* U+0180 */ "b", "B", "?", "?", "?", "?", "O", "C",
+  /* U+0188 */ "c", "D", "D", "D", "d", "?", "?", "?",
+  /* U+0190 */ "E", "F", "f", "G", "?", "?", "?", "I",
+  /* U+0198 */ "K", "k", "l", "?", "?", "N", "n", "O",
+  /* U+01A0 */ "O", "o", "?", "?", "P", "p", "?", "?",
+  /* U+01A8 */ "?", "?", "?", "t", "T", "t", "T", "U",
+  /* U+01B0 */ "u", "?", "V", "Y", "y", "Z", "z", "?",
+  /* U+01B8 */ "?", "?", "?", "?", "?", "?", "?", "?",
+  /* U+01C0 */ "?", "?", "?", "?", "DZ", "Dz", "dz", "LJ",
+  /* U+01C8 */ "Lj", "lj", "NJ", "Nj", "nj", "A", "a", "I",
+  /* U+01D0 */ "i", "O", "o", "U", "u", "U", "u", "U",
+  /* U+01D8 */ "u", "U", "u", "U", "u", "?", "A", "a",
+  /* U+01E0 */ "A", "a", "?", "?", "G", "g", "G", "g",
+  /* U+01E8 */ "K", "k", "O", "o", "O", "o", "?", "?",
+  /* U+01F0 */ "j", "DZ", "Dz", "dz", "G", "g", "?", "?",
+  /* U+01F8 */ "N", "n", "A", "a", "?", "?", "?", "?",
+  /* U+0200 */ "A", "a", "A", "a", "E", "e", "E", "e",
+  /* U+0208 */ "I", "i", "I", "i", "O", "o", "O", "o",
+  /* U+0210 */ "R", "r", "R", "r", "U", "u", "U", "u",
+  /* U+0218 */ "S", "s", "T", "t", "?", "?", "H", "h",
+  /* U+0220 */ "?", "?", "OU", "ou", "Z", "z", "A", "a",
+  /* U+0228 */ "E", "e", "O", "o", "O", "o", "O", "o",
+  /* U+0230 */ "O", "o", "Y", "y", "l", "n", "t", "j",
+  /* U+0238 */ "?", "?", "A", "C", "c", "L", "T", "?",
+  /* U+0240 */ "?", "?", "?", "B", "?", "?", "E", "e",
+  /* U+0248 */ "J", "j", "?", "?", "R", "r", "Y", "y",
+};
+
+/* ASCII transliterations of Latin Extended Additional */
+static const char * const g_latin_additional_table[] = {
+  /* U+1E00 */ "A", "a", "B", "b", "B", "b", "B", "b",
+  /* U+1E08 */ "C", "c", "D", "d", "D", "d", "D", "d",
+  /* U+1E10 */ "D", "d", "D", "d", "E", "e", "E", "e",
+  /* U+1E18 */ "E", "e", "E", "e", "E", "e", "F", "f",
+  /* U+1E20 */ "G", "g", "H", "h", "H", "h", "H", "h",
+  /* U+1E28 */ "H", "h", "H", "h", "I", "i", "I", "i",
+  /* U+1E30 */ "K", "k", "K", "k", "K", "k", "L", "l",
+  /* U+1E38 */ "L", "l", "L", "l", "L", "l", "M", "m",
+  /* U+1E40 */ "M", "m", "M", "m", "N", "n", "N", "n",
+  /* U+1E48 */ "N", "n", "N", "n", "O", "o", "O", "o",
+  /* U+1E50 */ "O", "o", "O", "o", "P", "p", "P", "p",
+  /* U+1E58 */ "R", "r", "R", "r", "R", "r", "R", "r",
+  /* U+1E60 */ "S", "s", "S", "s", "S", "s", "S", "s",
+  /* U+1E68 */ "S", "s", "T", "t", "T", "t", "T", "t",
+  /* U+1E70 */ "T", "t", "U", "u", "U", "u", "U", "u",
+  /* U+1E78 */ "U", "u", "U", "u", "V", "v", "V", "v",
+  /* U+1E80 */ "W", "w", "W", "w", "W", "w", "W", "w",
+  /* U+1E88 */ "W", "w", "X", "x", "X", "x", "Y", "y",
+  /* U+1E90 */ "Z", "z", "Z", "z", "Z", "z", "h", "t",
+  /* U+1E98 */ "w", "y", "a", "s", "?", "?", "SS", "?",
+  /* U+1EA0 */ "A", "a", "A", "a", "A", "a", "A", "a",
+  /* U+1EA8 */ "A", "a", "A", "a", "A", "a", "A", "a",
+  /* U+1EB0 */ "A", "a", "A", "a", "A", "a", "A", "a",
+  /* U+1EB8 */ "E", "e", "E", "e", "E", "e", "E", "e",
+  /* U+1EC0 */ "E", "e", "E", "e", "E", "e", "E", "e",
+  /* U+1EC8 */ "I", "i", "I", "i", "O", "o", "O", "o",
+  /* U+1ED0 */ "O", "o", "O", "o", "O", "o", "O", "o",
+  /* U+1ED8 */ "O", "o", "O", "o", "O", "o", "O", "o",
+  /* U+1EE0 */ "O", "o", "O", "o", "U", "u", "U", "u",
+  /* U+1EE8 */ "U", "u", "U", "u", "U", "u", "U", "u",
+  /* U+1EF0 */ "U", "u", "Y", "y", "Y", "y", "Y", "y",
+  /* U+1EF8 */ "Y", "y", "?", "?", "?", "?", "?", "?",
+};
+
+/* ASCII transliterations of General Punctuation dashes and quotes */
+static const char * const g_punctuation_table[] = {
+  /* U+2010 */ "-", "-", "-", "-", "-", "-", "||", "_",
+  /* U+2018 */ "'", "'", ",", "'", "\"", "\"", ",,", "\"",
+  /* U+2020 */ "+", "+", "o", ">", ".", "..", "...", "-",
+};
+
+/* Code point ranges covered by the transliteration tables */
+static const struct
+{
+  gunichar             first;
+  gsize                count;
+  const char * const * table;
+} g_fold_ranges[] = {
+  { 0x00A0, G_N_ELEMENTS(g_latin_table),            g_latin_table },
+  { 0x0180, G_N_ELEMENTS(g_latin_b_table),          g_latin_b_table },
+  { 0x1E00, G_N_ELEMENTS(g_latin_additional_table), g_latin_additional_table },
+  { 0x2010, G_N_ELEMENTS(g_punctuation_table),      g_punctuation_table }
+};
+
+/* ASCII characters left alone by URI escaping: alphanumerics, marks and '@' */
+static const guchar g_uri_unreserved[128] = {
+  /* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  /* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  /* 0x20 */ 0, 1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 0,
+  /* 0x30 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+  /* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+  /* 0x60 */ 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+};
+
+static const char g_hex_digits[] = "0123456789ABCDEF";
+
+/**
+ * Decodes one UTF-8 sequence.
+ *
+ * @param str Pointer to the first byte of the sequence.
+ * @param end Pointer past the last byte of the string.
+ * @param len Pointer to the length of the sequence, set to 1 if invalid.
+ *
+ * @return The code point, or (gunichar)-1 if the sequence is invalid.
+ */
+static gunichar
+utf8_decode(const guchar * str, const guchar * end, gsize * len)
+{
+  gunichar ch = str[0];
+  gsize    need = 0;
+  gunichar min  = 0;
+
+  if (ch < 0xC2) {
+    /* continuation bytes and overlong two-byte leads */
+    *len = 1;
+
+    return (gunichar)-1;
+  } else if (ch < 0xE0) {
+    ch &= 0x1F;
+    need = 1;
+    min  = 0x80;
+  } else if (ch < 0xF0) {
+    ch &= 0x0F;
+    need = 2;
+    min  = 0x800;
+  } else if (ch < 0xF5) {
+    ch &= 0x07;
+    need = 3;
+    min  = 0x10000;
+  } else {
+    *len = 1;
+
+    return (gunichar)-1;
+  }
+
+  if ((gsize)(end - str) <= need) {
+    *len = 1;
+
+    return (gunichar)-1;
+  }
+
+  gsize i = 1;
+  for (; i <= need; ++i) {
+    if ((str[i] & 0xC0) != 0x80) {
+      *len = 1;
+
+      return (gunichar)-1;
+    }
+
+    ch = (ch << 6) | (str[i] & 0x3F);
+  }
+
+  *len = need + 1;
+
+  if (ch < min || ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF)) {
+    return (gunichar)-1;
+  }
+
+  return ch;
+}
+
+/**
+ * Looks up the ASCII transliteration of a code point.
+ *
+ * @param ch The code point, outside of the ASCII range.
+ *
+ * @return The transliteration, never NULL.
+ */
+static const char *
+codepoint_fold(gunichar ch)
+{
+  gsize r = 0;
+  for (; r < G_N_ELEMENTS(g_fold_ranges); ++r) {
+    if (ch >= g_fold_ranges[r].first &&
+        ch - g_fold_ranges[r].first < g_fold_ranges[r].count) {
+      return g_fold_ranges[r].table[ch - g_fold_ranges[r].first];
+    }
+  }
+
+  return TEXTUTIL_UNKNOWN;
+}
+
+/**
+ * Appends ASCII text to the output, escaping it if requested.
+ *
+ * @param out    The string to append to.
+ * @param str    The ASCII text to append.
+ * @param len    The length of the text.
+ * @param escape TRUE to escape the text for a URI.
+ */
+static void
+ascii_append(GString * out, const gchar * str, gsize len, gboolean escape)
+{
+  if (!escape) {
+    g_string_append_len(out, str, len);
+
+    return;
+  }
+
+  gsize i = 0;
+  for (; i < len; ++i) {
+    guchar ch = (guchar)str[i];
+
+    if (ch < 128 && g_uri_unreserved[ch]) {
+      g_string_append_c(out, ch);
+    } else {
+      g_string_append_c(out, '%');
+      g_string_append_c(out, g_hex_digits[ch >> 4]);
+      g_string_append_c(out, g_hex_digits[ch & 0x0F]);
+    }
+  }
+}
+
+/**
+ * Folds the passed-in UTF-8 string to ASCII, optionally escaping it.
+ *
+ * @param instr  String to convert.
+ * @param escape TRUE to escape the result for a URI.
+ *
+ * @return The converted string which MUST BE FREED BY THE CALLER.
+ */
+static gchar *
+ascii_convert(const gchar * instr, gboolean escape)
+{
+  if (!instr) {
+    return NULL;
+  }
+
+  gsize len = strlen(instr);
+
+  const guchar * curr = (const guchar *)instr;
+  const guchar * end  = curr + len;
+
+  /* fast path: plain ASCII needs no folding */
+  while (curr < end && *curr < 0x80) {
+    ++curr;
+  }
+
+  if (curr == end && !escape) {
+    return g_strndup(instr, len);
+  }
+
+  /* worst case for escaped output is three bytes per input byte */
+  GString * out = g_string_sized_new((escape) ? len * 3 + 1 : len + 1);
+
+  ascii_append(out, instr, (const gchar *)curr - instr, escape);
+
+  while (curr < end) {
+    if (*curr < 0x80) {
+      /* copy the whole ASCII run at once */
+      const guchar * run = curr;
+
+      while (curr < end && *curr < 0x80) {
+        ++curr;
+      }
+
+      ascii_append(out, (const gchar *)run, curr - run, escape);
+    } else {
+      gsize seqlen = 0;
+
+      gunichar ch = utf8_decode(curr, end, &seqlen);
+
+      const char * folded = (ch == (gunichar)-1) ? TEXTUTIL_UNKNOWN : codepoint_fold(ch);
+
+      ascii_append(out, folded, strlen(folded), escape);
+
+      curr += seqlen;
+    }
+  }
+
+  return g_string_free(out, FALSE);
+}
+
+/**
+ * Folds the passed-in UTF-8 string to ASCII, transliterating accented
+ * Latin characters and common punctuation. Characters without an ASCII
+ * equivalent, and invalid sequences, become '?'.
+ *
+ * @param instr String to convert.
+ *
+ * @return The converted string which MUST BE FREED BY THE CALLER.
+ */
+gchar *
+textutil_ascii_fold(const gchar * instr)
+{
+  return ascii_convert(instr, FALSE);
+}
+
+/**
+ * Folds the passed-in UTF-8 string to ASCII and escapes it for use in a
+ * URI, in a single pass. The escaping matches xmlURIEscapeStr().
+ *
+ * @param instr String to convert.
+ *
+ * @return The converted string which MUST BE FREED BY THE CALLER.
+ */
+gchar *
+textutil_uri_escape(const gchar * instr)
+{
+  return ascii_convert(instr, TRUE);
+}
+
+/**
+ * Normalizes a search query: folded to lowercase ASCII, with every run of
+ * punctuation and whitespace turned into a single space.
+ *
+ * @param query The query to normalize.
+ *
+ * @return The normalized query, possibly empty, which MUST BE FREED BY THE
+ *         CALLER.
+ */
+gchar *
+textutil_query_normalize(const gchar * query)
+{
+  gchar * folded = ascii_convert(query, FALSE);
+
+  if (!folded) {
+    return g_strdup("");
+  }
+
+  gchar * out  = folded;
+  gchar * curr = folded;
+
+  gboolean space = FALSE;
+
+  for (; *curr; ++curr) {
+    if (g_ascii_isalnum(*curr)) {
+      if (space && out != folded) {
+        *out++ = ' ';
+      }
+
+      *out++ = g_ascii_tolower(*curr);
+
+      space = FALSE;
+    } else {
+      space = TRUE;
+    }
+  }
+
+  *out = '\0';
+
+  return folded;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides reentrant text helpers for building queries */
+
+#ifndef LXWEATHER_TEXTUTIL_HEADER
+#define LXWEATHER_TEXTUTIL_HEADER
+
+#include <glib.h>
+
+/**
+ * Folds the passed-in UTF-8 string to ASCII, transliterating accented
+ * Latin characters and common punctuation. Characters without an ASCII
+ * equivalent, and invalid sequences, become '?'.
+ *
+ * @param instr String to convert.
+ *
+ * @return The converted string which MUST BE FREED BY THE CALLER.
+ */
+gchar *
+textutil_ascii_fold(const gchar * instr);
+
+/**
+ * Folds the passed-in UTF-8 string to ASCII and escapes it for use in a
+ * URI, in a single pass. The escaping matches xmlURIEscapeStr().
+ *
+ * @param instr String to convert.
+ *
+ * @return The converted string which MUST BE FREED BY THE CALLER.
+ */
+gchar *
+textutil_uri_escape(const gchar * instr);
+
+/**
+ * Normalizes a search query: folded to lowercase ASCII, with every run of
+ * punctuation and whitespace turned into a single space.
+ *
+ * @param query The query to normalize.
+ *
+ * @return The normalized query, possibly empty, which MUST BE FREED BY THE
+ *         CALLER.
+ */
+gchar *
+textutil_query_normalize(const gchar * query);
+
+#endif
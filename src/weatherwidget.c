@@ -20,7 +20,9 @@
 
 #include "location.h"
 #include "forecast.h"
-#include "yahooutil.h"
+#include "provider.h"
+#include "refresh.h"
+#include "fleet.h"
 #include "weatherwidget.h"
 #include "logutil.h"
 
@@ -53,9 +55,16 @@
 #define GTK_WEATHER_NAME "GtkWeather"
 #define GTK_WEATHER_NOT_AVAILABLE_LABEL _("[N/A]")
 
+/* Type-ahead location search: pause in typing before a lookup is issued,
+ * and the shortest query worth a network round trip */
+#define LOCATION_SEARCH_DELAY      250
+#define LOCATION_SEARCH_REMOTE_MIN 3
+
 typedef struct _GtkWeatherPrivate     GtkWeatherPrivate;
-typedef struct _LocationThreadData    LocationThreadData;
+typedef struct _LocationSearchData    LocationSearchData;
+typedef struct _LocationLookupData    LocationLookupData;
 typedef struct _ForecastThreadData    ForecastThreadData;
+typedef struct _ForecastRequestData   ForecastRequestData;
 typedef struct _PopupMenuData         PopupMenuData;
 typedef struct _PreferencesDialogData PreferencesDialogData;
 typedef struct _ConditionsDialogData  ConditionsDialogData;
@@ -105,15 +114,31 @@ struct _ConditionsDialogData
   GtkWidget * sunset_text_label;
   GtkWidget * conditions_text_label;
   GtkWidget * conditions_image;
+  guint       version;      // of the forecast shown, 0 if none
+  guint       location;     // version of the location shown, 0 if none
+  gint        image_dim;    // size the image was scaled to
+};
+
+struct _LocationSearchData
+{
+  volatile gint   refcount;     // the dialog, plus one per lookup in flight
+  volatile gint   generation;   // bumped on every edit, stale results are dropped
+  guint           timerid;      // debounce timer, 0 if not armed
+  guint           pending;      // lookups in flight for the current generation
+  GtkWidget     * dialog;       // NULL once the dialog is gone
+  GtkWidget     * entry;
+  GtkWidget     * treeview;
+  GtkWidget     * status_label;
+  GtkListStore  * list_store;
+  GList         * list;         // LocationInfo entries, in list store order
 };
 
-struct _LocationThreadData
+struct _LocationLookupData
 {
-  pthread_t        thread;
-  gchar          * location;
-  GtkProgressBar * progress_bar;
-  GtkWidget      * progress_dialog;
-  volatile gint    active;
+  LocationSearchData * search;
+  gint                 generation;
+  gchar              * location;
+  GList              * list;
 };
 
 struct _ForecastThreadData
@@ -121,6 +146,15 @@ struct _ForecastThreadData
   pthread_t       thread;
   gint            timerid;
   volatile gint   active;    // 1 = should run, 0 = should stop
+  guint64         digest;    // of the response behind the current forecast
+  volatile gint   generation; // bumped on every request, older ones are dropped
+};
+
+struct _ForecastRequestData
+{
+  GtkWeather * weather;
+  gint         generation;
+  guint        version;      // of the location, which carries the units
 };
 
 struct _GtkWeatherPrivate
@@ -147,9 +181,18 @@ struct _GtkWeatherPrivate
   /* This rwlock is for both the location and forecast, they're a pair */
   pthread_rwlock_t rwlock;
   
-  /* Data for location and forecast retrieval threads */
-  LocationThreadData location_data;
+  /* Data for forecast retrieval threads */
   ForecastThreadData forecast_data;
+
+  /* What is on display, so that only the changed parts are redone. These
+   * are only touched on the main loop. */
+  guint     rendered;          // version of the forecast rendered, 0 if none
+  guint     rendered_location; // version of the location rendered, 0 if none
+  gint      rendered_height;   // height its image was scaled to
+  guint     published;         // version of the forecast last emitted
+  gchar   * tooltip_text;      // last tooltip built from a forecast
+  guint     tooltip_location;  // version of the location it was built for
+  guint     tooltip_version;   // version of the forecast it was built from
 };
 
 enum
@@ -185,6 +228,8 @@ static void gtk_weather_set_location (GtkWeather * weather, gpointer location, g
 static void gtk_weather_set_forecast (GtkWeather * weather, gpointer forecast);
 
 static gboolean gtk_weather_button_pressed  (GtkWidget * widget, GdkEventButton * event);
+static gboolean gtk_weather_query_tooltip   (GtkWidget * widget, gint x, gint y,
+                                             gboolean keyboard_mode, GtkTooltip * tooltip);
 static gboolean gtk_weather_key_pressed     (GtkWidget * widget, GdkEventKey * event, gpointer data);
 static gboolean gtk_weather_change_location (GtkWidget * widget, GdkEventButton * event);
 
@@ -192,8 +237,6 @@ static void gtk_weather_auto_update_toggled (GtkWidget * widget);
 
 static void gtk_weather_create_popup_menu            (GtkWeather * weather);
 static void gtk_weather_set_window_icon              (GtkWindow * window, gchar * icon_id);
-static void gtk_weather_show_location_progress_bar   (GtkWeather * weather);
-static void gtk_weather_show_location_list           (GtkWeather * weather, GList * list);
 static void gtk_weather_update_preferences_dialog    (GtkWeather * weather);
 static GtkWidget * gtk_weather_create_preferences_dialog(GtkWidget * widget);
 
@@ -208,8 +251,22 @@ static void gtk_weather_get_forecast (GtkWidget * widget);
 
 static void gtk_weather_run_error_dialog (GtkWindow * parent, gchar * error_msg);
 
-static gboolean gtk_weather_update_location_progress_bar (gpointer data);
-static gboolean gtk_weather_update_ui                    (gpointer data);
+static gboolean gtk_weather_update_ui (gpointer data);
+
+static void gtk_weather_forecast_arrived (const gchar * woeid, gpointer forecast,
+                                          guint64 digest, gpointer data);
+static void gtk_weather_release (gpointer data);
+static gboolean gtk_weather_release_idle (gpointer data);
+
+static void gtk_weather_location_search_unref   (LocationSearchData * search);
+static void gtk_weather_location_search_merge   (LocationSearchData * search, GList * list);
+static void gtk_weather_location_search_status  (LocationSearchData * search);
+static void gtk_weather_location_search_changed (GtkEditable * editable, gpointer data);
+static void gtk_weather_location_row_activated  (GtkTreeView * treeview, GtkTreePath * path,
+                                                 GtkTreeViewColumn * column, gpointer data);
+static gboolean gtk_weather_location_search_timerfunc (gpointer data);
+static gboolean gtk_weather_location_lookup_arrived   (gpointer data);
+static LocationInfo * gtk_weather_location_search_selected (LocationSearchData * search);
 
 static void * gtk_weather_get_location_threadfunc  (void * arg);
 static gboolean gtk_weather_get_forecast_timerfunc (gpointer data);
@@ -294,6 +351,7 @@ gtk_weather_class_init(GtkWeatherClass * klass)
   //widget_class->size_request = gtk_weather_size_request;
   widget_class->size_allocate      = gtk_weather_size_allocate;
   widget_class->button_press_event = gtk_weather_button_pressed;
+  widget_class->query_tooltip      = gtk_weather_query_tooltip;
   
   g_type_class_add_private(klass, sizeof(GtkWeatherPrivate));
 
@@ -347,13 +405,12 @@ gtk_weather_init(GtkWeather * weather)
   GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(weather);
 
   /* Initialize thread/sync primitives */
-   LocationThreadData * ltdata = &(priv->location_data);
    ForecastThreadData * ftdata = &(priv->forecast_data);
 
-  ltdata->active = 0;
-  
-  ftdata->timerid = 0;
-  ftdata->active  = 0;
+  ftdata->timerid    = 0;
+  ftdata->active     = 0;
+  ftdata->digest     = 0;
+  ftdata->generation = 0;
       
   if (pthread_mutex_init(&(priv->mutex), NULL) ||
       pthread_cond_init(&(priv->cond), NULL) ||
@@ -386,6 +443,9 @@ gtk_weather_init(GtkWeather * weather)
 
   gtk_container_set_border_width(GTK_CONTAINER(weather), 2);
 
+  /* Tooltip text is only built when someone actually hovers */
+  gtk_widget_set_has_tooltip(GTK_WIDGET(weather), TRUE);
+
   /* Popup menu */
   gtk_weather_create_popup_menu(weather);
 
@@ -415,9 +475,15 @@ gtk_weather_destroy(GObject * object)
   }
   
   /* Need to free location and forecast. */
-  location_free(priv->previous_location);
-  location_free(priv->location);
-  forecast_free(priv->forecast);
+  if (priv->location) {
+    fleet_detach(((LocationInfo *)priv->location)->woeid_);
+  }
+
+  location_unref(priv->previous_location);
+  location_unref(priv->location);
+  forecast_unref(priv->forecast);
+
+  g_free(priv->tooltip_text);
 
   if (priv->menu_data.menu && GTK_IS_WIDGET(priv->menu_data.menu)) {
     gtk_widget_destroy(priv->menu_data.menu);
@@ -489,7 +555,8 @@ gtk_weather_size_allocate(GtkWidget * widget, GtkAllocation * allocation)
 }
 
 /**
- * Helper function to update the widget based on internal change.
+ * Helper function to update the widget based on internal change. Only the
+ * parts whose inputs changed since the last rendering are redone.
  *
  * @param weather Pointer to the instance of this widget.
  */
@@ -502,17 +569,32 @@ gtk_weather_render(GtkWeather * weather)
           priv->location, priv->forecast);
 
   if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
-    if (priv->location && priv->forecast) {
-      ForecastInfo * forecast = (ForecastInfo *)priv->forecast;
+    gboolean located = (priv->location != NULL);
+
+    guint location = (located) ? ((LocationInfo *)priv->location)->version_ : 0;
+
+    /* keep the snapshot, a newer one may be published while we draw */
+    ForecastInfo * forecast = (ForecastInfo *)forecast_ref(priv->forecast);
+
+    pthread_rwlock_unlock(&(priv->rwlock));
+
+    /* the widget starts out showing neither, as versions 0 */
+    gboolean current = (location == priv->rendered_location &&
+                        ((forecast) ? forecast->version_ : 0) == priv->rendered);
+
+    if (located && forecast) {
+      guint changes = forecast_changes(forecast, priv->rendered);
 
       GtkRequisition req;
 
       gtk_widget_size_request(GTK_WIDGET(priv->hbox), &req);
 
       /* req will hold valid data for painted widget, so disregard if we're
-       * running in a single app 
+       * running in a single app. The image may also still be loading.
        */
-      if (req.height) {          
+      if (req.height && forecast->image_ &&
+          ((changes & FORECAST_CHANGED_IMAGE) ||
+           req.height != priv->rendered_height)) {
         /* set this image to the one in the forecast at correct scale */
         GdkPixbuf * forecast_pixbuf = gdk_pixbuf_scale_simple(forecast->image_,
                                                               req.height,
@@ -524,19 +606,25 @@ gtk_weather_render(GtkWeather * weather)
         if (G_IS_OBJECT(forecast_pixbuf)) {
           g_object_unref(forecast_pixbuf);
         }
+
+        priv->rendered_height = req.height;
       }
 
-      /* update the label with proper temperature */
-      gchar * temperature = g_strdup_printf("%d \302\260%s", 
-                                            forecast->temperature_,
-                                            forecast->units_.temperature_);
+      if (changes & (FORECAST_CHANGED_TEMPERATURE | FORECAST_CHANGED_UNITS)) {
+        /* update the label with proper temperature */
+        gchar * temperature = g_strdup_printf("%d \302\260%s", 
+                                              forecast->temperature_,
+                                              forecast->units_.temperature_);
 
-      gtk_label_set_text(GTK_LABEL(priv->label), temperature);
+        gtk_label_set_text(GTK_LABEL(priv->label), temperature);
 
-      g_free(temperature);
-    } else {
+        g_free(temperature);
+      }
+
+      priv->rendered = forecast->version_;
+    } else if (!current) {
       /* N/A */
-      if (priv->location) {
+      if (located) {
         gtk_image_set_from_stock(GTK_IMAGE(priv->image), 
                                  GTK_STOCK_DIALOG_WARNING, 
                                  GTK_ICON_SIZE_BUTTON);
@@ -548,16 +636,18 @@ gtk_weather_render(GtkWeather * weather)
       
       gtk_label_set_text(GTK_LABEL(priv->label), 
                          GTK_WEATHER_NOT_AVAILABLE_LABEL);
+
+      priv->rendered = 0;
     }
-    
-    /* update tooltip with proper data... */
-    gchar * tooltip_text = gtk_weather_get_tooltip_text(GTK_WIDGET(weather));
 
-    pthread_rwlock_unlock(&(priv->rwlock));
+    priv->rendered_location = location;
 
-    gtk_widget_set_tooltip_text(GTK_WIDGET(weather), tooltip_text);
+    forecast_unref(forecast);
 
-    g_free(tooltip_text);
+    /* the tooltip text is generated on demand, see query_tooltip */
+    if (!current) {
+      gtk_widget_trigger_tooltip_query(GTK_WIDGET(weather));
+    }
   }
 }
 
@@ -648,8 +738,8 @@ gtk_weather_get_property(GObject * object,
  * Sets the location property pointer for this widget.
  *
  * @param weather  Pointer to the instance of this widget.
- * @param location Location to use.
- * @param backup   Whether to make a backup copy of the current location.
+ * @param location Location to use, a reference is taken.
+ * @param backup   Whether to keep the current location as the previous one.
  *
  */
 static void
@@ -665,46 +755,75 @@ gtk_weather_set_location(GtkWeather * weather, gpointer location, gboolean backu
   location_print(location);
 #endif
 
+  gpointer detached = NULL;
+  gboolean changed  = FALSE;
+
   if (pthread_rwlock_wrlock(&(priv->rwlock)) == 0) {
-    if (backup) {
+    /* the fleet row of the outgoing location goes once the new one is in */
+    detached = location_ref(priv->location);
+
+    guint version = (priv->location) ? ((LocationInfo *)priv->location)->version_ : 0;
+
+    if (backup && priv->previous_location != priv->location) {
       /* Set previous location, to save it. */
-      location_copy(&priv->previous_location, priv->location);
+      location_unref(priv->previous_location);
+
+      priv->previous_location = location_ref(priv->location);
     }
 
     if (location) {
-      location_copy(&priv->location, location);
+      location_assign(&priv->location, location);
+
+      /* assigning the location already shown keeps its version */
+      changed = (((LocationInfo *)priv->location)->version_ != version);
 
       pthread_rwlock_unlock(&(priv->rwlock));
 
       /* reset forecast */
-      gtk_weather_set_forecast(weather, NULL);
+      if (changed) {
+        gtk_weather_set_forecast(weather, NULL);
+      }
 
       /* weather is rendered inside */
     } else {
-      location_free(priv->location);
+      location_unref(priv->location);
 
       priv->location = NULL;
 
+      changed = (version != 0);
+
       pthread_rwlock_unlock(&(priv->rwlock));
       
       gtk_weather_render(weather);
     }
   }
 
+  if (location) {
+    fleet_attach(((LocationInfo *)location)->woeid_);
+  }
+
+  if (detached) {
+    fleet_detach(((LocationInfo *)detached)->woeid_);
+
+    location_unref(detached);
+  }
+
   /* This will signal a conditional variable, not get the forecast.
    * It will also start the timer, if the location is configured for it
    */
   gtk_weather_get_forecast(GTK_WIDGET(weather));
 
   /* Emit location-changed event */
-  g_signal_emit_by_name(weather, "location-changed", location);
+  if (changed) {
+    g_signal_emit_by_name(weather, "location-changed", location);
+  }
 }
 
 /**
  * Sets the forecast property pointer for this widget.
  *
  * @param weather  Pointer to the instance of this widget.
- * @param forecast Forecast to use.
+ * @param forecast Forecast to use, a reference is taken. May be NULL.
  */
 static void
 gtk_weather_set_forecast(GtkWeather * weather, gpointer forecast)
@@ -719,20 +838,33 @@ gtk_weather_set_forecast(GtkWeather * weather, gpointer forecast)
   forecast_print(forecast);
 #endif
 
+  gpointer previous = NULL;
+
   if (pthread_rwlock_wrlock(&(priv->rwlock)) == 0) {
-    forecast_copy(&priv->forecast, forecast);
+    previous = priv->forecast;
+
+    priv->forecast = forecast_ref(forecast);
     
     pthread_rwlock_unlock(&(priv->rwlock));
   }
 
+  /* readers may still hold the previous snapshot */
+  forecast_unref(previous);
+
   gtk_weather_render(weather);
 
-  /* Emit forecast-changed event */
-  g_signal_emit_by_name(weather, "forecast-changed", forecast);
+  guint version = (forecast) ? ((ForecastInfo *)forecast)->version_ : 0;
 
-  /* Update the conditions dialog, if shown */
-  if (priv->conditions_data.shown) {
-    gtk_weather_update_conditions_dialog(weather);
+  if (version != priv->published) {
+    priv->published = version;
+
+    /* Emit forecast-changed event */
+    g_signal_emit_by_name(weather, "forecast-changed", forecast);
+
+    /* Update the conditions dialog, if shown */
+    if (priv->conditions_data.shown) {
+      gtk_weather_update_conditions_dialog(weather);
+    }
   }
 }
 
@@ -762,6 +894,34 @@ gtk_weather_button_pressed(GtkWidget * widget, GdkEventButton * event)
   return TRUE;
 }
 
+/**
+ * Handles the query-tooltip event. The multi-day forecast is only decoded
+ * here, so widgets nobody hovers over never pay for it.
+ *
+ * @param widget        Pointer to the instance on which the event occurred.
+ * @param x             The x coordinate of the cursor position.
+ * @param y             The y coordinate of the cursor position.
+ * @param keyboard_mode TRUE if the tooltip was triggered using the keyboard.
+ * @param tooltip       Pointer to the tooltip to fill in.
+ *
+ * @return TRUE if the tooltip should be shown, FALSE otherwise.
+ */
+static gboolean
+gtk_weather_query_tooltip(GtkWidget  * widget,
+                          gint         x             G_GNUC_UNUSED,
+                          gint         y             G_GNUC_UNUSED,
+                          gboolean     keyboard_mode G_GNUC_UNUSED,
+                          GtkTooltip * tooltip)
+{
+  gchar * tooltip_text = gtk_weather_get_tooltip_text(widget);
+
+  gtk_tooltip_set_text(tooltip, tooltip_text);
+
+  g_free(tooltip_text);
+
+  return TRUE;
+}
+
 /**
  * Handles the toggled event for auto/manual radio buttons
  * 
@@ -821,19 +981,33 @@ gtk_weather_change_location(GtkWidget      * widget,
   /* Set dialog window icon */
   gtk_weather_set_window_icon(GTK_WINDOW(dialog), "gtk-properties");
   
-  gtk_window_set_resizable(GTK_WINDOW(dialog), FALSE);
+  gtk_widget_set_size_request(dialog, 400, 400);
 
   gtk_dialog_set_default_response(GTK_DIALOG(dialog), GTK_RESPONSE_ACCEPT);
 
+  LocationSearchData * search = g_new0(LocationSearchData, 1);
+
+  search->refcount = 1;
+  search->dialog   = dialog;
+
   GtkWidget * location_label = gtk_label_new_with_mnemonic(_("_New Location:"));
 
   GtkWidget * location_entry = gtk_entry_new();
 
+  gtk_label_set_mnemonic_widget(GTK_LABEL(location_label), location_entry);
+
+  search->entry = location_entry;
+
   g_signal_connect(G_OBJECT(location_entry),
                    "key-press-event",
                    G_CALLBACK(gtk_weather_key_pressed),
                    (gpointer)dialog);
 
+  g_signal_connect(G_OBJECT(location_entry),
+                   "changed",
+                   G_CALLBACK(gtk_weather_location_search_changed),
+                   (gpointer)search);
+
   GtkWidget * image = gtk_image_new_from_stock(GTK_STOCK_DIALOG_INFO, GTK_ICON_SIZE_DIALOG);
 
   GtkWidget * description_label = gtk_label_new(_("Enter the:\n- city, or\n- city and state/country, or\n- postal code\nfor which to retrieve the weather forecast."));
@@ -855,12 +1029,77 @@ gtk_weather_change_location(GtkWidget      * widget,
   gtk_box_pack_start(GTK_BOX(label_hbox), image, FALSE, FALSE, 5);
   gtk_box_pack_start(GTK_BOX(label_hbox), entry_vbox, FALSE, FALSE, 5);
 
-  gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), label_hbox, TRUE, FALSE, 10);
+  gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), label_hbox, FALSE, FALSE, 10);
+
+  /* TreeView with the matches, filled in as the user types */
+  GtkWidget * treeview = gtk_tree_view_new();
+
+  search->treeview = treeview;
+
+  /* city */
+  GtkCellRenderer   * cell_renderer   = gtk_cell_renderer_text_new();
+  GtkTreeViewColumn * treeview_column = gtk_tree_view_column_new_with_attributes(_("City"),
+                                                                                 cell_renderer,
+                                                                                 "text",
+                                                                                 CITY_COLUMN,
+                                                                                 NULL);
+
+  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+
+  /* state */
+  cell_renderer = gtk_cell_renderer_text_new();
+  treeview_column = gtk_tree_view_column_new_with_attributes(_("State"),
+                                                             cell_renderer,
+                                                             "text",
+                                                             STATE_COLUMN,
+                                                             NULL);
+
+  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+
+  /* country */
+  cell_renderer = gtk_cell_renderer_text_new();
+  treeview_column = gtk_tree_view_column_new_with_attributes(_("Country"),
+                                                             cell_renderer,
+                                                             "text",
+                                                             COUNTRY_COLUMN,
+                                                             NULL);
+
+  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+
+  /* The tree view holds the only reference to the store */
+  search->list_store = gtk_list_store_new(MAX_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+
+  gtk_tree_view_set_model(GTK_TREE_VIEW(treeview), GTK_TREE_MODEL(search->list_store));
+
+  g_object_unref(search->list_store);
+
+  gtk_tree_selection_set_mode(gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview)),
+                              GTK_SELECTION_BROWSE);
+
+  g_signal_connect(G_OBJECT(treeview),
+                   "row-activated",
+                   G_CALLBACK(gtk_weather_location_row_activated),
+                   (gpointer)dialog);
+
+  GtkWidget * scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+                                 GTK_POLICY_AUTOMATIC,
+                                 GTK_POLICY_AUTOMATIC);
+
+  gtk_container_add(GTK_CONTAINER(scrolled_window), treeview);
+
+  gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), scrolled_window, TRUE, TRUE, 5);
+
+  search->status_label = gtk_label_new(NULL);
+
+  gtk_box_pack_start(GTK_BOX(GTK_DIALOG(dialog)->vbox), search->status_label, FALSE, FALSE, 5);
 
   gtk_widget_show_all(dialog);
 
   gint response = GTK_RESPONSE_NONE;
 
+  gboolean done = FALSE;
+
   do {
     response = gtk_dialog_run(GTK_DIALOG(dialog));
 
@@ -875,73 +1114,58 @@ gtk_weather_change_location(GtkWidget      * widget,
         break;
       }
 
-      gchar * new_location = g_strdup(gtk_entry_get_text(GTK_ENTRY(location_entry)));
-            
-      /* start thread here, let the progress bar do its own magic */
-      pthread_attr_t tattr;
-            
-      int ret = pthread_attr_init(&tattr);
-            
-      if (ret != 0) {
-        LOG_ERRNO(ret, "pthread_attr_init");
+      /* accepted before typing paused, search right away */
+      if (search->timerid) {
+        g_source_remove(search->timerid);
+
+        gtk_weather_location_search_timerfunc(search);
       }
 
-      ret = pthread_create(&(priv->location_data.thread),
-                           &tattr,
-                           &gtk_weather_get_location_threadfunc,
-                           new_location);
+      LocationInfo * location = gtk_weather_location_search_selected(search);
 
-      if (ret != 0) {
-        LOG_ERRNO(ret, "pthread_create");
-      }
+      if (!location) {
+        /* the status line tells whether a lookup is still running */
+        if (!search->pending) {
+          gchar * error_msg = g_strdup_printf(_("Location '%s' not found!"),
+                                              gtk_entry_get_text(GTK_ENTRY(location_entry)));
 
-      ret = pthread_attr_destroy(&tattr);
-      
-      if (ret != 0) {
-        LOG_ERRNO(ret, "pthread_attr_destroy");
-      }
-      
-      priv->location_data.location = new_location;
+          gtk_weather_run_error_dialog(GTK_WINDOW(dialog), error_msg);
 
-      /* show progress bar and lookup selected location */
-      gtk_weather_show_location_progress_bar(GTK_WEATHER(widget));
+          g_free(error_msg);
+        }
 
-      void * result = NULL;
-      ret = pthread_join(priv->location_data.thread, &result);
-      if (ret != 0) {
-        LOG_ERRNO(ret, "pthread_join");
+        break;
       }
 
-      gchar * error_msg = g_strdup_printf(_("Location '%s' not found!"),
-                                          new_location);
-      
-      if (result && result != PTHREAD_CANCELED) {
-        GList * list = (GList *)result;
-          
-        guint length = g_list_length(list);
+      if (!location->alias_ || !*location->alias_) {
+        /* the match may be shared with the caches, name a private copy */
+        GList * match = g_list_find(search->list, location);
 
-        LXW_LOG(LXW_DEBUG, "Thread returned list of length %u", length);
+        LocationInfo * named = (LocationInfo *)location_writable(&match->data);
 
-        if (length > 0) {
-          gtk_weather_show_location_list(GTK_WEATHER(widget), list);
-        } else {
-          gtk_weather_run_error_dialog(GTK_WINDOW(dialog), error_msg);
+        if (named) {
+          location = named;
+
+          location_property_set(location,
+                                "alias",
+                                location->city_,
+                                (location->city_) ? strlen(location->city_) : 0);
         }
-          
-        /* Free list */
-        g_list_free_full(list, location_free);
-          
-        /* Repaint preferences dialog */
-        gtk_weather_update_preferences_dialog(GTK_WEATHER(widget));
-      } else if (result == PTHREAD_CANCELED) {
-        /* nothing, user canceled search... */
-      } else {
-        gtk_weather_run_error_dialog(GTK_WINDOW(dialog), error_msg);
       }
-      
-      g_free(error_msg);
 
-      g_free(new_location);
+      /* I could achieve the same effect by calling g_object_set_property
+       * on the weather widget, but it requires an additional
+       * GValue allocation.  I'd rather just execute the call explicitly
+       */
+      gtk_weather_set_location(GTK_WEATHER(widget), (gpointer)location, TRUE);
+
+      /* This function will only start the thread if it isn't 'active'. */
+      gtk_weather_forecast_thread_start(GTK_WEATHER(widget));
+
+      /* Repaint preferences dialog */
+      gtk_weather_update_preferences_dialog(GTK_WEATHER(widget));
+
+      done = TRUE;
 
       break;
 
@@ -951,15 +1175,24 @@ gtk_weather_change_location(GtkWidget      * widget,
       break;
     }
         
-  } while ( (response == GTK_RESPONSE_ACCEPT) &&
-            (gtk_entry_get_text_length(GTK_ENTRY(location_entry)) == 0) );
+  } while ( (response == GTK_RESPONSE_ACCEPT) && !done );
+
+  /* lookups still in flight find the dialog gone and drop their results */
+  if (search->timerid) {
+    g_source_remove(search->timerid);
+
+    search->timerid = 0;
+  }
+
+  g_atomic_int_inc(&search->generation);
+
+  search->dialog = NULL;
 
   if (GTK_IS_WIDGET(dialog)) {
     gtk_widget_destroy(dialog);
   }
 
-  priv->location_data.thread   = 0;
-  priv->location_data.location = NULL;
+  gtk_weather_location_search_unref(search);
      
   dialog = NULL;
 
@@ -1124,12 +1357,13 @@ gtk_weather_preferences_dialog_response(GtkDialog * dialog G_GNUC_UNUSED,
   switch(response) {
   case GTK_RESPONSE_ACCEPT:
     if (pthread_rwlock_wrlock(&(priv->rwlock)) == 0) {
-      if(priv->location) {
-        LocationInfo * location = (LocationInfo *)priv->location;
+      /* readers may hold the current one, change a private copy */
+      LocationInfo * location = (LocationInfo *)location_writable(&priv->location);
 
+      if (location) {
         aliasstr = gtk_entry_get_text(GTK_ENTRY(priv->preferences_data.alias_entry));
 
-        location_property_set(priv->location,
+        location_property_set(location,
                               "alias",
                               aliasstr,
                               (aliasstr)?strlen(aliasstr):0);
@@ -1147,7 +1381,9 @@ gtk_weather_preferences_dialog_response(GtkDialog * dialog G_GNUC_UNUSED,
           (guint)gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(priv->preferences_data.auto_spin_button));
 
         /* Set this location as the valid one */
-        location_copy(&priv->previous_location, priv->location);
+        location_unref(priv->previous_location);
+
+        priv->previous_location = location_ref(location);
 
         pthread_rwlock_unlock(&(priv->rwlock));
       } else {
@@ -1577,7 +1813,7 @@ gtk_weather_create_conditions_dialog(GtkWeather * weather)
   LocationInfo * location = NULL;
 
   if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
-    location = (LocationInfo *)priv->location;
+    location = (LocationInfo *)location_ref(priv->location);
 
     pthread_rwlock_unlock(&(priv->rwlock));
   }
@@ -1585,6 +1821,8 @@ gtk_weather_create_conditions_dialog(GtkWeather * weather)
   gchar * dialog_title = g_strdup_printf(_("Current Conditions for %s"), 
                                          (location)?location->alias_:"");
 
+  location_unref(location);
+
   data->dialog = gtk_dialog_new_with_buttons(dialog_title,
                                              NULL,
                                              GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
@@ -1824,6 +2062,11 @@ gtk_weather_create_conditions_dialog(GtkWeather * weather)
 
   data->conditions_text_label = gtk_label_new(NULL);
 
+  /* The new labels are blank, the first update fills in all of them */
+  data->version   = 0;
+  data->location  = 0;
+  data->image_dim = 0;
+
   /* Pack boxes */
   gtk_box_pack_start(GTK_BOX(icon_vbox),
                      data->conditions_image,
@@ -1860,7 +2103,8 @@ gtk_weather_create_conditions_dialog(GtkWeather * weather)
 }
 
 /**
- * Updates the current conditions dialog.
+ * Updates the current conditions dialog, redoing only the labels whose
+ * fields changed since it was last updated.
  *
  * @param weather Pointer to the current instance of the weather widget.
  */
@@ -1876,24 +2120,45 @@ gtk_weather_update_conditions_dialog(GtkWeather * weather)
           ((data && data->shown)  ? "SHOWN":
            (data && !data->shown) ? "HIDDEN" : "NULL"));
 
-  LocationInfo * location = (LocationInfo *) (priv) ? priv->location : NULL;
-  ForecastInfo * forecast = (ForecastInfo *) (priv) ? priv->forecast : NULL;
+  gchar        * location_label_text = NULL;
+  ForecastInfo * forecast            = NULL;
 
-  if (location && forecast && data->dialog) {
-    if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
-      gchar * location_label_text = g_strconcat((location->city_)?location->city_:"",
-                                                (location->city_)?", ":"",
-                                                (location->state_)?location->state_:"",
-                                                (location->state_)?", ":"",
-                                                (location->country_)?location->country_:"",
-                                                NULL);
+  if (data->dialog && pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
+    LocationInfo * location = (LocationInfo *) priv->location;
+
+    if (location && priv->forecast) {
+      /* the same location keeps its version, and so its label */
+      if (location->version_ != data->location) {
+        location_label_text = g_strconcat((location->city_)?location->city_:"",
+                                          (location->city_)?", ":"",
+                                          (location->state_)?location->state_:"",
+                                          (location->state_)?", ":"",
+                                          (location->country_)?location->country_:"",
+                                          NULL);
+
+        data->location = location->version_;
+      }
+
+      forecast = (ForecastInfo *) forecast_ref(priv->forecast);
+    }
+
+    pthread_rwlock_unlock(&(priv->rwlock));
+  }
 
+  if (forecast) {
+    guint changes = forecast_changes(forecast, data->version);
+
+    if (location_label_text) {
       gtk_label_set_text(GTK_LABEL(data->location_text_label),
                          location_label_text);
+    }
 
+    if (changes & FORECAST_CHANGED_TIME) {
       gtk_label_set_text(GTK_LABEL(data->update_text_label),
                          forecast->time_);
+    }
 
+    if (changes & (FORECAST_CHANGED_WIND_CHILL | FORECAST_CHANGED_UNITS)) {
       gchar * windchill = g_strdup_printf("%d \302\260%s", 
                                           forecast->windChill_,
                                           forecast->units_.temperature_);
@@ -1901,34 +2166,63 @@ gtk_weather_update_conditions_dialog(GtkWeather * weather)
       gtk_label_set_text(GTK_LABEL(data->windchill_text_label),
                          windchill);
 
+      g_free(windchill);
+    }
+
+    if (changes & FORECAST_CHANGED_HUMIDITY) {
       gchar * humidity = g_strdup_printf("%d%%", forecast->humidity_);
 
       gtk_label_set_text(GTK_LABEL(data->humidity_text_label), humidity);
 
+      g_free(humidity);
+    }
+
+    if (changes & (FORECAST_CHANGED_PRESSURE | FORECAST_CHANGED_UNITS)) {
       gchar * pressure = g_strdup_printf("%4.2f %s", 
                                          forecast->pressure_,
                                          forecast->units_.pressure_);
 
       gtk_label_set_text(GTK_LABEL(data->pressure_text_label), pressure);
 
+      g_free(pressure);
+    }
+
+    if (changes & (FORECAST_CHANGED_VISIBILITY | FORECAST_CHANGED_UNITS)) {
       gchar * visibility = g_strdup_printf("%4.2f %s", 
                                            forecast->visibility_,
                                            forecast->units_.distance_);
 
       gtk_label_set_text(GTK_LABEL(data->visibility_text_label), visibility);
 
+      g_free(visibility);
+    }
+
+    if (changes & (FORECAST_CHANGED_WIND_DIRECTION |
+                   FORECAST_CHANGED_WIND_SPEED     |
+                   FORECAST_CHANGED_UNITS)) {
       gchar * wind = g_strdup_printf("%s %d %s", 
                                      forecast->windDirection_,
                                      forecast->windSpeed_,
                                      forecast->units_.speed_);
 
       gtk_label_set_text(GTK_LABEL(data->wind_text_label), wind);
+
+      g_free(wind);
+    }
+
+    if (changes & FORECAST_CHANGED_SUNRISE) {
       gtk_label_set_text(GTK_LABEL(data->sunrise_text_label),
                          forecast->sunrise_);
+    }
 
+    if (changes & FORECAST_CHANGED_SUNSET) {
       gtk_label_set_text(GTK_LABEL(data->sunset_text_label),
                          forecast->sunset_);
+    }
 
+    if (changes & (FORECAST_CHANGED_TEMPERATURE |
+                   FORECAST_CHANGED_CONDITIONS  |
+                   FORECAST_CHANGED_UNITS)) {
       gchar * conditions_label_text = g_strdup_printf("<b>%d \302\260%s %s</b>", 
                                                       forecast->temperature_,
                                                       forecast->units_.temperature_,
@@ -1937,14 +2231,19 @@ gtk_weather_update_conditions_dialog(GtkWeather * weather)
       gtk_label_set_markup(GTK_LABEL(data->conditions_text_label),
                            conditions_label_text);
 
-      /* Get dimensions to create proper icon... */
-      GtkRequisition req;
+      g_free(conditions_label_text);
+    }
 
-      gtk_widget_size_request(data->dialog, &req);
+    /* Get dimensions to create proper icon... */
+    GtkRequisition req;
 
-      /* Need the minimum */
-      gint dim = (req.width < req.height) ? req.width/2 : req.height/2;
+    gtk_widget_size_request(data->dialog, &req);
 
+    /* Need the minimum */
+    gint dim = (req.width < req.height) ? req.width/2 : req.height/2;
+
+    if (forecast->image_ &&
+        ((changes & FORECAST_CHANGED_IMAGE) || dim != data->image_dim)) {
       GdkPixbuf * icon_buf = gdk_pixbuf_scale_simple(forecast->image_,
                                                      dim, dim,
                                                      GDK_INTERP_BILINEAR);
@@ -1953,22 +2252,18 @@ gtk_weather_update_conditions_dialog(GtkWeather * weather)
 
       g_object_unref(icon_buf);
 
-      pthread_rwlock_unlock(&(priv->rwlock));
+      data->image_dim = dim;
+    }
 
-      /* Free everything */
-      g_free(conditions_label_text);
-      g_free(wind);
-      g_free(visibility);
-      g_free(pressure);
-      g_free(windchill);
-      g_free(humidity);
-      g_free(location_label_text);
+    data->version = forecast->version_;
 
-      data->shown = TRUE;
+    forecast_unref(forecast);
 
-      gtk_widget_show_all(data->dialog);
-    }
+    g_free(location_label_text);
 
+    data->shown = TRUE;
+
+    gtk_widget_show_all(data->dialog);
   }
 }
 
@@ -1991,17 +2286,21 @@ gtk_weather_run_conditions_dialog(GtkWidget * widget)
           ((data && data->shown)  ? "SHOWN":
            (data && !data->shown) ? "HIDDEN" : "NULL"));
 
-  LocationInfo * location = NULL;
-  ForecastInfo * forecast = NULL;
-  const gchar  * alias    = NULL;
+  LocationInfo * location  = NULL;
+  ForecastInfo * forecast  = NULL;
+  gchar        * error_msg = NULL;
 
   /* clang --analyze complains that priv may be null, not sure how, though */
   if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
     location = (LocationInfo *) priv->location;
     forecast = (ForecastInfo *) priv->forecast;
 
-    /* for the error message */
-    alias = (location) ? location->alias_ : _("N/A");
+    /* the location may be replaced once unlocked, only its presence
+     * is looked at below */
+    if (location && !forecast) {
+      error_msg = g_strdup_printf(_("Forecast for %s unavailable."),
+                                  (location->alias_) ? location->alias_ : _("N/A"));
+    }
 
     pthread_rwlock_unlock(&(priv->rwlock));
   }
@@ -2034,11 +2333,6 @@ gtk_weather_run_conditions_dialog(GtkWidget * widget)
 
     data->shown = FALSE;
   } else if (!forecast && location) {
-    gchar * error_msg = NULL;
-
-    error_msg = g_strdup_printf(_("Forecast for %s unavailable."),
-                                (alias) ? alias : _("N/A"));
-
     gtk_weather_run_error_dialog(NULL, (error_msg) ? error_msg : "FAIL!");
 
     g_free(error_msg);
@@ -2049,432 +2343,488 @@ gtk_weather_run_conditions_dialog(GtkWidget * widget)
 }
 
 /**
- * Creates and shows the location retrieval progress bar.
+ * Updates the location progress bar at regular intervals.
  *
- * @param weather Pointer to the instance of this widget.
+ * @param data Pointer to the location thread data
+ *
+ * @return TRUE if this function should be called again, FALSE otherwise
  */
-static void
-gtk_weather_show_location_progress_bar(GtkWeather * weather)
+static gboolean
+gtk_weather_update_ui(gpointer data)
 {
-  LXW_LOG(LXW_DEBUG, "GtkWeather::show_location_progress_bar()");
-
-  GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(weather);
-
-  gchar * progress_str = g_strdup_printf(_("Searching for '%s'..."),
-                                         priv->location_data.location);
-
-  priv->location_data.progress_dialog =
-    gtk_dialog_new_with_buttons(progress_str,
-                                GTK_WINDOW(priv->preferences_data.dialog),
-                                GTK_DIALOG_DESTROY_WITH_PARENT,
-                                GTK_STOCK_CANCEL,
-                                GTK_RESPONSE_CANCEL,
-                                NULL);
-
-  //  gtk_window_set_decorated(GTK_WINDOW(dialog), FALSE);
-
-  GtkWidget * alignment    = gtk_alignment_new(0.5, 0.5, 0.5, 0.5);
-  GtkWidget * progress_bar = gtk_progress_bar_new();
-
-  priv->location_data.progress_bar = GTK_PROGRESS_BAR(progress_bar);
-
-  gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), progress_str);
-
-  gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), 0.2);
+  LXW_LOG(LXW_DEBUG, "GtkWeather::update_ui()");
 
-  gtk_container_add(GTK_CONTAINER(alignment), progress_bar);
+  GtkWeather        * weather = GTK_WEATHER(data);
+  GtkWeatherPrivate * priv    = GTK_WEATHER_GET_PRIVATE(weather);
 
-  gtk_box_pack_start_defaults(GTK_BOX(GTK_DIALOG(priv->location_data.progress_dialog)->vbox),
-                              alignment);
+  /* gtk_weather_set_forecast(weather, priv->forecast_data.pending_forecast); */
+  gtk_weather_render(weather);
 
-  int timer = g_timeout_add(500,
-                            gtk_weather_update_location_progress_bar,
-                            &priv->location_data);
+  gpointer forecast = NULL;
 
-  gtk_widget_show_all(priv->location_data.progress_dialog);
+  if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
+    forecast = forecast_ref(priv->forecast);
 
-  gint response = gtk_dialog_run(GTK_DIALOG(priv->location_data.progress_dialog));
+    pthread_rwlock_unlock(&(priv->rwlock));
+  }
 
-  switch(response) {
-  case GTK_RESPONSE_ACCEPT:
-    break;
+  guint version = (forecast) ? ((ForecastInfo *)forecast)->version_ : 0;
 
-  case GTK_RESPONSE_CANCEL:
-    if (pthread_kill(priv->location_data.thread, 0) != ESRCH) {
-      int ret = pthread_cancel(priv->location_data.thread);
+  /* several publishes may have queued this before it got to run */
+  if (version != priv->published) {
+    priv->published = version;
 
-      if (ret != 0) {
-        LOG_ERRNO(ret, "pthread_cancel");
-      }
-    }
+    /* Emit forecast-changed event, the handlers borrow our reference */
+    g_signal_emit_by_name(weather, "forecast-changed", forecast);
 
-    if (timer) {
-      g_source_remove(timer);
+    /* Update the conditions dialog, if shown */
+    if (priv->conditions_data.shown) {
+      gtk_weather_update_conditions_dialog(weather);
     }
-
-    break;
-
-  default:
-    break;
   }
 
-  if (priv->location_data.progress_dialog) { /* && GTK_IS_WIDGET(dialog)) {*/
-    gtk_widget_destroy(priv->location_data.progress_dialog);
+  forecast_unref(forecast);
 
-    priv->location_data.progress_dialog = NULL;
-  }
-
-  g_free(progress_str);
+  return FALSE;
 }
 
 /**
- * Updates the location progress bar at regular intervals.
+ * Generates the text for the tooltip based on current location and forecast.
+ * The text is kept until the location or the fields it shows change.
  *
- * @param data Pointer to the location thread data
+ * @param widget Pointer to the current instance of the weather widget.
  *
- * @return TRUE if this function should be called again, FALSE otherwise
+ * @return Text to be shown as part of the tooltip. The caller must release
+ *         the memory using g_free.
+ *
+ * @note Only to be called on the main loop, which owns the kept text.
  */
-static gboolean
-gtk_weather_update_location_progress_bar(gpointer data)
+gchar *
+gtk_weather_get_tooltip_text(GtkWidget * widget)
 {
-  LocationThreadData * location_data = (LocationThreadData *)data;
+  GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(GTK_WEATHER(widget));
 
-  LXW_LOG(LXW_DEBUG, "GtkWeather::update_location_progress_bar(): %d percent complete.", 
-          (location_data)?(int)(gtk_progress_bar_get_fraction(location_data->progress_bar) * 100):-1);
+  LXW_LOG(LXW_DEBUG, "GtkWeather::get_tooltip_text()");
 
-  if (!location_data) {
-    return FALSE;
-  }
+  gchar * tooltip_text = NULL;
 
-  gboolean ret = TRUE;
+  LocationInfo * location = NULL;
+  ForecastInfo * forecast = NULL;
+  gchar        * alias    = NULL;
 
-  /* Get the percentage */
+  if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
+    location = (LocationInfo *) priv->location;
+    forecast = (ForecastInfo *) forecast_ref(priv->forecast);
 
-  /* If it's less than 100, check the thread. 
-   * If the thread is still running, increment percentage.
-   * Otherwise, cancel thread - something's wrong.
-   */
-  gint percentage = gtk_progress_bar_get_fraction(location_data->progress_bar) * 100;
+    guint version = (location) ? location->version_ : 0;
 
-  if ( (percentage >= 100) ||
-       (pthread_kill(location_data->thread, 0) == ESRCH) ) {
-    gtk_widget_destroy(location_data->progress_dialog);
+    guint changes = forecast_changes(forecast, priv->tooltip_version);
 
-    location_data->progress_dialog = NULL;    
+    gboolean kept = (location && forecast && priv->tooltip_text &&
+                     version == priv->tooltip_location &&
+                     !(changes & (FORECAST_CHANGED_TEMPERATURE |
+                                  FORECAST_CHANGED_CONDITIONS  |
+                                  FORECAST_CHANGED_DAYS        |
+                                  FORECAST_CHANGED_UNITS)));
 
-    ret = FALSE;
-  } else {
-    percentage += 10;
+    /* the alias is only needed to build a new text */
+    alias = (location && !kept) ? g_strdup(location->alias_) : NULL;
 
-    gtk_progress_bar_set_fraction(location_data->progress_bar, (gdouble)percentage/100);
+    pthread_rwlock_unlock(&(priv->rwlock));
 
-    ret = TRUE;
-  }
-  
-  return ret;
-}
+    if (kept) {
+      /* a refresh that only moved the time or the wind */
+      tooltip_text = g_strdup(priv->tooltip_text);
 
+      priv->tooltip_version = forecast->version_;
+    } else if (location && forecast) {
+      gchar * temperature = g_strdup_printf("%d \302\260%s\n", 
+                                            forecast->temperature_,
+                                            forecast->units_.temperature_);
 
-/**
- * Updates the location progress bar at regular intervals.
- *
- * @param data Pointer to the location thread data
- *
- * @return TRUE if this function should be called again, FALSE otherwise
- */
-static gboolean
-gtk_weather_update_ui(gpointer data)
-{
-  LXW_LOG(LXW_DEBUG, "GtkWeather::update_ui()");
+      gchar * days[FORECAST_MAX_DAYS] = { NULL };
 
-  GtkWeather        * weather = GTK_WEATHER(data);
-  GtkWeatherPrivate * priv    = GTK_WEATHER_GET_PRIVATE(weather);
+      int d = 0;
+      for (; d < FORECAST_MAX_DAYS; d++) {
+        /* decoded on first access only */
+        const ForecastDay * day = forecast_day_get(forecast, d);
 
-  /* gtk_weather_set_forecast(weather, priv->forecast_data.pending_forecast); */
-  gtk_weather_render(weather);
+        /* @TODO: can use the code_ member variable, too */
+        const gchar * actual_day =
+          (day && day->day_) ? day->day_ : "N/A";
+      
+        const gchar * conditions =
+          (day && day->conditions_) ? day->conditions_ : "N/A";
 
-  /* Emit forecast-changed event */
-  g_signal_emit_by_name(weather, "forecast-changed", priv->forecast);
+        days[d] = g_strdup_printf("%s: %s %d\302\260 / %d\302\260",
+                                  _(actual_day),
+                                  _(conditions),
+                                  (day) ? day->low_ : 0,
+                                  (day) ? day->high_ : 0);
+      }
+    
+      /* make it nice and pretty */
+      tooltip_text = g_strconcat(_("Currently in "), alias, ": ",
+                                 _(forecast->conditions_), " ", temperature, "",
+                                 days[FORECAST_DAY_1], "\n",
+                                 days[FORECAST_DAY_2], "\n",
+                                 days[FORECAST_DAY_3], "\n",
+                                 days[FORECAST_DAY_4], "\n",
+                                 days[FORECAST_DAY_5],
+                                 NULL);
+                                 
+      g_free(temperature);
+      g_free(days[FORECAST_DAY_1]);
+      g_free(days[FORECAST_DAY_2]);
+      g_free(days[FORECAST_DAY_3]);
+      g_free(days[FORECAST_DAY_4]);
+      g_free(days[FORECAST_DAY_5]);
 
-  /* Update the conditions dialog, if shown */
-  if (priv->conditions_data.shown) {
-    gtk_weather_update_conditions_dialog(weather);
+      g_free(priv->tooltip_text);
+
+      priv->tooltip_text     = g_strdup(tooltip_text);
+      priv->tooltip_location = version;
+      priv->tooltip_version  = forecast->version_;
+    } else if (location) {
+      tooltip_text = g_strdup_printf(_("Forecast for %s unavailable."),
+                                     alias);
+    } else {
+      tooltip_text = g_strdup_printf(_("Location not set."));
+    }
+
+    forecast_unref(forecast);
+
+    g_free(alias);
   }
 
-  return FALSE;
+  LXW_LOG(LXW_DEBUG, "\tReturning: %s", tooltip_text);
+
+  return tooltip_text;
 }
 
 /**
- * Creates and shows the location list selection dialog.
+ * Sets the icon on the specified window, if the icon id is found.
  *
- * @param weather Pointer to the instance of this widget.
- * @param list   Pointer to the list of retrieved locations.
+ * @param window  Pointer to the GtkWindow to decorate.
+ * @param icon_id The id of the icon to find.
  */
 static void
-gtk_weather_show_location_list(GtkWeather * weather, GList * list)
+gtk_weather_set_window_icon(GtkWindow * window, gchar * icon_id)
 {
-  LXW_LOG(LXW_DEBUG, "GtkWeather::show_location_list(%d)", g_list_length(list));
+  LXW_LOG(LXW_DEBUG, "GtkWeather::set_window_icon(%s)", icon_id);
 
-  GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(weather);
+  if(gtk_icon_theme_has_icon(gtk_icon_theme_get_default(), icon_id)) {
+    GdkPixbuf* window_icon = gtk_icon_theme_load_icon(gtk_icon_theme_get_default(), 
+                                                      icon_id,
+                                                      24, 
+                                                      0,
+                                                      NULL);
 
-  gchar * dialog_str = g_strdup_printf(_("Location matches for '%s'"), 
-                                       priv->location_data.location);
+    gtk_window_set_icon(window, window_icon);
+  }
 
-  GtkWidget * dialog = gtk_dialog_new_with_buttons(dialog_str,
-                                                   GTK_WINDOW(priv->preferences_data.dialog),
-                                                   GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                                   GTK_STOCK_OK, GTK_RESPONSE_ACCEPT,
-                                                   GTK_STOCK_CANCEL, GTK_RESPONSE_REJECT,
-                                                   NULL);
+}
 
-  gtk_widget_set_size_request(dialog, 300, 250);
+/**
+ * The location retrieval thread function. Looks up one type-ahead query on
+ * the network and hands the results to the main loop. Lookups superseded
+ * before they got to run skip the round trip.
+ *
+ * @param arg Pointer to the LocationLookupData for this query.
+ *
+ * @return NULL, the thread is detached.
+ */
+static void *
+gtk_weather_get_location_threadfunc(void * arg)
+{
+  LocationLookupData * lookup = (LocationLookupData *)arg;
 
-  /* Set dialog window icon */
-  gtk_weather_set_window_icon(GTK_WINDOW(dialog), "gtk-properties");
+  if (g_atomic_int_get(&lookup->search->generation) == lookup->generation) {
+    lookup->list = provider_location_find_remote(lookup->location);
+  }
 
-  /* TreeView */
-  GtkWidget * treeview = gtk_tree_view_new();
+  g_idle_add(gtk_weather_location_lookup_arrived, lookup);
 
-  /* city */
-  GtkCellRenderer   * cell_renderer   = gtk_cell_renderer_text_new();
-  GtkTreeViewColumn * treeview_column = gtk_tree_view_column_new_with_attributes(_("City"),
-                                                                                 cell_renderer,
-                                                                                 "text",
-                                                                                 CITY_COLUMN,
-                                                                                 NULL);
+  return NULL;
+}
 
-  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+/**
+ * Releases a reference to the type-ahead search state, freeing it along
+ * with the current results when the last one is gone.
+ *
+ * @param search Pointer to the search state.
+ */
+static void
+gtk_weather_location_search_unref(LocationSearchData * search)
+{
+  if (g_atomic_int_dec_and_test(&search->refcount)) {
+    g_list_free_full(search->list, location_unref);
 
-  /* state */
-  cell_renderer = gtk_cell_renderer_text_new();
-  treeview_column = gtk_tree_view_column_new_with_attributes(_("State"),
-                                                             cell_renderer,
-                                                             "text",
-                                                             STATE_COLUMN,
-                                                             NULL);
+    g_free(search);
+  }
+}
 
-  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+/**
+ * Appends new matches to the location list shown in the dialog. Matches
+ * already listed are skipped. The first match is selected, so that
+ * accepting the dialog right away picks the best candidate.
+ *
+ * @param search Pointer to the search state.
+ * @param list   Pointer to the list of LocationInfo entries. Ownership
+ *               is taken.
+ */
+static void
+gtk_weather_location_search_merge(LocationSearchData * search, GList * list)
+{
+  gboolean empty = (search->list == NULL);
 
-  /* country */
-  cell_renderer = gtk_cell_renderer_text_new();
-  treeview_column = gtk_tree_view_column_new_with_attributes(_("Country"),
-                                                             cell_renderer,
-                                                             "text",
-                                                             COUNTRY_COLUMN,
-                                                             NULL);
+  GList * iter = list;
 
-  gtk_tree_view_append_column(GTK_TREE_VIEW(treeview), treeview_column);
+  while (iter) {
+    LocationInfo * location = (LocationInfo *)iter->data;
 
-  /* TreeView items */
-  GtkListStore * list_store = gtk_list_store_new(MAX_COLUMNS, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+    GList * next = g_list_next(iter);
 
-  GtkTreeIter iterator;
+    GList * known = search->list;
 
-  guint length = g_list_length(list);
+    while (known && 
+           g_strcmp0(((LocationInfo *)known->data)->woeid_, location->woeid_)) {
+      known = g_list_next(known);
+    }
+
+    if (known) {
+      location_unref(location);
+    } else {
+      GtkTreeIter iterator;
 
-  guint index = 0;
+      gtk_list_store_append(search->list_store, &iterator);
 
-  for (; index < length; ++index) {
-    gtk_list_store_append(list_store, &iterator);
+      gtk_list_store_set(search->list_store, &iterator, 
+                         CITY_COLUMN,    location->city_,
+                         STATE_COLUMN,   location->state_,
+                         COUNTRY_COLUMN, location->country_, -1);
 
-    LocationInfo * location = (LocationInfo *)g_list_nth_data(list, index);
+      search->list = g_list_append(search->list, location);
+    }
 
-    gtk_list_store_set(list_store,     &iterator, 
-                       CITY_COLUMN,    location->city_,
-                       STATE_COLUMN,   location->state_,
-                       COUNTRY_COLUMN, location->country_, -1);
+    iter = next;
   }
 
-  /* Set the model behind the tree view, and forget about it */
-  gtk_tree_view_set_model(GTK_TREE_VIEW(treeview), GTK_TREE_MODEL(list_store));
+  g_list_free(list);
 
-  g_object_unref(list_store);
+  if (empty && search->list) {
+    GtkTreePath * path = gtk_tree_path_new_first();
 
-  GtkTreeSelection * selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview));
+    gtk_tree_selection_select_path(gtk_tree_view_get_selection(GTK_TREE_VIEW(search->treeview)),
+                                   path);
 
-  gtk_tree_selection_set_mode(selection, GTK_SELECTION_BROWSE);
+    gtk_tree_path_free(path);
+  }
+}
 
-  /* Internals of the dialog window */
-  GtkWidget * scrolled_window = gtk_scrolled_window_new(NULL, NULL);
-  gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
-                                 GTK_POLICY_AUTOMATIC,
-                                 GTK_POLICY_AUTOMATIC);
+/**
+ * Updates the status line under the location list.
+ *
+ * @param search Pointer to the search state.
+ */
+static void
+gtk_weather_location_search_status(LocationSearchData * search)
+{
+  const gchar * query = gtk_entry_get_text(GTK_ENTRY(search->entry));
 
-  gtk_container_add(GTK_CONTAINER(scrolled_window), treeview);
+  gchar * status = NULL;
 
-  gtk_box_pack_start_defaults(GTK_BOX(GTK_DIALOG(dialog)->vbox), scrolled_window);
+  if (search->list || !*query) {
+    status = g_strdup("");
+  } else if (search->timerid || search->pending) {
+    status = g_strdup_printf(_("Searching for '%s'..."), query);
+  } else {
+    status = g_strdup_printf(_("Location '%s' not found!"), query);
+  }
 
-  gtk_widget_show_all(dialog);
+  gtk_label_set_text(GTK_LABEL(search->status_label), status);
 
-  gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+  g_free(status);
+}
 
-  GtkTreeModel * model;
+/**
+ * Handles edits to the location entry: drops the results and lookups for
+ * the previous text and re-arms the debounce timer.
+ *
+ * @param editable Pointer to the location entry.
+ * @param data     Pointer to the search state.
+ */
+static void
+gtk_weather_location_search_changed(GtkEditable * editable G_GNUC_UNUSED, gpointer data)
+{
+  LocationSearchData * search = (LocationSearchData *)data;
 
-  /* handle selection */
-  switch(response) {
-  case GTK_RESPONSE_ACCEPT:
-    model = gtk_tree_view_get_model(GTK_TREE_VIEW(treeview));
+  if (search->timerid) {
+    g_source_remove(search->timerid);
+  }
 
-    if (gtk_tree_selection_get_selected(selection, &model, &iterator)) {
-      gchar * path = gtk_tree_model_get_string_from_iter(model, &iterator);
+  /* whatever is still in flight is for text that is no longer there */
+  g_atomic_int_inc(&search->generation);
 
-      gint index = (gint)g_ascii_strtoull(path, NULL, 10);
+  search->pending = 0;
 
-      LocationInfo * location = g_list_nth_data(list, index);
+  g_list_free_full(search->list, location_unref);
 
-      /* I could achieve the same effect by calling g_object_set_property
-       * on the weather widget, but it requires an additional
-       * GValue allocation.  I'd rather just execute the call explicitly
-       */
-      gtk_weather_set_location(weather, (gpointer)location, TRUE);
+  search->list = NULL;
 
-      /* This function will only start the thread if it isn't 'active'. */
-      gtk_weather_forecast_thread_start(weather);
+  gtk_list_store_clear(search->list_store);
 
-      /* list of locations is released by the caller */
-      /* preferences dialog is also repainted by caller */
-      g_free(path);
-    }
-      
-    break;
+  search->timerid = g_timeout_add(LOCATION_SEARCH_DELAY,
+                                  gtk_weather_location_search_timerfunc,
+                                  search);
 
-  default:
-    break;
-  }
-  
-  if (GTK_IS_WIDGET(dialog)) {
-    gtk_widget_destroy(dialog);
-  }
-  
-  g_free(dialog_str);
+  gtk_weather_location_search_status(search);
 }
 
 /**
- * Generates the text for the tooltip based on current location and forecast.
+ * Runs the type-ahead search once typing pauses. Local matches are listed
+ * immediately, the network lookup streams its matches in when it returns.
  *
- * @param widget Pointer to the current instance of the weather widget.
+ * @param data Pointer to the search state.
  *
- * @return Text to be shown as part of the tooltip. The caller must release
- *         the memory using g_free.
+ * @return FALSE, the timer is one-shot.
  */
-gchar *
-gtk_weather_get_tooltip_text(GtkWidget * widget)
+static gboolean
+gtk_weather_location_search_timerfunc(gpointer data)
 {
-  GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(GTK_WEATHER(widget));
+  LocationSearchData * search = (LocationSearchData *)data;
 
-  LXW_LOG(LXW_DEBUG, "GtkWeather::get_tooltip_text()");
+  search->timerid = 0;
 
-  gchar * tooltip_text = NULL;
+  const gchar * query = gtk_entry_get_text(GTK_ENTRY(search->entry));
 
-  LocationInfo * location = NULL;
-  ForecastInfo * forecast = NULL;
+  LXW_LOG(LXW_DEBUG, "GtkWeather::location_search(%s)", query);
 
-  if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
-    location = (LocationInfo *) priv->location;
-    forecast = (ForecastInfo *) priv->forecast;
+  if (*query) {
+    /* suggestions, the network lookup below runs regardless */
+    gtk_weather_location_search_merge(search, provider_location_find_local(query, NULL));
+  }
 
-    if (location && forecast) {
-      gchar * temperature = g_strdup_printf("%d \302\260%s\n", 
-                                            forecast->temperature_,
-                                            forecast->units_.temperature_);
+  if (g_utf8_strlen(query, -1) >= LOCATION_SEARCH_REMOTE_MIN) {
+    LocationLookupData * lookup = g_new0(LocationLookupData, 1);
 
-      gchar * days[FORECAST_MAX_DAYS] = { NULL };
+    lookup->search     = search;
+    lookup->generation = g_atomic_int_get(&search->generation);
+    lookup->location   = g_strdup(query);
 
-      int d = 0;
-      for (; d < FORECAST_MAX_DAYS; d++) {
-        /* @TODO: can use the code_ member variable, too */
-        const gchar * actual_day =
-          (forecast->days_[d].day_) ? forecast->days_[d].day_ : "N/A";
-      
-        const gchar * conditions =
-          (forecast->days_[d].conditions_) ? forecast->days_[d].conditions_ : "N/A";
+    g_atomic_int_inc(&search->refcount);
 
-        days[d] = g_strdup_printf("%s: %s %d\302\260 / %d\302\260",
-                                  _(actual_day),
-                                  _(conditions),
-                                  forecast->days_[d].low_,
-                                  forecast->days_[d].high_);
-      }
-    
-      /* make it nice and pretty */
-      tooltip_text = g_strconcat(_("Currently in "),location->alias_, ": ",
-                                 _(forecast->conditions_), " ", temperature, "",
-                                 days[FORECAST_DAY_1], "\n",
-                                 days[FORECAST_DAY_2], "\n",
-                                 days[FORECAST_DAY_3], "\n",
-                                 days[FORECAST_DAY_4], "\n",
-                                 days[FORECAST_DAY_5],
-                                 NULL);
-                                 
-      g_free(temperature);
-      g_free(days[FORECAST_DAY_1]);
-      g_free(days[FORECAST_DAY_2]);
-      g_free(days[FORECAST_DAY_3]);
-      g_free(days[FORECAST_DAY_4]);
-      g_free(days[FORECAST_DAY_5]);
-    } else if (location) {
-      tooltip_text = g_strdup_printf(_("Forecast for %s unavailable."),
-                                     location->alias_);
+    pthread_t      thread;
+    pthread_attr_t tattr;
+
+    pthread_attr_init(&tattr);
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+
+    int ret = pthread_create(&thread, &tattr, &gtk_weather_get_location_threadfunc, lookup);
+
+    if (ret != 0) {
+      LOG_ERRNO(ret, "pthread_create");
+
+      g_free(lookup->location);
+      g_free(lookup);
+
+      gtk_weather_location_search_unref(search);
     } else {
-      tooltip_text = g_strdup_printf(_("Location not set."));
+      ++search->pending;
     }
 
-    pthread_rwlock_unlock(&(priv->rwlock));
+    pthread_attr_destroy(&tattr);
   }
 
-  LXW_LOG(LXW_DEBUG, "\tReturning: %s", tooltip_text);
+  gtk_weather_location_search_status(search);
 
-  return tooltip_text;
+  return FALSE;
 }
 
 /**
- * Sets the icon on the specified window, if the icon id is found.
+ * Delivers the results of a network lookup to the dialog, on the main loop.
+ * Results for text that has since changed, or for a dialog that has since
+ * closed, are discarded.
  *
- * @param window  Pointer to the GtkWindow to decorate.
- * @param icon_id The id of the icon to find.
+ * @param data Pointer to the LocationLookupData of the finished lookup.
+ *
+ * @return FALSE, this is a one-shot idle callback.
  */
-static void
-gtk_weather_set_window_icon(GtkWindow * window, gchar * icon_id)
+static gboolean
+gtk_weather_location_lookup_arrived(gpointer data)
 {
-  LXW_LOG(LXW_DEBUG, "GtkWeather::set_window_icon(%s)", icon_id);
+  LocationLookupData * lookup = (LocationLookupData *)data;
+  LocationSearchData * search = lookup->search;
 
-  if(gtk_icon_theme_has_icon(gtk_icon_theme_get_default(), icon_id)) {
-    GdkPixbuf* window_icon = gtk_icon_theme_load_icon(gtk_icon_theme_get_default(), 
-                                                      icon_id,
-                                                      24, 
-                                                      0,
-                                                      NULL);
+  if (search->dialog && 
+      lookup->generation == g_atomic_int_get(&search->generation)) {
+    --search->pending;
 
-    gtk_window_set_icon(window, window_icon);
+    gtk_weather_location_search_merge(search, lookup->list);
+
+    gtk_weather_location_search_status(search);
+  } else {
+    LXW_LOG(LXW_DEBUG, "GtkWeather::location_lookup_arrived(%s): superseded",
+            lookup->location);
+
+    g_list_free_full(lookup->list, location_unref);
   }
 
+  gtk_weather_location_search_unref(search);
+
+  g_free(lookup->location);
+  g_free(lookup);
+
+  return FALSE;
 }
 
 /**
- * The location retrieval thread function.
+ * Accepts the location dialog when a match is double-clicked.
  *
- * @param arg Pointer to argument data.
+ * @param treeview Pointer to the list of matches.
+ * @param path     Pointer to the path of the activated row.
+ * @param column   Pointer to the activated column.
+ * @param data     Pointer to the location dialog.
+ */
+static void
+gtk_weather_location_row_activated(GtkTreeView       * treeview G_GNUC_UNUSED,
+                                   GtkTreePath       * path G_GNUC_UNUSED,
+                                   GtkTreeViewColumn * column G_GNUC_UNUSED,
+                                   gpointer            data)
+{
+  gtk_dialog_response(GTK_DIALOG(data), GTK_RESPONSE_ACCEPT);
+}
+
+/**
+ * Retrieves the match currently selected in the location list.
  *
- * @return Data based on thread completion.
+ * @param search Pointer to the search state.
+ *
+ * @return Pointer to the selected LocationInfo, owned by the search, or
+ *         NULL if nothing is selected.
  */
-static void *
-gtk_weather_get_location_threadfunc(void * arg)
+static LocationInfo *
+gtk_weather_location_search_selected(LocationSearchData * search)
 {
-  gchar * location = (gchar *)arg;
-  
-  GList * list = yahooutil_location_find(location);
+  GtkTreeSelection * selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(search->treeview));
 
-  GList * iter = g_list_first(list);
-  while (iter) {
-    location_property_set(iter->data,
-                          "alias",
-                          location,
-                          (location) ? strlen(location) : 0);
+  GtkTreeModel * model = NULL;
+
+  GtkTreeIter iterator;
+
+  LocationInfo * location = NULL;
+
+  if (gtk_tree_selection_get_selected(selection, &model, &iterator)) {
+    gchar * path = gtk_tree_model_get_string_from_iter(model, &iterator);
 
-    iter = g_list_next(iter);
+    gint index = (gint)g_ascii_strtoull(path, NULL, 10);
+
+    location = (LocationInfo *)g_list_nth_data(search->list, index);
+
+    g_free(path);
   }
-  
-  return list;  
+
+  return location;
 }
 
 // ----------- forecast retrieval functions begin here --------
@@ -2536,8 +2886,6 @@ gtk_weather_forecast_thread_stop(GtkWeather * weather)
 {
   GtkWeatherPrivate * priv = GTK_WEATHER_GET_PRIVATE(weather);
 
-  /* location thread stuff is here as a protective measure */
-  LocationThreadData * ltdata = &(priv->location_data);
   ForecastThreadData * ftdata = &(priv->forecast_data);
 
   LocationInfo * location = NULL;
@@ -2550,7 +2898,6 @@ gtk_weather_forecast_thread_stop(GtkWeather * weather)
 
   int rc = 0;
   
-  ltdata->active = 0;
   ftdata->active = 0;
 
   // thread timer, first
@@ -2600,6 +2947,8 @@ gtk_weather_get_forecast(GtkWidget * widget)
       guint interval_in_seconds = 60 * ((location->interval_) ?
                                         location->interval_ : 1);
 
+      fleet_schedule(location->woeid_, interval_in_seconds / 60);
+
       if (priv->forecast_data.timerid > 0) {
         g_source_remove(priv->forecast_data.timerid);
       }
@@ -2608,10 +2957,16 @@ gtk_weather_get_forecast(GtkWidget * widget)
         g_timeout_add_seconds(interval_in_seconds,
                               gtk_weather_get_forecast_timerfunc,
                               (gpointer)widget);
-    } else if (priv->forecast_data.timerid > 0) {
-      g_source_remove(priv->forecast_data.timerid);
+    } else {
+      if (location) {
+        fleet_schedule(location->woeid_, 0);
+      }
 
-      priv->forecast_data.timerid = 0;
+      if (priv->forecast_data.timerid > 0) {
+        g_source_remove(priv->forecast_data.timerid);
+
+        priv->forecast_data.timerid = 0;
+      }
     }
 
     if (location) {
@@ -2679,6 +3034,93 @@ gtk_weather_get_forecast_timerfunc(gpointer data)
   return enabled;
 }
 
+/**
+ * Stores a forecast delivered by the refresh pipeline, unless the location
+ * changed while it was being retrieved, or a later request was made. Runs
+ * on the publish stage.
+ *
+ * @param woeid    The WOEID the forecast was requested for.
+ * @param forecast Pointer to the new forecast, owned by the pipeline.
+ * @param digest   The digest of the response behind the forecast.
+ * @param data     Pointer to the ForecastRequestData of the request.
+ */
+static void
+gtk_weather_forecast_arrived(const gchar * woeid,
+                             gpointer      forecast,
+                             guint64       digest,
+                             gpointer      data)
+{
+  ForecastRequestData * request = (ForecastRequestData *)data;
+
+  GtkWeather        * weather = request->weather;
+  GtkWeatherPrivate * priv    = GTK_WEATHER_GET_PRIVATE(weather);
+
+  gboolean current  = FALSE;
+  gpointer previous = NULL;
+
+  if (pthread_rwlock_wrlock(&(priv->rwlock)) == 0) {
+    LocationInfo * location = (LocationInfo *) priv->location;
+
+    /* requests overlap, and may finish in any order: only the newest one,
+     * for the location and units shown now, gets to publish */
+    current = (location && !g_strcmp0(location->woeid_, woeid) &&
+               location->version_ == request->version &&
+               request->generation == g_atomic_int_get(&priv->forecast_data.generation));
+
+    if (current) {
+      /* publishing is a pointer swap, the pipeline keeps its own reference */
+      previous = priv->forecast;
+
+      priv->forecast = forecast_ref(forecast);
+
+      priv->forecast_data.digest = digest;
+    }
+
+    pthread_rwlock_unlock(&(priv->rwlock));
+  }
+
+  forecast_unref(previous);
+
+  if (current) {
+    /* render on main thread */
+    g_idle_add(gtk_weather_update_ui, weather);
+  } else {
+    LXW_LOG(LXW_DEBUG, "GtkWeather::forecast_arrived(%s): superseded", woeid);
+  }
+}
+
+/**
+ * Releases the request data of a refresh, with the reference it held on
+ * the weather instance. The reference is dropped on the main loop, as it
+ * may be the last one.
+ *
+ * @param data Pointer to the ForecastRequestData of the request.
+ */
+static void
+gtk_weather_release(gpointer data)
+{
+  g_idle_add(gtk_weather_release_idle, data);
+}
+
+/**
+ * Frees the request data of a refresh on the main loop.
+ *
+ * @param data Pointer to the ForecastRequestData of the request.
+ *
+ * @return FALSE, so that the function is not called again.
+ */
+static gboolean
+gtk_weather_release_idle(gpointer data)
+{
+  ForecastRequestData * request = (ForecastRequestData *)data;
+
+  g_object_unref(request->weather);
+
+  g_free(request);
+
+  return FALSE;
+}
+
 /**
  * The forecast retrieval thread function.
  *
@@ -2730,12 +3172,18 @@ gtk_weather_get_forecast_threadfunc(void * arg)
 
     const gchar  * woeid    = NULL;
     gchar          units    = 'f';
+    guint64        digest   = 0;
+    gpointer       forecast = NULL;
 
     if (pthread_rwlock_rdlock(&(priv->rwlock)) == 0) {
-      location = (LocationInfo *) priv->location;
+      /* the woeid is used unlocked, keep the location it belongs to */
+      location = (LocationInfo *) location_ref(priv->location);
 
-      woeid = location->woeid_;
-      units = location->units_;
+      /* without a forecast to keep, the response must be parsed */
+      digest = (priv->forecast) ? ftdata->digest : 0;
+
+      /* the new forecast is parsed over the current one */
+      forecast = forecast_ref(priv->forecast);
 
       pthread_rwlock_unlock(&(priv->rwlock));
     } else {
@@ -2744,24 +3192,38 @@ gtk_weather_get_forecast_threadfunc(void * arg)
       continue;
     }
 
+    if (!location) {
+      forecast_unref(forecast);
+
+      continue;
+    }
+
+    woeid = location->woeid_;
+    units = location->units_;
+
     LXW_LOG(LXW_DEBUG, "\tgetting forecast for %s", woeid);
 
-    ForecastInfo * forecast = NULL;
-    yahooutil_forecast_get(woeid, units, &forecast);
+    /* Fetching, parsing and decoding the image happen in the refresh
+     * pipeline, this thread only decides when to refresh. */
+    ForecastRequestData * request = g_new(ForecastRequestData, 1);
 
-    if (forecast) {
-      if (pthread_rwlock_wrlock(&(priv->rwlock)) == 0) {
-        forecast_copy(&(priv->forecast), forecast);
+    g_atomic_int_inc(&ftdata->generation);
 
-        pthread_rwlock_unlock(&(priv->rwlock));
-      }
+    request->weather    = g_object_ref(weather);
+    request->generation = g_atomic_int_get(&ftdata->generation);
+    request->version    = location->version_;
 
-      /* render on main thread */
-      g_idle_add(gtk_weather_update_ui, weather);
+    refresh_request(woeid,
+                    units,
+                    digest,
+                    forecast,
+                    gtk_weather_forecast_arrived,
+                    request,
+                    gtk_weather_release);
 
-      forecast_free(forecast);
-    }
+    forecast_unref(forecast);
 
+    location_unref(location);
   }
 
   return NULL;
@@ -20,34 +20,40 @@
 
 /* Provides utilities to use Yahoo's weather services */
 
+#include "arena.h"
 #include "httputil.h"
+#include "yahooutil.h"
 #include "location.h"
 #include "forecast.h"
 #include "logutil.h"
+#include "textutil.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <locale.h>
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
 #include <libxml/xpath.h>
 #include <libxml/xmlstring.h>
-#include <libxml/uri.h>
 
 #include <pthread.h>
 
 #include <glib.h>
 
 #include <gtk/gtk.h>
-#include <gio/gio.h>
 
 #define XMLCHAR_P(x)      (xmlChar *)(x)
 #define CONSTXMLCHAR_P(x) (const xmlChar *)(x)
 #define CONSTCHAR_P(x)    (const char *)(x)
 #define CHAR_P(x)         (char *)(x)
 
+/* Scratch space for attribute values that cannot be read in place */
+#define ATTRIBUTE_BUFSZ   256
+
+#define ATTRIBUTE_PEEK(node, name) \
+  attribute_value_peek((node), (name), attrbuf, sizeof(attrbuf))
+
 #define WOEID_QUERY       "SELECT%20*%20FROM%20geo.placefinder%20WHERE%20text="
 #define FORECAST_QUERY_P1 "SELECT%20*%20FROM%20weather.forecast%20WHERE%20woeid="
 #define FORECAST_QUERY_P2 "%20and%20u="
@@ -63,6 +69,14 @@
 
 static gint g_initialized = 0;
 
+/* Parts of a YQL response that differ on every request */
+static const ProviderSpan g_volatile_spans[] = {
+  PROVIDER_SPAN("yahoo:created=\"", "\""),
+  PROVIDER_SPAN("<diagnostics",     "</diagnostics>"),
+  PROVIDER_SPAN("<lastBuildDate>",  "</lastBuildDate>"),
+  PROVIDER_SPAN("<!--",             "-->")
+};
+
 /**
  * Generates the WOEID query string
  *
@@ -105,186 +119,178 @@ forecast_query_gen(gchar * query, const gchar * woeid, const gchar units)
 }
 
 /**
- * Converts the passed-in string from UTF-8 to ASCII for http transmisison.
+ * Parses a decimal integer without going through strtoll. Leading
+ * whitespace and a sign are accepted, parsing stops at the first non-digit.
  *
- * @param instr String to convert
+ * @param str      The string to parse, may be NULL.
+ * @param fallback The value to return if there are no digits to parse.
  *
- * @return The converted string which MUST BE FREED BY THE CALLER.
+ * @return The parsed value, or the fallback.
  */
-static gchar *
-locale_to_ascii(const gchar *instr)
+static gint
+integer_parse(const gchar * str, gint fallback)
 {
-  // for UTF-8 to ASCII conversions
-  setlocale(LC_CTYPE, "en_US");
-
-  GError * pError = NULL;
-
-  gsize readsz  = 0;
-  gsize writesz = 0;
-
-  gchar * outstr = g_convert(instr,
-                             strlen(instr),
-                             "ASCII//TRANSLIT",
-                             "UTF-8",
-                             &readsz,
-                             &writesz,
-                             &pError);
-
-  if (pError) {
-    LXW_LOG(LXW_ERROR, "yahooutil::locale_to_ascii(%s): Error: %s", 
-            instr, pError->message);
-
-    g_error_free(pError);
-
-    outstr = g_strndup(instr, strlen(instr));
+  if (!str) {
+    return fallback;
   }
 
-  // now escape space, if any
-  xmlChar * escapedstr = xmlURIEscapeStr((const xmlChar *)outstr, NULL);
-
-  if (escapedstr) {
-    // release ConvertedString, reset it, then release EscapedString.
-    // I know it's confusing, but keeps everything as a gchar and g_free
-    g_free(outstr);
+  while (*str == ' ' || *str == '\t') {
+    ++str;
+  }
 
-    outstr = g_strndup((const gchar *)escapedstr,
-                       strlen((const gchar *)escapedstr));
+  gboolean negative = (*str == '-');
 
-    xmlFree(escapedstr);
+  if (*str == '-' || *str == '+') {
+    ++str;
   }
 
-  // restore locale to default
-  setlocale(LC_CTYPE, "");
+  if (*str < '0' || *str > '9') {
+    return fallback;
+  }
 
-  return outstr;
-}
+  gint64 value = 0;
 
-/**
- * Compares two strings and then sets the storage variable to the second
- * value if the two do not match. The storage variable is cleared first.
- *
- * @param dststr Pointer to the storage location with the first value.
- * @param srcstr The second string.
- * @param srclen The length of the second string.
- *
- * @return 0 on succes, -1 on failure.
- */
-static gint
-string_if_different_set(gchar ** dststr, 
-                        const gchar * srcstr,
-                        const gsize srclen)
-{
-  // if diffrent, clear and set
-  if (g_strcmp0(*dststr, srcstr)) {
-    g_free(*dststr);
+  for (; *str >= '0' && *str <= '9'; ++str) {
+    value = value * 10 + (*str - '0');
 
-    *dststr = g_strndup(srcstr, srclen);
+    if (value > G_MAXINT) {
+      value = G_MAXINT;
+    }
   }
 
-  return 0;
+  return (gint)((negative) ? -value : value);
 }
 
 /**
- * Compares the URL of an image to the 'new' value. If the two
- * are different, the image at the 'new' URL is retrieved and replaces
- * the old one. The old one is freed.
+ * Parses a fixed-point decimal number (e.g. 29.92 or 1015.0) by
+ * accumulating an integer mantissa and scaling it once at the end.
+ * Up to nine fractional digits are significant, the rest are ignored.
+ * An integer part too long for the mantissa is left to g_ascii_strtod().
  *
- * @param dsturl    Pointer to the storage location with the first value.
- * @param image     Pointer to the image storage.
- * @param newurl    The new url.
- * @param newurllen The length of the new URL.
+ * @param str The string to parse, may be NULL.
  *
- * @return 0 on succes, -1 on failure.
+ * @return The parsed value, or 0 if there is nothing to parse.
  */
-static gint
-image_if_different_set(gchar       ** dsturl,
-                       GdkPixbuf   ** image,
-                       const gchar * newurl,
-                       const gsize newurllen)
+static gdouble
+decimal_parse(const gchar * str)
 {
-  GInputStream * instream = NULL;
-  int err = 0;
-
-  // if diffrent, clear and set
-  if (g_strcmp0(*dsturl, newurl)) {
-    g_free(*dsturl);
-
-    *dsturl = g_strndup(newurl, newurllen);
-
-    if (*image) {
-      g_object_unref(*image);
-
-      *image = NULL;
-    }
-      
-    // retrieve the URL and create the new image
-    gint rc      = 0;
-    gint datalen = 0;
-
-    gpointer response = httputil_url_get(newurl, &rc, &datalen);
+  static const gdouble scale[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
 
-    if (!response || rc != HTTP_STATUS_OK) {
-      LXW_LOG(LXW_ERROR, "yahooutil::image_if_different_set(): Failed to get URL (%d, %d)", 
-              rc, datalen);
+  if (!str) {
+    return 0;
+  }
 
-      return -1;
-    }
+  while (*str == ' ' || *str == '\t') {
+    ++str;
+  }
 
-    instream = g_memory_input_stream_new_from_data(response,
-                                                   datalen,
-                                                   g_free);
+  const gchar * start = str;
 
-    GError * pError = NULL;
+  gboolean negative = (*str == '-');
 
-    *image = gdk_pixbuf_new_from_stream(instream,
-                                        NULL,
-                                        &pError);
+  if (*str == '-' || *str == '+') {
+    ++str;
+  }
 
-    if (!*image) {
-      LXW_LOG(LXW_ERROR,
-              "yahooutil::image_if_different_set(): PixBuff allocation failed: %s",
-              pError->message);
+  gint64 mantissa = 0;
+  gint   fraction = 0;
 
-      g_error_free(pError);
-          
-      err = -1;
+  for (; *str >= '0' && *str <= '9'; ++str) {
+    if (mantissa >= G_MAXINT) {
+      /* rare enough not to be worth a wider mantissa */
+      return g_ascii_strtod(start, NULL);
     }
 
-    if (!g_input_stream_close(instream, NULL, &pError)) {
-      LXW_LOG(LXW_ERROR,
-              "yahooutil::image_if_different_set(): InputStream closure failed: %s",
-              pError->message);
+    mantissa = mantissa * 10 + (*str - '0');
+  }
 
-      g_error_free(pError);
+  if (*str == '.') {
+    for (++str; *str >= '0' && *str <= '9'; ++str) {
+      if (fraction < 9 && mantissa < G_MAXINT) {
+        mantissa = mantissa * 10 + (*str - '0');
 
-      err = -1;
-    } else {
-      g_object_unref(instream);
+        ++fraction;
+      }
     }
-      
   }
 
-  return err;
+  gdouble value = (gdouble)mantissa / scale[fraction];
+
+  return (negative) ? -value : value;
 }
 
 /**
- * Compares an integer to a converted string and then sets the storage variable
- * to the second value if the two do not match.
+ * Sets the storage variable to the integer value of the passed-in string,
+ * if they differ. The storage holds the value of the previous forecast.
  *
  * @param dst    Pointer to the storage location with the first value.
  * @param srcstr The second string.
  *
- * @return 0 on succes, -1 on failure.
+ * @return 1 if the value changed, 0 otherwise.
  */
 static gint
 int_if_different_set(gint * dst, const gchar * srcstr)
 {
-  gint value = (gint)g_ascii_strtoll((srcstr)?srcstr:"0", NULL, 10);
+  gint value = integer_parse(srcstr, 0);
+
+  if (*dst == value) {
+    return 0;
+  }
 
-  /* set, regardless, the check is more expensive */
   *dst = value;
 
-  return 0;
+  return 1;
+}
+
+/**
+ * Returns the value of the named attribute without copying it.
+ *
+ * The parser stores a plain attribute value as a single text node, so the
+ * value can be read straight out of that node. Values split across several
+ * nodes (entity references) are rare and get flattened into the supplied
+ * buffer instead.
+ *
+ * @param node  Pointer to the XML element node.
+ * @param name  Name of the attribute to find.
+ * @param buf   Scratch buffer for the rare, flattened case.
+ * @param bufsz Size of the scratch buffer.
+ *
+ * @return Pointer to the value, owned by the document or the buffer, or NULL
+ *         if the attribute is not present.
+ */
+static const gchar *
+attribute_value_peek(xmlNodePtr    node,
+                     const char  * name,
+                     gchar       * buf,
+                     gsize         bufsz)
+{
+  xmlAttrPtr attr = node->properties;
+
+  for (; attr != NULL; attr = attr->next) {
+    if (!xmlStrEqual(attr->name, CONSTXMLCHAR_P(name))) {
+      continue;
+    }
+
+    xmlNodePtr text = attr->children;
+
+    if (!text) {
+      return "";
+    }
+
+    if (text->type == XML_TEXT_NODE && !text->next) {
+      return CONSTCHAR_P(text->content);
+    }
+
+    xmlChar * value = xmlNodeListGetString(node->doc, text, 1);
+
+    g_strlcpy(buf, (value) ? CONSTCHAR_P(value) : "", bufsz);
+
+    xmlFree(value);
+
+    return buf;
+  }
+
+  return NULL;
 }
 
 /**
@@ -294,14 +300,14 @@ int_if_different_set(gint * dst, const gchar * srcstr)
  *
  * @return A newly created LocationInfo entry on success, or NULL on failure.
  */
-static gpointer
+gpointer
 result_node_process(xmlNodePtr node)
 {
   if (!node) {
     return NULL;
   }
 
-  LocationInfo * location = (LocationInfo *)g_try_new0(LocationInfo, 1);
+  LocationInfo * location = (LocationInfo *)location_new();
 
   if (!location) {
     return NULL;
@@ -335,11 +341,12 @@ result_node_process(xmlNodePtr node)
  *
  * @param forecast Pointer to the pointer to the ForecastInfo entry being filled.
  * @param node     Pointer to the XML Item Node.
+ * @param strings  Pointer to the builder collecting the forecast's strings.
  *
  * @return 0 on success, -1 on failure
  */
 static gint
-item_node_process(gpointer * forecast, xmlNodePtr node)
+item_node_process(gpointer * forecast, xmlNodePtr node, ForecastStrings * strings)
 {
   if (!node || !forecast) {
     return -1;
@@ -349,26 +356,28 @@ item_node_process(gpointer * forecast, xmlNodePtr node)
 
   xmlNodePtr curr = node->xmlChildrenNode;
 
+  gchar attrbuf[ATTRIBUTE_BUFSZ];
+
+  /* days are kept in compact form, decoded only when someone looks */
+  GString * days = g_string_sized_new(256);
+
   int forecastcnt = 0;
 
   for (; curr != NULL; curr = curr->next){
     if (curr->type == XML_ELEMENT_NODE) {
       if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("condition"))) {
-        const char * date = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("date")));
-        const char * temp = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("temp")));
-        const char * text = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("text")));
+        /* each value is consumed before the next one is peeked */
+        const char * date = ATTRIBUTE_PEEK(curr, "date");
+
+        forecast_strings_add(strings, &(info->time_), date, (date)?strlen(date):0);
 
-        gsize datelen = ((date)?strlen(date):0);
-        gsize textlen = ((text)?strlen(text):0);
+        const char * text = ATTRIBUTE_PEEK(curr, "text");
 
-        string_if_different_set(&(info->time_),       date, datelen);
-        string_if_different_set(&(info->conditions_), text, textlen);
+        forecast_strings_intern(strings, &(info->conditions_), text, (text)?strlen(text):0);
 
-        int_if_different_set(&(info->temperature_), temp);
+        int_if_different_set(&(info->temperature_), ATTRIBUTE_PEEK(curr, "temp"));
 
-        xmlFree(XMLCHAR_P(date));
-        xmlFree(XMLCHAR_P(temp));
-        xmlFree(XMLCHAR_P(text));
+        int_if_different_set(&(info->code_), ATTRIBUTE_PEEK(curr, "code"));
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("description"))) {
         char * content = CHAR_P(xmlNodeListGetString(curr->doc,
                                                      curr->xmlChildrenNode, 
@@ -376,47 +385,34 @@ item_node_process(gpointer * forecast, xmlNodePtr node)
           
         char * saveptr = NULL;
 
-        // need to skip quotes ("), both of them
-        strtok_r(content, "\"", &saveptr);
-        char * url = strtok_r(NULL, "\"", &saveptr);
+        // need to skip quotes ("), both of them; an empty element has none
+        char * url = (content && strtok_r(content, "\"", &saveptr)) ?
+          strtok_r(NULL, "\"", &saveptr) : NULL;
 
         // found the image
         if (url && strstr(url, "yimg.com")) {
           LXW_LOG(LXW_DEBUG, "yahooutil::item_node_process(): IMG URL: %s",
                   url);
 
-          image_if_different_set(&info->imageURL_, 
-                                 &info->image_,
-                                 url, 
-                                 strlen(url));
+          /* the image itself is retrieved by the image cache */
+          forecast_strings_intern(strings, &info->imageURL_, url, strlen(url));
         }
                   
         xmlFree(XMLCHAR_P(content));
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("forecast"))) {
-        const char * day  = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("day")));
-        const char * high = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("high")));
-        const char * low  = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("low")));
-        const char * text = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("text")));
-        const char * code = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("code")));
+        /* record layout: day, high, low, code, text, each NUL-terminated */
+        static const char * fields[] = { "day", "high", "low", "code", "text" };
 
-        gsize daylen  = ((day)?strlen(day):0);
-        gsize textlen = ((text)?strlen(text):0);
+        gsize f = 0;
+        for (; f < G_N_ELEMENTS(fields); ++f) {
+          const char * value = ATTRIBUTE_PEEK(curr, fields[f]);
 
-        string_if_different_set(&(info->days_[forecastcnt].day_),        day,  daylen);
-        string_if_different_set(&(info->days_[forecastcnt].conditions_), text, textlen);
-
-        int_if_different_set(&(info->days_[forecastcnt].high_), high);
-        int_if_different_set(&(info->days_[forecastcnt].low_),  low);
-        int_if_different_set(&(info->days_[forecastcnt].code_), code);
+          g_string_append(days, (value) ? value : "");
+          g_string_append_c(days, '\0');
+        }
 
         forecastcnt++;
 
-        xmlFree(XMLCHAR_P(day));
-        xmlFree(XMLCHAR_P(high));
-        xmlFree(XMLCHAR_P(low));
-        xmlFree(XMLCHAR_P(text));
-        xmlFree(XMLCHAR_P(code));
-
         if (forecastcnt >= FORECAST_MAX_DAYS) {
           /* just to be on the safe side... */
           break;
@@ -427,6 +423,12 @@ item_node_process(gpointer * forecast, xmlNodePtr node)
 
   }
 
+  if (forecastcnt) {
+    forecast_strings_add(strings, &(info->daysRaw_), days->str, days->len);
+  }
+
+  g_string_free(days, TRUE);
+
   return 0;
 }
 
@@ -435,9 +437,11 @@ item_node_process(gpointer * forecast, xmlNodePtr node)
  * Processes the passed-in node to generate a ForecastInfo entry
  *
  * @param node     Pointer to the XML Channel Node.
- * @param forecast Pointer to the ForecastInfo entry to be filled in.
+ * @param forecast Pointer to the ForecastInfo entry to be filled in. Its
+ *                 reference is taken over on success.
  *
- * @return A newly created ForecastInfo entry on success, or NULL on failure.
+ * @return The filled in ForecastInfo entry, which replaces the one passed
+ *         in, on success, or NULL on failure.
  */
 static gpointer
 channel_node_process(xmlNodePtr node, ForecastInfo * forecast)
@@ -448,6 +452,13 @@ channel_node_process(xmlNodePtr node, ForecastInfo * forecast)
 
   xmlNodePtr curr = node->xmlChildrenNode;
 
+  gchar attrbuf[ATTRIBUTE_BUFSZ];
+
+  /* every string of this forecast ends up in the forecast's allocation */
+  ForecastStrings strings;
+
+  forecast_strings_begin(&strings);
+
   for (; curr != NULL; curr = curr->next) {
     if (curr->type == XML_ELEMENT_NODE) {
       if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("title"))) {
@@ -456,7 +467,8 @@ channel_node_process(xmlNodePtr node, ForecastInfo * forecast)
                                                      curr->xmlChildrenNode, 
                                                      1));
               
-        if (strstr(content, "Error")) {
+        /* an empty title has no content at all */
+        if (content && strstr(content, "Error")) {
           xmlFree(XMLCHAR_P(content));
                   
           do {
@@ -474,137 +486,102 @@ channel_node_process(xmlNodePtr node, ForecastInfo * forecast)
 
               LXW_LOG(LXW_ERROR,
                       "yahooutil::channel_node_process(): Forecast retrieval error: %s",
-                      content);
+                      (content) ? content : "");
 
               xmlFree(XMLCHAR_P(content));
             }
           }
 
+          forecast_strings_discard(&strings);
+
           return NULL;
         }
         
         xmlFree(XMLCHAR_P(content));
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("item"))) {
         /* item child element gets 'special' treatment */
-        item_node_process((gpointer *)&forecast, curr);
+        item_node_process((gpointer *)&forecast, curr, &strings);
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("units"))) {
         // distance
-        const char * distance = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("distance")));
+        const char * distance = ATTRIBUTE_PEEK(curr, "distance");
 
         gsize distancelen = ((distance)?strlen(distance):0);
 
-        string_if_different_set(&forecast->units_.distance_, distance, distancelen);
-
-        xmlFree(XMLCHAR_P(distance));
+        forecast_strings_intern(&strings, &forecast->units_.distance_, distance, distancelen);
 
         // pressure
-        const char * pressure = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("pressure")));
+        const char * pressure = ATTRIBUTE_PEEK(curr, "pressure");
 
         gsize pressurelen = ((pressure)?strlen(pressure):0);
 
-        string_if_different_set(&forecast->units_.pressure_, pressure, pressurelen);
-
-        xmlFree(XMLCHAR_P(pressure));
+        forecast_strings_intern(&strings, &forecast->units_.pressure_, pressure, pressurelen);
 
         // speed
-        const char * speed = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("speed")));
+        const char * speed = ATTRIBUTE_PEEK(curr, "speed");
 
         gsize speedlen = ((speed)?strlen(speed):0);
 
-        string_if_different_set(&forecast->units_.speed_, speed, speedlen);
-
-        xmlFree(XMLCHAR_P(speed));
+        forecast_strings_intern(&strings, &forecast->units_.speed_, speed, speedlen);
 
         // temperature
-        const char * temperature = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("temperature")));
+        const char * temperature = ATTRIBUTE_PEEK(curr, "temperature");
 
         gsize temperaturelen = ((temperature)?strlen(temperature):0);
 
-        string_if_different_set(&forecast->units_.temperature_, temperature, temperaturelen);
-
-        xmlFree(XMLCHAR_P(temperature));
+        forecast_strings_intern(&strings, &forecast->units_.temperature_, temperature, temperaturelen);
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("wind"))) {
         // chill
-        const char * chill = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("chill")));
-
-        int_if_different_set(&forecast->windChill_, chill);
-
-        xmlFree(XMLCHAR_P(chill));
+        int_if_different_set(&forecast->windChill_, ATTRIBUTE_PEEK(curr, "chill"));
 
         // direction
-        const char * direction = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("direction")));
-
-        gint value = (gint)g_ascii_strtoll((direction)?direction:"999", NULL, 10);
+        gint value = integer_parse(ATTRIBUTE_PEEK(curr, "direction"), 999);
 
         const gchar * dirvalue = WIND_DIRECTION(value);
 
-        string_if_different_set(&forecast->windDirection_, dirvalue, strlen(dirvalue));
-
-        xmlFree(XMLCHAR_P(direction));
+        forecast_strings_intern(&strings, &forecast->windDirection_, dirvalue, strlen(dirvalue));
 
         // speed
-        const char * speed = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("speed")));
-
-        int_if_different_set(&forecast->windSpeed_, speed);
-
-        xmlFree(XMLCHAR_P(speed));
+        int_if_different_set(&forecast->windSpeed_, ATTRIBUTE_PEEK(curr, "speed"));
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("atmosphere"))) {
         // humidity
-        const char * humidity = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("humidity")));
-
-        int_if_different_set(&forecast->humidity_, humidity);
-
-        xmlFree(XMLCHAR_P(humidity));
+        int_if_different_set(&forecast->humidity_, ATTRIBUTE_PEEK(curr, "humidity"));
 
         // pressure
-        const char * pressure = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("pressure")));
-
-        forecast->pressure_ = g_ascii_strtod((pressure)?pressure:"0", NULL);
-
-        xmlFree(XMLCHAR_P(pressure));
+        forecast->pressure_ = decimal_parse(ATTRIBUTE_PEEK(curr, "pressure"));
 
         // visibility
-        const char * visibility = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("visibility")));
-
-        forecast->visibility_ = g_ascii_strtod((visibility)?visibility:"0", NULL);
+        forecast->visibility_ = decimal_parse(ATTRIBUTE_PEEK(curr, "visibility"));
 
         // need to divide by 100
         //forecast->dVisibility_ = forecast->dVisibility_/100;
 
-        xmlFree(XMLCHAR_P(visibility));
-
         // state
-        const char * state = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("rising")));
-                            
-        forecast->pressureState_ = (PressureState) g_ascii_strtoll((state)?state:"0",
-                                                                   NULL,
-                                                                   10);
-
-        xmlFree(XMLCHAR_P(state));
+        forecast->pressureState_ =
+          (PressureState) integer_parse(ATTRIBUTE_PEEK(curr, "rising"), 0);
       } else if (xmlStrEqual(curr->name, CONSTXMLCHAR_P("astronomy"))) {
         // sunrise
-        const char * sunrise = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("sunrise")));
+        const char * sunrise = ATTRIBUTE_PEEK(curr, "sunrise");
 
         gsize sunriselen = ((sunrise)?strlen(sunrise):0);
 
-        string_if_different_set(&forecast->sunrise_, sunrise, sunriselen);
-
-        xmlFree(XMLCHAR_P(sunrise));
+        forecast_strings_add(&strings, &forecast->sunrise_, sunrise, sunriselen);
 
         // sunset
-        const char * sunset = CONSTCHAR_P(xmlGetProp(curr, XMLCHAR_P("sunset")));
+        const char * sunset = ATTRIBUTE_PEEK(curr, "sunset");
 
         gsize sunsetlen = ((sunset)?strlen(sunset):0);
 
-        string_if_different_set(&forecast->sunset_, sunset, sunsetlen);
-
-        xmlFree(XMLCHAR_P(sunset));
+        forecast_strings_add(&strings, &forecast->sunset_, sunset, sunsetlen);
       }
           
     }
 
   }
 
+  forecast = forecast_strings_commit(&strings, forecast);
+
+  forecast_version_stamp(forecast);
+
   return forecast;
 }
 
@@ -646,7 +623,7 @@ xpath_evaluate(xmlXPathContextPtr ctxt, const char * expr)
  *       returned. Otherwise, the appropriate pointer is set based on the name
  *       of the XML element: 'Result' for GList (list)
  */
-static gint
+gint
 location_response_parse(gpointer response, GList ** list)
 {
   xmlDocPtr pDoc = xmlReadMemory(CONSTCHAR_P(response),
@@ -730,27 +707,18 @@ location_response_parse(gpointer response, GList ** list)
 }
 
 /**
- * Parses the response and fills in the supplied forecast pointer.
+ * Fills in the supplied forecast pointer from a parsed response.
  *
- * @param response Pointer to the response received.
+ * @param pDoc     Pointer to the parsed response, freed before returning.
+ *                 NULL if parsing failed.
+ * @param response Pointer to the response text, for diagnostics.
  * @param forecast Pointer to the pointer to the forecast to retrieve.
  *
  * @return 0 on success, -1 on failure
- *
- * @note If the the forecast pointer is NULL, nothing is done and failure is
- *       returned. Otherwise, the appropriate pointer is set based on the name
- *       of the XML element: 'channel' for Forecast (forecast)
  */
-//static gint
-gint
-forecast_response_parse(gpointer response, gpointer * forecast)
+static gint
+forecast_document_parse(xmlDocPtr pDoc, const gchar * response, gpointer * forecast)
 {
-  xmlDocPtr pDoc = xmlReadMemory(CONSTCHAR_P(response),
-                                 strlen(response),
-                                 "",
-                                 NULL,
-                                 0);
-
   if (!pDoc) {
     // failed
     LXW_LOG(LXW_ERROR,
@@ -804,37 +772,21 @@ forecast_response_parse(gpointer response, gpointer * forecast)
 
       if (node && node->type == XML_ELEMENT_NODE) {
         if (xmlStrEqual(node->name, CONSTXMLCHAR_P("channel"))) {
-          ForecastInfo * entry = NULL;
-                  
-          gboolean newed = FALSE;
-
-          /* Check if forecast is allocated, if not, 
-           * allocate and populate 
-           */
+          /* the previous forecast is shared, the parse updates a copy */
           if (forecast) {
-            if (*forecast) {
-              entry = (ForecastInfo *)*forecast;
+            ForecastInfo * entry = (ForecastInfo *)forecast_derive(*forecast);
+
+            ForecastInfo * committed = (entry) ? channel_node_process(node, entry) : NULL;
+
+            if (committed) {
+              forecast_unref(*forecast);
+
+              *forecast = committed;
             } else {
-              entry = (ForecastInfo *)g_try_new0(ForecastInfo, 1);
+              /* Failed, the previous forecast is freed by caller */
+              forecast_unref(entry);
 
-              newed = TRUE;
-            }
-                  
-            if (!entry) {
               retval = -1;
-            } else {
-              *forecast = channel_node_process(node, entry);
-                          
-              if (!*forecast) {
-                /* Failed, forecast is freed by caller */
-                              
-                /* Unless it was just newed... */
-                if (newed) {
-                  g_free(entry);
-                }
-                          
-                retval = -1;
-              }
             }
 
           } // end if forecast
@@ -857,13 +809,40 @@ forecast_response_parse(gpointer response, gpointer * forecast)
 }
 
 /**
- * Initializes the internals: XML 
+ * Parses the response and fills in the supplied forecast pointer.
+ *
+ * @param response Pointer to the response received.
+ * @param forecast Pointer to the pointer to the forecast to retrieve.
+ *
+ * @return 0 on success, -1 on failure
+ *
+ * @note If the the forecast pointer is NULL, nothing is done and failure is
+ *       returned. Otherwise, the appropriate pointer is set based on the name
+ *       of the XML element: 'channel' for Forecast (forecast)
+ */
+//static gint
+gint
+forecast_response_parse(gpointer response, gpointer * forecast)
+{
+  xmlDocPtr pDoc = xmlReadMemory(CONSTCHAR_P(response),
+                                 strlen(response),
+                                 "",
+                                 NULL,
+                                 0);
+
+  return forecast_document_parse(pDoc, CONSTCHAR_P(response), forecast);
+}
+
+/**
+ * Initializes the internals: XML, allocating from the arenas
  *
  */
 void
 yahooutil_init(void)
 {
   if (!g_initialized) {
+    arena_xml_setup();
+
     xmlInitParser();
 
     g_initialized = 1;
@@ -885,113 +864,162 @@ yahooutil_cleanup(void)
 }
 
 /**
- * Retrieves the details for the specified location
+ * Retrieves the details for the specified location from the placefinder
+ * service.
  *
  * @param location The string containing the name/code of the location
+ * @param list     Pointer to the list to fill with LocationInfo entries.
  *
- * @return A pointer to a list of LocationInfo entries, possibly empty, 
- *         if no details were found. Caller is responsible for freeing the list.
+ * @return 0 on success, even if nothing matched, -1 on failure.
  */
-GList *
-yahooutil_location_find(const gchar * location)
+static gint
+location_find(const gchar * location, GList ** list)
 {
   gint rc = 0;
   gint datalen = 0;
 
-  GList * list = NULL;
-
-  gchar * locationascii = locale_to_ascii(location);
+  gchar * locationascii = textutil_uri_escape(location);
 
   gsize len = WOEID_QUERY_LEN + strlen(locationascii);
 
-  gchar * querybuf = g_malloc0(len);
+  gchar * querybuf = arena_alloc0(len);
+
+  if (!querybuf) {
+    LXW_LOG(LXW_ERROR, "yahooutil::location_find(%s): out of memory", location);
+
+    g_free(locationascii);
+
+    return -1;
+  }
 
   gint ret = woeid_query_gen(querybuf, locationascii);
 
   g_free(locationascii);
 
-  LXW_LOG(LXW_DEBUG, "yahooutil::yahooutil_find_location(%s): query[%d]: %s",
+  LXW_LOG(LXW_DEBUG, "yahooutil::location_find(%s): query[%d]: %s",
           location, ret, querybuf);
 
   gpointer response = httputil_url_get(querybuf, &rc, &datalen);
 
   if (!response || rc != HTTP_STATUS_OK) {
-    LXW_LOG(LXW_ERROR, "yahooutil::yahooutil_find_location(%s): Failed with error code %d",
+    LXW_LOG(LXW_ERROR, "yahooutil::location_find(%s): Failed with error code %d",
             location, rc);
+
+    ret = -1;
   } else {
-    LXW_LOG(LXW_DEBUG, "yahooutil::yahooutil_find_location(%s): Response code: %d, size: %d",
+    LXW_LOG(LXW_DEBUG, "yahooutil::location_find(%s): Response code: %d, size: %d",
             location, rc, datalen);
 
-    LXW_LOG(LXW_VERBOSE, "yahooutil::getLocation(%s): Contents: %s", 
+    LXW_LOG(LXW_VERBOSE, "yahooutil::location_find(%s): Contents: %s", 
             location, (const char *)response);
 
-    ret = location_response_parse(response, &list);
+    ret = location_response_parse(response, list);
       
-    LXW_LOG(LXW_DEBUG, "yahooutil::getLocation(%s): Response parsing returned %d",
+    LXW_LOG(LXW_DEBUG, "yahooutil::location_find(%s): Response parsing returned %d",
             location, ret);
-
-    if (ret) {
-      // failure
-      g_list_free_full(list, location_free);
-    }
   }
 
-  g_free(querybuf);
-  g_free(response);
+  arena_free(querybuf);
+  arena_free(response);
 
-  return list;
+  return ret;
 }
 
 /**
- * Retrieves the forecast for the specified location WOEID
+ * Retrieves the raw forecast response for the specified location WOEID
  *
- * @param woeid    The string containing the WOEID of the location
- * @param units    The character containing the units for the forecast (c|f)
- * @param forecast The pointer to the forecast to be filled. If set to NULL,
- *                  a new one will be allocated.
+ * @param woeid  The string containing the WOEID of the location
+ * @param units  The character containing the units for the forecast (c|f)
+ * @param length Pointer to the length of the response, set on success.
  *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
  */
-void
-yahooutil_forecast_get(const gchar * woeid, const gchar units, gpointer * forecast)
+static gchar *
+forecast_fetch(const gchar * woeid,
+               const gchar   units,
+               gint        * length)
 {
   gint rc = 0;
   gint datalen = 0;
 
   gsize len = FORECAST_QUERY_LEN + strlen(woeid);
 
-  gchar * querybuf = g_malloc0(len);
+  gchar * querybuf = arena_alloc0(len);
+
+  if (!querybuf) {
+    LXW_LOG(LXW_ERROR, "yahooutil::forecast_fetch(%s): out of memory", woeid);
+
+    return NULL;
+  }
 
   gint ret = forecast_query_gen(querybuf, woeid, units);
 
-  LXW_LOG(LXW_DEBUG, "yahooutil::yahooutil_forecast_get(%s): query[%d]: %s",
+  LXW_LOG(LXW_DEBUG, "yahooutil::forecast_fetch(%s): query[%d]: %s",
           woeid, ret, querybuf);
 
   gpointer response = httputil_url_get(querybuf, &rc, &datalen);
 
   if (!response || rc != HTTP_STATUS_OK) {
-    LXW_LOG(LXW_ERROR, "yahooutil::yahooutil_forecast_get(%s): Failed with error code %d",
+    LXW_LOG(LXW_ERROR, "yahooutil::forecast_fetch(%s): Failed with error code %d",
             woeid, rc);
+
+    arena_free(response);
+
+    response = NULL;
   } else {
-    LXW_LOG(LXW_DEBUG, "yahooutil::yahooutil_forecast_get(%s): Response code: %d, size: %d",
+    LXW_LOG(LXW_DEBUG, "yahooutil::forecast_fetch(%s): Response code: %d, size: %d",
             woeid, rc, datalen);
     
-    LXW_LOG(LXW_VERBOSE, "yahooutil::yahooutil_forecast_get(%s): Contents: %s",
+    LXW_LOG(LXW_VERBOSE, "yahooutil::forecast_fetch(%s): Contents: %s",
             woeid, (const char *)response);
-    
-    ret = forecast_response_parse(response, forecast);
-    
-    LXW_LOG(LXW_DEBUG,
-            "yahooutil::yahooutil_forecast_get(%s): Response parsing returned %d",
-            woeid, ret);
-
-    if (ret) {
-      forecast_free(*forecast);
 
-      *forecast = NULL;
+    if (length) {
+      *length = datalen;
     }
-
   }
 
-  g_free(querybuf);
-  g_free(response);
+  arena_free(querybuf);
+
+  return (gchar *)response;
+}
+
+/**
+ * Parses a forecast response retrieved with forecast_fetch().
+ *
+ * @param response The response, NUL-terminated.
+ * @param length   The length of the response.
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static gint
+forecast_parse(const gchar * response, gint length, gpointer * forecast)
+{
+  xmlDocPtr pDoc = xmlReadMemory(response, length, "", NULL, 0);
+
+  return forecast_document_parse(pDoc, response, forecast);
+}
+
+/* The YQL service, answering in XML */
+static const WeatherProvider g_provider = {
+  "yahoo",
+  location_find,
+  forecast_fetch,
+  forecast_parse,
+  g_volatile_spans,
+  G_N_ELEMENTS(g_volatile_spans)
+};
+
+/**
+ * Returns the provider for Yahoo's YQL weather service.
+ *
+ * @return Pointer to the provider.
+ */
+const WeatherProvider *
+yahooutil_provider(void)
+{
+  return &g_provider;
 }
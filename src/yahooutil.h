@@ -23,30 +23,19 @@
 #ifndef LXWEATHER_YAHOOUTIL_HEADER
 #define LXWEATHER_YAHOOUTIL_HEADER
 
+#include "provider.h"
+
 #include <glib.h>
 
-/**
- * Retrieves the details for the specified location
- *
- * @param location The string containing the name/code of the location
- *
- * @return A pointer to a list of LocationInfo entries, possibly empty, 
- *         if no details were found. Caller is responsible for freeing the list.
- */
-GList *
-yahooutil_location_find(const gchar * location);
+#include <libxml/tree.h>
 
 /**
- * Retrieves the forecast for the specified location WOEID
- *
- * @param woeid The string containing the WOEID of the location
- * @param units The character containing the units for the forecast (c|f)
- * @param forecast The pointer to the forecast to be filled. If set to NULL,
- *                 a new one will be allocated.
+ * Returns the provider for Yahoo's YQL weather service.
  *
+ * @return Pointer to the provider.
  */
-void
-yahooutil_forecast_get(const gchar * woeid, const gchar units, gpointer forecast);
+const WeatherProvider *
+yahooutil_provider(void);
 
 /**
  * Initializes the internals: XML and HTTP
@@ -62,7 +51,15 @@ yahooutil_init(void);
 void
 yahooutil_cleanup(void);
 
+/* Parser entry points, exported for the benchmarks and fuzzers */
+
 gint
 forecast_response_parse(gpointer response, gpointer * forecast);
 
+gint
+location_response_parse(gpointer response, GList ** list);
+
+gpointer
+result_node_process(xmlNodePtr node);
+
 #endif
@@ -0,0 +1,501 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the YQL weather service in its JSON form */
+
+#include "yqljson.h"
+#include "arena.h"
+#include "jsonutil.h"
+#include "httputil.h"
+#include "location.h"
+#include "forecast.h"
+#include "logutil.h"
+#include "textutil.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#define YQLJSON_URL            "http://query.yahooapis.com/v1/public/yql?format=json&q="
+#define YQLJSON_LOCATION_QUERY "SELECT%%20*%%20FROM%%20geo.placefinder%%20WHERE%%20text=%%22%s%%22"
+#define YQLJSON_FORECAST_QUERY "SELECT%%20*%%20FROM%%20weather.forecast%%20WHERE%%20woeid=%%22%s%%22%%20and%%20u=%%22%c%%22"
+
+/* Parts of a response that differ on every request */
+static const ProviderSpan g_volatile_spans[] = {
+  PROVIDER_SPAN("\"created\":\"",       "\""),
+  PROVIDER_SPAN("\"lastBuildDate\":\"", "\"")
+};
+
+/**
+ * Reads an integer member.
+ *
+ * @param node     Pointer to the object.
+ * @param name     Name of the member.
+ * @param fallback The value to return if there is no number to read.
+ *
+ * @return The value.
+ */
+static gint
+integer_get(JsonUtilNode * node, const gchar * name, gint fallback)
+{
+  const gchar * str = jsonutil_string(node, name);
+
+  gchar * end = NULL;
+
+  gint64 value = (str) ? g_ascii_strtoll(str, &end, 10) : 0;
+
+  if (!str || end == str || value > G_MAXINT || value < G_MININT) {
+    return fallback;
+  }
+
+  return (gint)value;
+}
+
+/**
+ * Reads a decimal member.
+ *
+ * @param node Pointer to the object.
+ * @param name Name of the member.
+ *
+ * @return The value, 0 if there is none.
+ */
+static gdouble
+decimal_get(JsonUtilNode * node, const gchar * name)
+{
+  const gchar * str = jsonutil_string(node, name);
+
+  return (str) ? g_ascii_strtod(str, NULL) : 0.0;
+}
+
+/**
+ * Adds a string member to the forecast's strings.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param node    Pointer to the object.
+ * @param name    Name of the member.
+ */
+static void
+string_add(ForecastStrings * strings,
+           const gchar    ** field,
+           JsonUtilNode    * node,
+           const gchar     * name)
+{
+  const gchar * value = jsonutil_string(node, name);
+
+  forecast_strings_add(strings, field, value, (value) ? strlen(value) : 0);
+}
+
+/**
+ * Adds a string member of an object to the forecast's vocabulary strings.
+ *
+ * @param strings Pointer to the builder.
+ * @param field   Address of the forecast field to point at the string.
+ * @param node    Pointer to the object.
+ * @param name    Name of the member.
+ */
+static void
+string_intern(ForecastStrings * strings,
+              const gchar    ** field,
+              JsonUtilNode    * node,
+              const gchar     * name)
+{
+  const gchar * value = jsonutil_string(node, name);
+
+  forecast_strings_intern(strings, field, value, (value) ? strlen(value) : 0);
+}
+
+/**
+ * Returns the first of the results. YQL gives a lone result as an object
+ * and several as an array of them.
+ *
+ * @param node Pointer to the results, may be NULL.
+ *
+ * @return Pointer to the first result, or NULL if there is none.
+ */
+static JsonUtilNode *
+result_first(JsonUtilNode * node)
+{
+  return (node && node->type_ == JSONUTIL_ARRAY) ? node->children_ : node;
+}
+
+/**
+ * Fills in the forecast from the item member of a channel.
+ *
+ * @param item     Pointer to the item object.
+ * @param forecast Pointer to the forecast being filled.
+ * @param strings  Pointer to the builder collecting the forecast's strings.
+ */
+static void
+item_process(JsonUtilNode * item, ForecastInfo * forecast, ForecastStrings * strings)
+{
+  JsonUtilNode * condition = jsonutil_path(item, "condition");
+
+  string_add(strings, &forecast->time_, condition, "date");
+  string_intern(strings, &forecast->conditions_, condition, "text");
+
+  forecast->temperature_ = integer_get(condition, "temp", 0);
+  forecast->code_        = integer_get(condition, "code", 0);
+
+  /* the image is the first quoted value of the HTML description */
+  const gchar * description = jsonutil_string(item, "description");
+
+  const gchar * open  = (description) ? strchr(description, '"') : NULL;
+  const gchar * close = (open) ? strchr(open + 1, '"') : NULL;
+
+  if (close && g_strstr_len(open, close - open, "yimg.com")) {
+    forecast_strings_intern(strings, &forecast->imageURL_, open + 1, close - open - 1);
+  }
+
+  /* record layout: day, high, low, code, text, each NUL-terminated */
+  static const gchar * fields[] = { "day", "high", "low", "code", "text" };
+
+  GString * days = g_string_sized_new(256);
+
+  JsonUtilNode * day = jsonutil_path(item, "forecast");
+
+  day = (day && day->type_ == JSONUTIL_ARRAY) ? day->children_ : NULL;
+
+  gint count = 0;
+
+  for (; day && count < FORECAST_MAX_DAYS; day = day->next_, ++count) {
+    gsize f = 0;
+    for (; f < G_N_ELEMENTS(fields); ++f) {
+      const gchar * value = jsonutil_string(day, fields[f]);
+
+      g_string_append(days, (value) ? value : "");
+      g_string_append_c(days, '\0');
+    }
+  }
+
+  if (count) {
+    forecast_strings_add(strings, &forecast->daysRaw_, days->str, days->len);
+  }
+
+  g_string_free(days, TRUE);
+}
+
+/**
+ * Fills in the forecast from a channel.
+ *
+ * @param channel Pointer to the channel object.
+ * @param entry   Address of the pointer to the forecast to fill in, which
+ *                is replaced by the filled in forecast on success.
+ *
+ * @return 0 on success, -1 if the channel reports an error.
+ */
+static gint
+channel_process(JsonUtilNode * channel, ForecastInfo ** entry)
+{
+  ForecastInfo * forecast = *entry;
+
+  const gchar * title = jsonutil_string(channel, "title");
+
+  if (title && strstr(title, "Error")) {
+    const gchar * error = jsonutil_string(channel, "item.title");
+
+    LXW_LOG(LXW_ERROR, "yqljson::channel_process(): Forecast retrieval error: %s",
+            (error) ? error : "");
+
+    return -1;
+  }
+
+  /* every string of this forecast ends up in the forecast's allocation */
+  ForecastStrings strings;
+
+  forecast_strings_begin(&strings);
+
+  JsonUtilNode * units = jsonutil_path(channel, "units");
+
+  string_intern(&strings, &forecast->units_.distance_, units, "distance");
+  string_intern(&strings, &forecast->units_.pressure_, units, "pressure");
+  string_intern(&strings, &forecast->units_.speed_, units, "speed");
+  string_intern(&strings, &forecast->units_.temperature_, units, "temperature");
+
+  JsonUtilNode * wind = jsonutil_path(channel, "wind");
+
+  if (wind) {
+    forecast->windChill_ = integer_get(wind, "chill", 0);
+
+    gint value = integer_get(wind, "direction", 999);
+
+    const gchar * direction = WIND_DIRECTION(value);
+
+    forecast_strings_intern(&strings, &forecast->windDirection_, direction, strlen(direction));
+
+    forecast->windSpeed_ = integer_get(wind, "speed", 0);
+  }
+
+  JsonUtilNode * atmosphere = jsonutil_path(channel, "atmosphere");
+
+  if (atmosphere) {
+    forecast->humidity_      = integer_get(atmosphere, "humidity", 0);
+    forecast->pressure_      = decimal_get(atmosphere, "pressure");
+    forecast->visibility_    = decimal_get(atmosphere, "visibility");
+    forecast->pressureState_ = (PressureState)integer_get(atmosphere, "rising", 0);
+  }
+
+  JsonUtilNode * astronomy = jsonutil_path(channel, "astronomy");
+
+  string_add(&strings, &forecast->sunrise_, astronomy, "sunrise");
+  string_add(&strings, &forecast->sunset_, astronomy, "sunset");
+
+  JsonUtilNode * item = jsonutil_path(channel, "item");
+
+  if (item) {
+    item_process(item, forecast, &strings);
+  }
+
+  ForecastInfo * committed = forecast_strings_commit(&strings, forecast);
+
+  if (!committed) {
+    return -1;
+  }
+
+  forecast_version_stamp(committed);
+
+  *entry = committed;
+
+  return 0;
+}
+
+/**
+ * Parses a forecast response.
+ *
+ * @param response The response.
+ * @param length   The length of the response.
+ * @param forecast The pointer to the previous forecast, or to NULL. On
+ *                 success it is replaced by the new forecast, parsed over
+ *                 the previous one.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+gint
+yqljson_forecast_parse(const gchar * response, gint length, gpointer * forecast)
+{
+  JsonUtilNode * root = jsonutil_parse(response, length);
+
+  JsonUtilNode * channel = result_first(jsonutil_path(root, "query.results.channel"));
+
+  if (!channel || channel->type_ != JSONUTIL_OBJECT) {
+    LXW_LOG(LXW_ERROR, "yqljson::forecast_parse(): No channel in response");
+
+    jsonutil_free(root);
+
+    return -1;
+  }
+
+  /* the previous forecast is shared, the parse updates a copy */
+  ForecastInfo * entry = (ForecastInfo *)forecast_derive(*forecast);
+
+  gint ret = (entry) ? channel_process(channel, &entry) : -1;
+
+  if (!ret) {
+    forecast_unref(*forecast);
+
+    *forecast = entry;
+  } else {
+    forecast_unref(entry);
+  }
+
+  jsonutil_free(root);
+
+  return ret;
+}
+
+/**
+ * Turns one placefinder result into a location.
+ *
+ * @param result Pointer to the result object.
+ * @param list   Pointer to the list to prepend the new LocationInfo to.
+ */
+static void
+result_process(JsonUtilNode * result, GList ** list)
+{
+  LocationInfo * location = (LocationInfo *)location_new();
+
+  if (!location) {
+    return;
+  }
+
+  JsonUtilNode * member = result->children_;
+
+  for (; member; member = member->next_) {
+    if (member->value_) {
+      location_property_set(location, member->name_, member->value_,
+                            strlen(member->value_));
+    }
+  }
+
+  *list = g_list_prepend(*list, location);
+}
+
+/**
+ * Parses a placefinder response.
+ *
+ * @param response The response.
+ * @param length   The length of the response.
+ * @param list     Pointer to the list to fill with LocationInfo entries.
+ *
+ * @return 0 on success, even if nothing matched, -1 on failure.
+ */
+gint
+yqljson_location_parse(const gchar * response, gint length, GList ** list)
+{
+  JsonUtilNode * root = jsonutil_parse(response, length);
+
+  if (!jsonutil_path(root, "query")) {
+    LXW_LOG(LXW_ERROR, "yqljson::location_parse(): No query in response");
+
+    jsonutil_free(root);
+
+    return -1;
+  }
+
+  /* no matches leaves the results null */
+  JsonUtilNode * result = jsonutil_path(root, "query.results.Result");
+
+  if (result && result->type_ == JSONUTIL_OBJECT) {
+    result_process(result, list);
+  } else if (result && result->type_ == JSONUTIL_ARRAY) {
+    for (result = result->children_; result; result = result->next_) {
+      if (result->type_ == JSONUTIL_OBJECT) {
+        result_process(result, list);
+      }
+    }
+  }
+
+  jsonutil_free(root);
+
+  return 0;
+}
+
+/**
+ * Retrieves a query from the service.
+ *
+ * @param url    The query URL.
+ * @param what   What is being retrieved, for the log.
+ * @param length Pointer to the length of the response, set on success.
+ *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
+ */
+static gchar *
+query_get(const gchar * url, const gchar * what, gint * length)
+{
+  gint rc = 0;
+  gint datalen = 0;
+
+  LXW_LOG(LXW_DEBUG, "yqljson::query_get(%s): query: %s", what, url);
+
+  gpointer response = httputil_url_get(url, &rc, &datalen);
+
+  if (!response || rc != HTTP_STATUS_OK) {
+    LXW_LOG(LXW_ERROR, "yqljson::query_get(%s): Failed with error code %d", what, rc);
+
+    arena_free(response);
+
+    return NULL;
+  }
+
+  LXW_LOG(LXW_DEBUG, "yqljson::query_get(%s): Response code: %d, size: %d",
+          what, rc, datalen);
+
+  LXW_LOG(LXW_VERBOSE, "yqljson::query_get(%s): Contents: %s",
+          what, (const char *)response);
+
+  if (length) {
+    *length = datalen;
+  }
+
+  return (gchar *)response;
+}
+
+/**
+ * Retrieves the details for the specified location from the placefinder
+ * service.
+ *
+ * @param location The string containing the name/code of the location
+ * @param list     Pointer to the list to fill with LocationInfo entries.
+ *
+ * @return 0 on success, even if nothing matched, -1 on failure.
+ */
+static gint
+location_find(const gchar * location, GList ** list)
+{
+  gchar * locationascii = textutil_uri_escape(location);
+
+  gchar * url = g_strdup_printf(YQLJSON_URL YQLJSON_LOCATION_QUERY, locationascii);
+
+  gint length = 0;
+
+  gchar * response = query_get(url, location, &length);
+
+  gint ret = (response) ? yqljson_location_parse(response, length, list) : -1;
+
+  arena_free(response);
+  g_free(url);
+  g_free(locationascii);
+
+  return ret;
+}
+
+/**
+ * Retrieves the raw forecast response for the specified location WOEID
+ *
+ * @param woeid  The string containing the WOEID of the location
+ * @param units  The character containing the units for the forecast (c|f)
+ * @param length Pointer to the length of the response, set on success.
+ *
+ * @return The response, to be freed with arena_free(), or NULL on
+ *         failure.
+ */
+static gchar *
+forecast_fetch(const gchar * woeid, const gchar units, gint * length)
+{
+  gchar * url = g_strdup_printf(YQLJSON_URL YQLJSON_FORECAST_QUERY, woeid, units);
+
+  gchar * response = query_get(url, woeid, length);
+
+  g_free(url);
+
+  return response;
+}
+
+/* The YQL service, answering in JSON */
+static const WeatherProvider g_provider = {
+  "yql-json",
+  location_find,
+  forecast_fetch,
+  yqljson_forecast_parse,
+  g_volatile_spans,
+  G_N_ELEMENTS(g_volatile_spans)
+};
+
+/**
+ * Returns the provider for the JSON form of Yahoo's YQL weather service.
+ *
+ * @return Pointer to the provider.
+ */
+const WeatherProvider *
+yqljson_provider(void)
+{
+  return &g_provider;
+}
@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2012-2015 Piotr Sipika; see the AUTHORS file for more.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ * 
+ * See the COPYRIGHT file for more information.
+ */
+
+/* Provides the YQL weather service in its JSON form */
+
+#ifndef LXWEATHER_YQLJSON_HEADER
+#define LXWEATHER_YQLJSON_HEADER
+
+#include "provider.h"
+
+#include <glib.h>
+
+/**
+ * Returns the provider for the JSON form of Yahoo's YQL weather service.
+ *
+ * @return Pointer to the provider.
+ */
+const WeatherProvider *
+yqljson_provider(void);
+
+/* Parser entry points, exported for the benchmarks and fuzzers */
+
+gint
+yqljson_forecast_parse(const gchar * response, gint length, gpointer * forecast);
+
+gint
+yqljson_location_parse(const gchar * response, gint length, GList ** list);
+
+#endif